@@ -0,0 +1,47 @@
+#include "alloc_counter.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+using namespace std;
+
+static atomic<uint64_t> allocationCount{0};
+static atomic<uint64_t> allocatedBytes{0};
+
+uint64_t getAllocationCount() {
+    return allocationCount.load(memory_order_relaxed);
+}
+
+uint64_t getAllocatedBytes() {
+    return allocatedBytes.load(memory_order_relaxed);
+}
+
+// Every allocation in the process goes through these
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    if (void* p = malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
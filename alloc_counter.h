@@ -0,0 +1,7 @@
+#pragma once
+#include <cstdint>
+
+// Process-wide totals from the counting operator new in alloc_counter.cpp. Only programs that
+// link alloc_counter.o have them (draw_bench, and everything built with TRACE=1).
+uint64_t getAllocationCount();
+uint64_t getAllocatedBytes();
@@ -0,0 +1,81 @@
+#include "arena.h"
+#include <new>
+#include <algorithm>
+
+using namespace std;
+
+// Smallest chunk worth asking the system for
+static const size_t minimumChunkSize = 64 * 1024;
+
+static uint8_t* allocateChunk(size_t bytes) {
+    return static_cast<uint8_t*>(::operator new(bytes, align_val_t(Arena::defaultAlignment)));
+}
+
+static void freeChunk(uint8_t* data) {
+    ::operator delete(data, align_val_t(Arena::defaultAlignment));
+}
+
+Arena::Arena(size_t initialCapacity) {
+    if (initialCapacity > 0) {
+        addChunk(initialCapacity);
+    }
+}
+
+Arena::~Arena() {
+    for (Chunk& chunk : chunks) {
+        freeChunk(chunk.data);
+    }
+}
+
+void Arena::addChunk(size_t minimumBytes) {
+    // Grow geometrically so an image that needs many chunks only needs a few
+    size_t size = max(minimumBytes, minimumChunkSize);
+    if (!chunks.empty()) {
+        size = max(size, 2 * chunks.back().size);
+    }
+    chunks.push_back({allocateChunk(size), size, 0});
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    // Chunks start on a defaultAlignment boundary, so aligning the offset aligns the pointer
+    if (chunks.empty() || (chunks.back().used + alignment - 1) / alignment * alignment + bytes > chunks.back().size) {
+        addChunk(bytes);
+    }
+    Chunk& chunk = chunks.back();
+    size_t offset = (chunk.used + alignment - 1) / alignment * alignment;
+    chunk.used = offset + bytes;
+    highWater = max(highWater, bytesInUse());
+    return chunk.data + offset;
+}
+
+void Arena::reset() {
+    if (chunks.size() > 1) {
+        size_t total = capacity();
+        for (Chunk& chunk : chunks) {
+            freeChunk(chunk.data);
+        }
+        chunks.clear();
+        chunks.push_back({allocateChunk(total), total, 0});
+    } else if (!chunks.empty()) {
+        chunks[0].used = 0;
+    }
+}
+
+size_t Arena::bytesInUse() const {
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) {
+        total += chunk.used;
+    }
+    return total;
+}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) {
+        total += chunk.size;
+    }
+    return total;
+}
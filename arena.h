@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Bump allocator for per-image scratch. Allocations are never freed one by one; reset() drops
+// all of them at once and keeps the memory for the next image. When one image overflowed into
+// extra chunks, reset() folds them into a single chunk of the combined size, so after the
+// largest image has gone through, every later image is served from one block without calling
+// the system allocator. Not thread-safe: use one arena per thread or pipeline stage.
+class Arena {
+public:
+    // Alignment of every allocation unless asked otherwise (one cache line, enough for AVX-512)
+    static constexpr size_t defaultAlignment = 64;
+
+    explicit Arena(size_t initialCapacity = 0);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Uninitialised storage, valid until the next reset() or the arena's destruction.
+    // alignment must be a power of two no larger than defaultAlignment.
+    void* allocate(size_t bytes, size_t alignment = defaultAlignment);
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        static_assert(alignof(T) <= defaultAlignment, "over-aligned type");
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    // Release every allocation at once, keeping the memory
+    void reset();
+
+    size_t bytesInUse() const;
+    size_t capacity() const;
+    // Most bytes in use at any point since construction, i.e. the arena's memory bound
+    size_t highWaterMark() const { return highWater; }
+
+private:
+    struct Chunk {
+        uint8_t* data;
+        size_t size;
+        size_t used;
+    };
+
+    void addChunk(size_t minimumBytes);
+
+    vector<Chunk> chunks;
+    size_t highWater = 0;
+};
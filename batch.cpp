@@ -0,0 +1,340 @@
+#include "batch.h"
+#include "bounded_queue.h"
+#include "image_io.h"
+#include "spectrum_file.h"
+#include "streaming.h"
+#include "trace.h"
+#include "thinning.h"
+#include "thread_pool.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+// One input travelling through the pipeline. A decode failure is carried along in error so the
+// writer stage can count it in order with the rest.
+struct BatchItem {
+    filesystem::path path;
+    BinaryImage image;
+    ThinningStats stats;
+    string error;
+};
+
+static vector<filesystem::path> listInputImages(const string& inputDir) {
+    vector<filesystem::path> paths;
+    for (const auto& entry : filesystem::directory_iterator(inputDir)) {
+        if (entry.is_regular_file() && isSupportedImageFile(entry.path().string())) {
+            paths.push_back(entry.path());
+        }
+    }
+    sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Spectrum plus component table in the binary format
+template <typename T>
+static bool writeBatchSpectrum(const BatchItem& item, const BatchOptions& options, MatrixView<T> spectrum,
+                               size_t fullCols, const vector<FrequencyComponent>& components) {
+    filesystem::path outputPath = filesystem::path(options.outputDir) / item.path.filename();
+    outputPath.replace_extension(".spec");
+
+    SpectrumDescription description;
+    description.sourceRows = item.image.rows;
+    description.sourceCols = item.image.cols;
+    description.transformCols = fullCols;
+    description.padding = options.padding;
+    description.layout = SpectrumLayout::Half;
+    description.dtype = options.halfPrecision ? SpectrumDType::Float32 : SpectrumDType::Float64;
+
+    string error;
+    if (!writeSpectrumFile(outputPath.string(), spectrum, description, components, error)) {
+        cerr << outputPath.string() << ": " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool writeBatchResult(const filesystem::path& inputPath, size_t rows, size_t cols, int iterations, const BatchOptions& options,
+                             const vector<FrequencyComponent>& components) {
+    filesystem::path outputPath = filesystem::path(options.outputDir) / inputPath.filename();
+    outputPath.replace_extension(".txt");
+    ofstream out(outputPath);
+    if (!out) {
+        return false;
+    }
+    out << "# input: " << inputPath.string() << "\n";
+    out << "# size: " << rows << " x " << cols << "\n";
+    out << "# thinning iterations: " << iterations << "\n";
+    if (options.topCount > 0) {
+        out << "# strongest components: " << components.size() << "\n";
+    } else {
+        out << "# components above " << options.threshold << ": " << components.size() << "\n";
+    }
+    for (const FrequencyComponent& component : components) {
+        printFrequencyComponent(out, component);
+    }
+    return static_cast<bool>(out);
+}
+
+// Streaming mode: thin into <name>.skeleton.pbm and transform that into <name>.spec, one image at a
+// time through memory-mapped files. Both stay in outputDir next to the usual result.
+static bool processStreaming(const filesystem::path& path, const BatchOptions& options, string& error) {
+    filesystem::path skeletonPath = filesystem::path(options.outputDir) / path.filename();
+    skeletonPath.replace_extension(".skeleton.pbm");
+    filesystem::path spectrumPath = filesystem::path(options.outputDir) / path.filename();
+    spectrumPath.replace_extension(".spec");
+
+    StreamingOptions streaming;
+    streaming.memoryBudget = options.memoryBudget;
+    streaming.pool = &getDefaultThreadPool();
+    ThinningStats stats;
+    TRACE_SCOPE_NAMED(thinStep, "batch.thin");
+    if (!thinImageStreaming(path.string(), skeletonPath.string(), streaming, &stats, error)) {
+        return false;
+    }
+    TRACE_END(thinStep);
+
+    TRACE_SCOPE("batch.transform");
+    vector<FrequencyComponent> components;
+    SpectrumDType dtype = options.halfPrecision ? SpectrumDType::Float32 : SpectrumDType::Float64;
+    if (!DFT2DRealFFTStreaming(skeletonPath.string(), spectrumPath.string(), options.padding, dtype, options.topCount, streaming,
+                               &components, error)) {
+        return false;
+    }
+    if (!options.binaryOutput) {
+        MappedBinaryImage skeleton;
+        if (!skeleton.open(skeletonPath.string(), error) ||
+            !writeBatchResult(path, skeleton.rows(), skeleton.cols(), stats.iterations, options, components)) {
+            error = error.empty() ? "cannot write result" : error;
+            return false;
+        }
+    }
+    return true;
+}
+
+BatchReport runBatch(const BatchOptions& options) {
+    BatchReport report;
+    vector<filesystem::path> paths = listInputImages(options.inputDir);
+    filesystem::create_directories(options.outputDir);
+
+    auto start = chrono::steady_clock::now();
+
+    if (options.streaming) {
+        for (const filesystem::path& path : paths) {
+            string error;
+            if (!processStreaming(path, options, error)) {
+                cerr << path.string() << ": " << error << "\n";
+                ++report.failed;
+                continue;
+            }
+            ++report.processed;
+        }
+        report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        report.imagesPerSecond = report.seconds > 0 ? report.processed / report.seconds : 0;
+        return report;
+    }
+
+    BoundedQueue<BatchItem> decoded(options.queueCapacity);
+    BoundedQueue<BatchItem> thinned(options.queueCapacity);
+
+    thread decoder([&] {
+        for (const filesystem::path& path : paths) {
+            BatchItem item;
+            item.path = path;
+            TRACE_SCOPE_NAMED(decodeStep, "batch.decode");
+            loadBinaryImage(path.string(), item.image, item.error);
+            TRACE_END(decodeStep);
+            if (!decoded.push(std::move(item))) {
+                break;
+            }
+        }
+        decoded.close();
+    });
+
+    // Per-image scratch comes from one arena per stage, reset between images. After the largest
+    // image each arena is a single block, which bounds the scratch memory of the run.
+    thread thinner([&] {
+        Arena scratch;
+        BatchItem item;
+        while (decoded.pop(item)) {
+            if (item.error.empty()) {
+                TRACE_SCOPE("batch.thin");
+                thinImageFrontier(item.image.view(), &item.stats, &scratch);
+                scratch.reset();
+            }
+            if (!thinned.push(std::move(item))) {
+                break;
+            }
+        }
+        thinned.close();
+    });
+
+    // Transform and write on this thread; the row and column passes share the default pool.
+    // Consecutive images of one size are collected and transformed as a single batch.
+    ThreadPool& pool = getDefaultThreadPool();
+    Arena scratch;
+    vector<BatchItem> group;
+    auto transformGroup = [&] {
+        if (group.empty()) {
+            return;
+        }
+        TRACE_SCOPE("batch.transform");
+        scratch.reset();
+        size_t count = group.size();
+        size_t rows = group[0].image.rows;
+        size_t cols = group[0].image.cols;
+        // A single image is its own batch; several are stacked into one block
+        MatrixBatchView<const uint8_t> images(group[0].image.view(), 1);
+        Matrix<uint8_t> stacked;
+        if (count > 1) {
+            stacked = Matrix<uint8_t>(count * rows, cols, scratch);
+            for (size_t i = 0; i < count; ++i) {
+                copy(group[i].image.pixels.begin(), group[i].image.pixels.end(), stacked.row(i * rows));
+            }
+            images = MatrixBatchView<const uint8_t>(stacked.view(), count);
+        }
+        // The padded transform width is what the half-spectrum bins refer to
+        size_t fullCols = getTransformSize(cols, options.padding);
+        size_t fullRows = getTransformSize(rows, options.padding);
+        auto analyse = [&](auto& stackedSpectra) {
+            auto spectra = MatrixBatchView(stackedSpectra.view(), count);
+            DFT2DRealFFT(images, spectra, fullCols, &pool);
+            for (size_t i = 0; i < count; ++i) {
+                const BatchItem& item = group[i];
+                vector<FrequencyComponent> components = options.topCount > 0
+                    ? extractTopFrequencies(spectra[i], options.topCount, fullCols)
+                    : extractDominantFrequencies(spectra[i], options.threshold, fullCols);
+                bool written = options.binaryOutput ? writeBatchSpectrum(item, options, spectra[i], fullCols, components)
+                                                    : writeBatchResult(item.path, rows, cols, item.stats.iterations, options, components);
+                if (!written) {
+                    cerr << item.path.string() << ": cannot write result\n";
+                    ++report.failed;
+                    continue;
+                }
+                ++report.processed;
+            }
+        };
+        if (options.precision == FFTPrecision::Float) {
+            Matrix<complex<float>> spectra(count * fullRows, fullCols / 2 + 1, scratch);
+            analyse(spectra);
+        } else {
+            Matrix<complex<double>> spectra(count * fullRows, fullCols / 2 + 1, scratch);
+            analyse(spectra);
+        }
+        group.clear();
+    };
+
+    BatchItem item;
+    while (thinned.pop(item)) {
+        if (!item.error.empty()) {
+            transformGroup();
+            cerr << item.path.string() << ": " << item.error << "\n";
+            ++report.failed;
+            continue;
+        }
+        if (!group.empty() && (item.image.rows != group[0].image.rows || item.image.cols != group[0].image.cols ||
+                               group.size() >= max<size_t>(options.transformBatch, 1))) {
+            transformGroup();
+        }
+        group.push_back(std::move(item));
+    }
+    transformGroup();
+
+    decoder.join();
+    thinner.join();
+
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    report.imagesPerSecond = report.seconds > 0 ? report.processed / report.seconds : 0;
+    return report;
+}
+
+// Numeric option values: the whole argument has to parse, so "12x" or "-1" is rejected
+template <typename Number>
+static bool parseNumber(const char* text, Number& value) {
+    const char* end = text + strlen(text);
+    auto [stop, status] = from_chars(text, end, value);
+    return status == errc() && stop == end && stop != text;
+}
+
+int runBatchCommand(int argc, char* argv[]) {
+    BatchOptions options;
+    vector<string> positional;
+    string tracePath;
+    string badOption;
+    size_t budgetMiB = options.memoryBudget >> 20;
+    for (int i = 0; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--top-k" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.topCount)) {
+                badOption = arg;
+            }
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.threshold)) {
+                badOption = arg;
+            }
+            options.topCount = 0;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--binary") {
+            options.binaryOutput = true;
+        } else if (arg == "--float32") {
+            options.halfPrecision = true;
+        } else if (arg == "--pad") {
+            options.padding = FFTPadding::PowerOf2;
+        } else if (arg == "--fft-float") {
+            options.precision = FFTPrecision::Float;
+        } else if (arg == "--fft-batch" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.transformBatch)) {
+                badOption = arg;
+            }
+        } else if (arg == "--stream") {
+            options.streaming = true;
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], budgetMiB) || budgetMiB > (numeric_limits<size_t>::max() >> 20)) {
+                badOption = arg;
+            }
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    options.memoryBudget = budgetMiB << 20;
+    // Without the spectrum in memory the component table has to have a known size, and the
+    // streamed transform only runs in double precision
+    bool streamingConflict = options.streaming && (options.topCount == 0 || options.precision == FFTPrecision::Float);
+    if (!badOption.empty()) {
+        cerr << "invalid value for " << badOption << "\n";
+    }
+    if (!badOption.empty() || positional.size() != 2 || streamingConflict) {
+        cerr << "usage: batch <inputDir> <outputDir> [--top-k n | --threshold t] [--pad] [--fft-float] [--fft-batch n] [--binary [--float32]]\n"
+                "             [--stream [--memory-budget MiB]] [--trace out.json]\n"
+                "--stream works on raw PBM/PGM/PPM files too large for memory, needs --top-k and cannot be combined with --fft-float\n";
+        return 1;
+    }
+    options.inputDir = positional[0];
+    options.outputDir = positional[1];
+
+    BatchReport report;
+    try {
+        report = runBatch(options);
+    } catch (const filesystem::filesystem_error& e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+
+    cout << "Processed " << report.processed << " images (" << report.failed << " failed) in "
+         << report.seconds << " s: " << report.imagesPerSecond << " images/s\n";
+    if (!tracePath.empty()) {
+        printTraceSummary(cout);
+        if (isTracingEnabled() && !writeChromeTrace(tracePath)) {
+            cerr << "Could not write trace to " << tracePath << "\n";
+        }
+    }
+    return report.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include "fourier.h"
+
+using namespace std;
+
+struct BatchOptions {
+    string inputDir;
+    string outputDir;
+    size_t topCount = 32;                     // strongest components kept per image
+    double threshold = 0.1;                   // amplitude cut-off when topCount is 0
+    FFTPadding padding = FFTPadding::Native;
+    size_t queueCapacity = 4;                 // images buffered between two stages
+    bool binaryOutput = false;                // write <name>.spec instead of <name>.txt
+    bool halfPrecision = false;               // .spec values as float32 instead of float64
+    FFTPrecision precision = FFTPrecision::Double;  // in-memory transforms only; streaming is always double
+    size_t transformBatch = 8;                // consecutive same-size images transformed together
+    bool streaming = false;                   // out-of-core thinning and transform, see streaming.h
+    size_t memoryBudget = size_t(256) << 20;  // strip buffer bytes per streamed image
+};
+
+struct BatchReport {
+    size_t processed = 0;
+    size_t failed = 0;
+    double seconds = 0;
+    double imagesPerSecond = 0;
+};
+
+// Headless pipeline over every supported image in inputDir: decode -> thin -> 2D FFT and
+// dominant-frequency extraction. Each stage runs on its own thread and hands images on through a
+// bounded queue, so decoding the next file overlaps the transform of the previous one. Runs of
+// consecutive images with the same size are transformed as one batch of up to transformBatch.
+// Writes <name>.txt (or <name>.spec, see spectrum_file.h) per input into outputDir and reports
+// failures on cerr. In streaming mode images go through one at a time, each as files mapped a
+// strip at a time, and <name>.skeleton.pbm and <name>.spec are always kept.
+BatchReport runBatch(const BatchOptions& options);
+
+// Command line front end: batch <inputDir> <outputDir> [--top-k n | --threshold t] [--pad] [--fft-float] [--fft-batch n]
+//                           [--binary [--float32]]
+//                           [--stream [--memory-budget MiB]] [--trace out.json]
+// Returns the process exit code.
+int runBatchCommand(int argc, char* argv[]);
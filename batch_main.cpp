@@ -0,0 +1,8 @@
+#include "batch.h"
+
+using namespace std;
+
+// SDL-free entry point for headless runs: draw_batch <inputDir> <outputDir> [--top-k n | --threshold t] [--pad] [--binary [--float32]] [--trace out.json]
+int main(int argc, char* argv[]) {
+    return runBatchCommand(argc - 1, argv + 1);
+}
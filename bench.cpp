@@ -0,0 +1,955 @@
+#include "bench_harness.h"
+#include "thinning.h"
+#include "fourier.h"
+#include "thread_pool.h"
+#include "image_io.h"
+#include "streaming.h"
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Synthetic drawings ------------------------------------------------------------------------
+
+static void stamp(BinaryImage& image, int cx, int cy, int radius) {
+    for (int y = max(cy - radius, 0); y <= min(cy + radius, image.rows - 1); ++y) {
+        for (int x = max(cx - radius, 0); x <= min(cx + radius, image.cols - 1); ++x) {
+            if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius) {
+                image.at(y, x) = 1;
+            }
+        }
+    }
+}
+
+// Random-walk pen strokes a few pixels wide
+static BinaryImage makeStrokes(int rows, int cols, uint32_t seed = 1) {
+    BinaryImage image(rows, cols);
+    mt19937 rng(seed);
+    int brush = max(1, min(rows, cols) / 256);
+    int strokes = max(2, min(rows, cols) / 32);
+    int steps = max(rows, cols) * 2;
+    for (int s = 0; s < strokes; ++s) {
+        double x = rng() % cols, y = rng() % rows;
+        double angle = (rng() % 628) / 100.0;
+        for (int i = 0; i < steps; ++i) {
+            angle += ((rng() % 200) / 1000.0) - 0.1;
+            x = clamp(x + cos(angle), 0.0, cols - 1.0);
+            y = clamp(y + sin(angle), 0.0, rows - 1.0);
+            stamp(image, static_cast<int>(x), static_cast<int>(y), brush);
+        }
+    }
+    return image;
+}
+
+// Filled circles and rectangles: thick blobs that take many thinning iterations
+static BinaryImage makeShapes(int rows, int cols, uint32_t seed = 2) {
+    BinaryImage image(rows, cols);
+    mt19937 rng(seed);
+    int count = max(3, min(rows, cols) / 48);
+    for (int i = 0; i < count; ++i) {
+        int cx = rng() % cols, cy = rng() % rows;
+        int radius = 4 + rng() % max(4, min(rows, cols) / 10);
+        if (i % 2 == 0) {
+            stamp(image, cx, cy, radius);
+        } else {
+            for (int y = max(cy - radius, 0); y < min(cy + radius, rows); ++y) {
+                for (int x = max(cx - radius / 2, 0); x < min(cx + radius * 2, cols); ++x) {
+                    image.at(y, x) = 1;
+                }
+            }
+        }
+    }
+    return image;
+}
+
+// 5x7 bitmap text, scaled so glyph strokes are several pixels wide
+static BinaryImage makeGlyphs(int rows, int cols) {
+    static const char* const text = "FOURIER DRAW";
+    static const uint8_t font[][7] = {
+        {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},  // F
+        {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // O
+        {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},  // U
+        {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},  // R
+        {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},  // I
+        {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},  // E
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // space
+        {0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E},  // D
+        {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},  // A
+        {0x11, 0x11, 0x11, 0x15, 0x15, 0x1B, 0x11},  // W
+    };
+    static const char glyphOrder[] = "FOURIE DAW";
+
+    BinaryImage image(rows, cols);
+    int length = strlen(text);
+    int scale = max(1, cols / (length * 6 + 2));
+    int lineHeight = 9 * scale;
+    for (int top = scale; top + 7 * scale < rows; top += lineHeight) {
+        for (int i = 0; i < length; ++i) {
+            const uint8_t* glyph = font[strchr(glyphOrder, text[i]) - glyphOrder];
+            int left = scale + i * 6 * scale;
+            for (int gy = 0; gy < 7 * scale; ++gy) {
+                for (int gx = 0; gx < 5 * scale && left + gx < cols; ++gx) {
+                    if ((glyph[gy / scale] >> (4 - gx / scale)) & 1) {
+                        image.at(top + gy, left + gx) = 1;
+                    }
+                }
+            }
+        }
+    }
+    return image;
+}
+
+static vector<vector<int>> toMatrix(const BinaryImage& image) {
+    vector<vector<int>> matrix;
+    copyToPixelMatrix(image, matrix);
+    return matrix;
+}
+
+static vector<complex<double>> makeSignal(size_t length, uint32_t seed = 3) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> value(-1.0, 1.0);
+    vector<complex<double>> signal(length);
+    for (complex<double>& v : signal) {
+        v = {value(rng), value(rng)};
+    }
+    return signal;
+}
+
+// Benchmarks --------------------------------------------------------------------------------
+
+static const vector<int64_t> imageSizes = {64, 256, 1024, 2048, 4096};
+
+static void registerThinningBenchmarks() {
+    struct Input {
+        const char* name;
+        BinaryImage (*make)(int, int);
+    };
+    static const Input inputs[] = {
+        {"strokes", [](int r, int c) { return makeStrokes(r, c); }},
+        {"shapes", [](int r, int c) { return makeShapes(r, c); }},
+        {"glyphs", makeGlyphs},
+    };
+
+    for (const Input& input : inputs) {
+        auto make = input.make;
+        registerBenchmark(string("createSkeleton/") + input.name, imageSizes, [make](BenchState& state) {
+            int n = state.size();
+            vector<vector<int>> original = toMatrix(make(n, n)), work;
+            while (state.keepRunning()) {
+                state.pauseTiming();
+                work = original;
+                state.resumeTiming();
+                createSkeleton(work);
+            }
+            state.setItemsPerIteration(n * n);
+        });
+        registerBenchmark(string("createSkeletonFrontier/") + input.name, imageSizes, [make](BenchState& state) {
+            int n = state.size();
+            vector<vector<int>> original = toMatrix(make(n, n)), work;
+            while (state.keepRunning()) {
+                state.pauseTiming();
+                work = original;
+                state.resumeTiming();
+                createSkeleton(work, ThinningMode::Frontier);
+            }
+            state.setItemsPerIteration(n * n);
+        });
+        registerBenchmark(string("createSkeletonParallel/") + input.name, imageSizes, [make](BenchState& state) {
+            int n = state.size();
+            vector<vector<int>> original = toMatrix(make(n, n)), work;
+            while (state.keepRunning()) {
+                state.pauseTiming();
+                work = original;
+                state.resumeTiming();
+                createSkeletonParallel(work);
+            }
+            state.setItemsPerIteration(n * n);
+        });
+    }
+
+    registerBenchmark("thinImageFrontier/arena/strokes", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        BinaryImage original = makeStrokes(n, n), work;
+        Arena scratch;
+        while (state.keepRunning()) {
+            state.pauseTiming();
+            work = original;
+            scratch.reset();
+            state.resumeTiming();
+            thinImageFrontier(work.view(), nullptr, &scratch);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+
+    registerBenchmark("getMarkedPixelsPhaseOne/strokes", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        vector<vector<int>> matrix = toMatrix(makeStrokes(n, n));
+        while (state.keepRunning()) {
+            getMarkedPixelsPhaseOne(matrix);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+    registerBenchmark("getMarkedPixelsPhaseTwo/strokes", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        vector<vector<int>> matrix = toMatrix(makeStrokes(n, n));
+        while (state.keepRunning()) {
+            getMarkedPixelsPhaseTwo(matrix);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+}
+
+static void registerFourierBenchmarks() {
+    // 1D transforms of n * n points, capped to keep memory sane
+    const size_t maxSignal = size_t(1) << 22;
+    registerBenchmark("FFT/pow2", imageSizes, [maxSignal](BenchState& state) {
+        size_t length = state.size() * state.size();
+        if (length > maxSignal) {
+            state.skip("signal longer than 2^22");
+            return;
+        }
+        vector<complex<double>> signal = makeSignal(length);
+        while (state.keepRunning()) {
+            FFT(signal);
+        }
+        state.setItemsPerIteration(length);
+    });
+    registerBenchmark("FFT/float", imageSizes, [maxSignal](BenchState& state) {
+        size_t length = state.size() * state.size();
+        if (length > maxSignal) {
+            state.skip("signal longer than 2^22");
+            return;
+        }
+        vector<complex<double>> signal = makeSignal(length);
+        vector<complex<float>> floatSignal(signal.begin(), signal.end());
+        while (state.keepRunning()) {
+            FFT(floatSignal);
+        }
+        state.setItemsPerIteration(length);
+    });
+    registerBenchmark("FFT/native", imageSizes, [maxSignal](BenchState& state) {
+        size_t length = state.size() * state.size() * 3 / 4;
+        if (length > maxSignal) {
+            state.skip("signal longer than 2^22");
+            return;
+        }
+        vector<complex<double>> signal = makeSignal(length);
+        while (state.keepRunning()) {
+            FFT(signal, FFTPadding::Native);
+        }
+        state.setItemsPerIteration(length);
+    });
+
+    struct Variant {
+        const char* name;
+        FFTPadding padding;
+        FFTBackend backend;
+        bool pool;
+        bool nonPowerOf2;
+        FFTPrecision precision = FFTPrecision::Double;
+    };
+    static const Variant variants[] = {
+        {"DFT2DFFT/pow2", FFTPadding::PowerOf2, FFTBackend::InHouse, false, false},
+        {"DFT2DFFT/native", FFTPadding::Native, FFTBackend::InHouse, false, true},
+        {"DFT2DFFT/pool", FFTPadding::PowerOf2, FFTBackend::InHouse, true, false},
+        {"DFT2DFFT/fftw", FFTPadding::PowerOf2, FFTBackend::FFTW, false, false},
+        {"DFT2DFFT/float", FFTPadding::PowerOf2, FFTBackend::InHouse, false, false, FFTPrecision::Float},
+    };
+    for (const Variant& variant : variants) {
+        registerBenchmark(variant.name, imageSizes, [variant](BenchState& state) {
+            int rows = variant.nonPowerOf2 ? state.size() * 3 / 4 : state.size();
+            int cols = state.size();
+            vector<vector<int>> matrix = toMatrix(makeStrokes(rows, cols));
+            ThreadPool* pool = variant.pool ? &getDefaultThreadPool() : nullptr;
+            while (state.keepRunning()) {
+                DFT2DFFT(matrix, pool, variant.padding, variant.backend, variant.precision);
+            }
+            state.setItemsPerIteration(static_cast<uint64_t>(rows) * cols);
+        });
+    }
+
+    registerBenchmark("DFT2DRealFFT", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        vector<vector<int>> matrix = toMatrix(makeStrokes(n, n));
+        while (state.keepRunning()) {
+            DFT2DRealFFT(matrix);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+
+    registerBenchmark("DFT2DRealFFT/float/arena", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        BinaryImage image = makeStrokes(n, n);
+        Arena scratch;
+        while (state.keepRunning()) {
+            scratch.reset();
+            Matrix<complex<float>> spectrum(n, n / 2 + 1, scratch);
+            DFT2DRealFFT(image.view(), spectrum, n);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+    registerBenchmark("DFT2DRealFFT/arena", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        BinaryImage image = makeStrokes(n, n);
+        Arena scratch;
+        while (state.keepRunning()) {
+            scratch.reset();
+            Matrix<complex<double>> spectrum(n, n / 2 + 1, scratch);
+            DFT2DRealFFT(image.view(), spectrum, n);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+
+    // A batch of same-size images per iteration, so ns/item is the time per image. "loop" is the
+    // per-image view overload over the same block, for comparison.
+    struct BatchVariant {
+        const char* name;
+        bool batched;
+        FFTBackend backend;
+        FFTPrecision precision;
+    };
+    static const BatchVariant batchVariants[] = {
+        {"DFT2DRealFFT/loop16", false, FFTBackend::InHouse, FFTPrecision::Double},
+        {"DFT2DRealFFT/batch16", true, FFTBackend::InHouse, FFTPrecision::Double},
+        {"DFT2DRealFFT/batch16/fftw", true, FFTBackend::FFTW, FFTPrecision::Double},
+        {"DFT2DRealFFT/batch16/float", true, FFTBackend::InHouse, FFTPrecision::Float},
+    };
+    for (const BatchVariant& variant : batchVariants) {
+        registerBenchmark(variant.name, imageSizes, [variant](BenchState& state) {
+            const size_t count = 16;
+            size_t n = state.size();
+            if (count * n * n > (size_t(1) << 24)) {
+                state.skip("batch larger than 2^24 pixels");
+                return;
+            }
+            Matrix<uint8_t> stacked(count * n, n);
+            MatrixBatchView<uint8_t> images(stacked.view(), count);
+            for (size_t i = 0; i < count; ++i) {
+                BinaryImage image = makeStrokes(n, n, 10 + i);
+                copy(image.pixels.begin(), image.pixels.end(), images[i].data);
+            }
+            Matrix<complex<double>> spectra(count * n, n / 2 + 1);
+            Matrix<complex<float>> floatSpectra(variant.precision == FFTPrecision::Float ? count * n : 0, n / 2 + 1);
+            while (state.keepRunning()) {
+                if (!variant.batched) {
+                    for (size_t i = 0; i < count; ++i) {
+                        DFT2DRealFFT(images[i], MatrixBatchView<complex<double>>(spectra.view(), count)[i], n);
+                    }
+                } else if (variant.precision == FFTPrecision::Float) {
+                    DFT2DRealFFT(images, MatrixBatchView<complex<float>>(floatSpectra.view(), count), n);
+                } else {
+                    DFT2DRealFFT(images, MatrixBatchView<complex<double>>(spectra.view(), count), n, nullptr, variant.backend);
+                }
+            }
+            state.setItemsPerIteration(count);
+        });
+    }
+
+    // Direct transforms grow as n^3, so only the small sizes are run
+    registerBenchmark("DFT2D", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        if (n > 256) {
+            state.skip("O(n^3) reference");
+            return;
+        }
+        vector<vector<int>> matrix = toMatrix(makeStrokes(n, n));
+        while (state.keepRunning()) {
+            DFT2D(matrix);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+    registerBenchmark("DFT2DBins/lowest16", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        BinaryImage image = makeStrokes(n, n);
+        vector<SpectrumBin> bins;
+        for (size_t k = 0; k < 4; ++k) {
+            for (size_t l = 0; l < 4; ++l) {
+                bins.push_back({k, l});
+            }
+        }
+        while (state.keepRunning()) {
+            DFT2DBins(image.view(), bins);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+
+    registerBenchmark("transposeMatrix", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        vector<vector<complex<double>>> matrix(n, vector<complex<double>>(n, 1.0));
+        while (state.keepRunning()) {
+            transposeMatrix(matrix);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+
+    registerBenchmark("transposeMatrix/view", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        Matrix<complex<double>> matrix(n, n), transposed(n, n);
+        while (state.keepRunning()) {
+            transposeMatrix(matrix, transposed);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+
+    registerBenchmark("performIFFT/fftw", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        vector<vector<int>> matrix = toMatrix(makeStrokes(n, n));
+        vector<vector<complex<double>>> spectrum = DFT2DFFT(matrix), result;
+        while (state.keepRunning()) {
+            performIFFT(spectrum, result);
+        }
+        state.setItemsPerIteration(n * n);
+    });
+    registerBenchmark("performIFFT/pool", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        vector<vector<int>> matrix = toMatrix(makeStrokes(n, n));
+        vector<vector<complex<double>>> spectrum = DFT2DFFT(matrix), result;
+        while (state.keepRunning()) {
+            performIFFT(spectrum, result, &getDefaultThreadPool());
+        }
+        state.setItemsPerIteration(n * n);
+    });
+}
+
+// Scratch file for the streaming benchmarks and checks, in the system temp directory
+static string getTempPath(const string& name) {
+    return (filesystem::temp_directory_path() / ("draw_bench_" + name)).string();
+}
+
+static bool writeBitmap(const string& path, const BinaryImage& image) {
+    MappedBinaryImage file;
+    string error;
+    if (!file.create(path, image.rows, image.cols, error)) {
+        return false;
+    }
+    file.writeRows(0, image.view());
+    return file.close(error);
+}
+
+// Whole passes through memory-mapped files, page cache included; compare with thinImage and
+// DFT2DRealFFT/arena for the cost of streaming
+static void registerStreamingBenchmarks() {
+    registerBenchmark("thinImageStreaming/strokes/16MiB", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        string inputPath = getTempPath("stream_in.pbm"), outputPath = getTempPath("stream_out.pbm");
+        if (!writeBitmap(inputPath, makeStrokes(n, n))) {
+            state.skip("cannot write " + inputPath);
+            return;
+        }
+        StreamingOptions options;
+        options.memoryBudget = size_t(16) << 20;
+        string error;
+        while (state.keepRunning()) {
+            thinImageStreaming(inputPath, outputPath, options, nullptr, error);
+        }
+        state.setItemsPerIteration(n * n);
+        filesystem::remove(inputPath);
+        filesystem::remove(outputPath);
+    });
+    registerBenchmark("DFT2DRealFFTStreaming/16MiB", imageSizes, [](BenchState& state) {
+        int n = state.size();
+        string inputPath = getTempPath("stream_in.pbm"), outputPath = getTempPath("stream_out.spec");
+        if (!writeBitmap(inputPath, makeStrokes(n, n))) {
+            state.skip("cannot write " + inputPath);
+            return;
+        }
+        StreamingOptions options;
+        options.memoryBudget = size_t(16) << 20;
+        string error;
+        while (state.keepRunning()) {
+            DFT2DRealFFTStreaming(inputPath, outputPath, FFTPadding::Native, SpectrumDType::Float64, 32, options, nullptr, error);
+        }
+        state.setItemsPerIteration(n * n);
+        filesystem::remove(inputPath);
+        filesystem::remove(outputPath);
+    });
+}
+
+// Golden-output checks ----------------------------------------------------------------------
+// Every fast path against the reference implementation it replaced (or a direct DFT).
+
+static int failedChecks = 0;
+
+static void reportCheck(const string& name, bool passed, const string& detail = "") {
+    cout << (passed ? "PASS  " : "FAIL  ") << name << (detail.empty() ? "" : "  (" + detail + ")") << "\n";
+    failedChecks += !passed;
+}
+
+static double maxRelativeError(const vector<vector<complex<double>>>& a, const vector<vector<complex<double>>>& b) {
+    if (a.size() != b.size()) {
+        return INFINITY;
+    }
+    double maxError = 0, maxValue = 1e-300;
+    for (size_t r = 0; r < a.size(); ++r) {
+        if (a[r].size() != b[r].size()) {
+            return INFINITY;
+        }
+        for (size_t c = 0; c < a[r].size(); ++c) {
+            maxError = max(maxError, abs(a[r][c] - b[r][c]));
+            maxValue = max(maxValue, abs(b[r][c]));
+        }
+    }
+    return maxError / maxValue;
+}
+
+template <typename T>
+static vector<vector<complex<double>>> toNested(MatrixView<const complex<T>> view) {
+    vector<vector<complex<double>>> matrix(view.rows);
+    for (size_t r = 0; r < view.rows; ++r) {
+        matrix[r].assign(view.row(r), view.row(r) + view.cols);
+    }
+    return matrix;
+}
+
+static string errorText(double error) {
+    ostringstream text;
+    text << "max relative error " << error;
+    return text.str();
+}
+
+static void runThinningChecks() {
+    struct Case {
+        string name;
+        BinaryImage image;
+    };
+    vector<Case> cases = {
+        {"strokes 128x128", makeStrokes(128, 128)},
+        {"shapes 150x200", makeShapes(150, 200)},
+        {"glyphs 97x301", makeGlyphs(97, 301)},
+    };
+    for (const Case& c : cases) {
+        vector<vector<int>> reference = toMatrix(c.image);
+        createSkeletonReference(reference);
+
+        vector<vector<int>> work = toMatrix(c.image);
+        reportCheck("createSkeleton " + c.name, createSkeleton(work) == reference);
+        work = toMatrix(c.image);
+        reportCheck("createSkeleton frontier " + c.name, createSkeleton(work, ThinningMode::Frontier) == reference);
+        work = toMatrix(c.image);
+        reportCheck("createSkeletonParallel " + c.name, createSkeletonParallel(work, 3) == reference);
+
+        const pair<ThinningKernel, const char*> kernels[] = {
+            {ThinningKernel::Scalar, "scalar"}, {ThinningKernel::SSSE3, "ssse3"}, {ThinningKernel::AVX2, "avx2"}};
+        for (const auto& [kernel, kernelName] : kernels) {
+            if (!setThinningKernel(kernel)) {
+                cout << "SKIP  thinning kernel " << kernelName << " (not supported by this CPU)\n";
+                continue;
+            }
+            work = toMatrix(c.image);
+            reportCheck(string("thinning kernel ") + kernelName + " " + c.name, createSkeleton(work) == reference);
+        }
+        setThinningKernel(ThinningKernel::Auto);
+
+        // Views onto a block of a wider arena matrix, so rows are not contiguous
+        Arena scratch;
+        for (bool frontier : {false, true}) {
+            Matrix<uint8_t> canvas(c.image.rows + 4, c.image.cols + 7, scratch);
+            MatrixView<uint8_t> block = canvas.view().block(2, 3, c.image.rows, c.image.cols);
+            for (int r = 0; r < c.image.rows; ++r) {
+                copy(c.image.row(r), c.image.row(r) + c.image.cols, block.row(r));
+            }
+            if (frontier) {
+                thinImageFrontier(block, nullptr, &scratch);
+            } else {
+                thinImage(block, nullptr, &scratch);
+            }
+            bool same = true;
+            for (int r = 0; same && r < c.image.rows; ++r) {
+                same = equal(block.row(r), block.row(r) + c.image.cols, reference[r].begin());
+            }
+            reportCheck(string(frontier ? "thinImageFrontier" : "thinImage") + " strided view " + c.name, same);
+        }
+    }
+}
+
+static void runFourierChecks() {
+    for (size_t length : {64, 100, 97, 1000, 4096}) {
+        vector<complex<double>> signal = makeSignal(length);
+        vector<complex<double>> direct(length, 0);
+        for (size_t k = 0; k < length; ++k) {
+            for (size_t n = 0; n < length; ++n) {
+                direct[k] += signal[n] * polar(1.0, -2.0 * numbers::pi * double((k * n) % length) / length);
+            }
+        }
+        vector<complex<double>> fast = FFT(signal, FFTPadding::Native);
+        double error = maxRelativeError({fast}, {direct});
+        reportCheck("FFT native " + to_string(length), error < 1e-9, errorText(error));
+
+        vector<complex<float>> floatSignal(signal.begin(), signal.end());
+        vector<complex<float>> floatResult = FFT(floatSignal, FFTPadding::Native);
+        error = maxRelativeError({vector<complex<double>>(floatResult.begin(), floatResult.end())}, {direct});
+        reportCheck("FFT float " + to_string(length), error < 1e-5, errorText(error));
+    }
+
+    // Split kernels, with single and interleaved transforms, against the complex<double> path
+    const pair<FFTKernel, const char*> fftKernels[] = {{FFTKernel::Scalar, "scalar"}, {FFTKernel::AVX2, "avx2"}};
+    for (const auto& [kernel, kernelName] : fftKernels) {
+        if (!setFFTKernel(kernel)) {
+            cout << "SKIP  split FFT kernel " << kernelName << " (not supported by this CPU)\n";
+            continue;
+        }
+        for (size_t length : {2, 8, 32, 512, 2048}) {
+            for (size_t batch : {1, 3, 16}) {
+                vector<complex<double>> signal = makeSignal(length * batch);
+                vector<double> re(length * batch), im(length * batch);
+                vector<float> reFloat(length * batch), imFloat(length * batch);
+                for (size_t i = 0; i < signal.size(); ++i) {
+                    re[i] = signal[i].real();
+                    im[i] = signal[i].imag();
+                    reFloat[i] = static_cast<float>(re[i]);
+                    imFloat[i] = static_cast<float>(im[i]);
+                }
+                executeSplitFFT(getSplitFFTPlan<double>(length), re.data(), im.data(), batch);
+                executeSplitFFT(getSplitFFTPlan<float>(length), reFloat.data(), imFloat.data(), batch);
+
+                double doubleError = 0, floatError = 0;
+                for (size_t j = 0; j < batch; ++j) {
+                    vector<complex<double>> column(length), splitDouble(length), splitFloat(length);
+                    for (size_t i = 0; i < length; ++i) {
+                        column[i] = signal[i * batch + j];
+                        splitDouble[i] = {re[i * batch + j], im[i * batch + j]};
+                        splitFloat[i] = {reFloat[i * batch + j], imFloat[i * batch + j]};
+                    }
+                    vector<complex<double>> expected = FFT(column);
+                    doubleError = max(doubleError, maxRelativeError({splitDouble}, {expected}));
+                    floatError = max(floatError, maxRelativeError({splitFloat}, {expected}));
+                }
+                string name = string("split FFT ") + kernelName + " " + to_string(length) + " x" + to_string(batch);
+                reportCheck(name + " double", doubleError < 1e-12, errorText(doubleError));
+                reportCheck(name + " float", floatError < 1e-5, errorText(floatError));
+            }
+        }
+    }
+    setFFTKernel(FFTKernel::Auto);
+
+    for (auto [rows, cols] : {pair<int, int>{32, 32}, {24, 20}, {21, 35}}) {
+        string shape = to_string(rows) + "x" + to_string(cols);
+        vector<vector<int>> matrix = toMatrix(makeStrokes(rows, cols));
+        vector<vector<complex<double>>> direct = DFT2D(matrix);
+
+        // The separable reference itself against the per-bin definition
+        vector<vector<complex<double>>> definition(rows, vector<complex<double>>(cols));
+        for (int k = 0; k < rows; ++k) {
+            for (int l = 0; l < cols; ++l) {
+                definition[k][l] = calculateDFT2D(matrix, k, l);
+            }
+        }
+        double error = maxRelativeError(direct, definition);
+        reportCheck("DFT2D definition " + shape, error < 1e-9, errorText(error));
+
+        vector<SpectrumBin> bins = {{0, 0}, {1, 0}, {0, 1}, {2, 3}, {size_t(rows - 1), size_t(cols - 2)}, {1, 0}};
+        vector<complex<double>> values = DFT2DBins(matrix, bins);
+        vector<complex<double>> expected;
+        for (const SpectrumBin& bin : bins) {
+            expected.push_back(direct[bin.k][bin.l]);
+        }
+        error = maxRelativeError({values}, {expected});
+        reportCheck("DFT2DBins " + shape, error < 1e-12, errorText(error));
+
+        error = maxRelativeError(DFT2DFFT(matrix, nullptr, FFTPadding::Native), direct);
+        reportCheck("DFT2DFFT native " + shape, error < 1e-9, errorText(error));
+        error = maxRelativeError(DFT2DFFT(matrix, &getDefaultThreadPool(), FFTPadding::Native), direct);
+        reportCheck("DFT2DFFT pool " + shape, error < 1e-9, errorText(error));
+
+        vector<vector<complex<double>>> full = DFT2DFFT(matrix, nullptr, FFTPadding::Native);
+        vector<vector<complex<double>>> half = DFT2DRealFFT(matrix, nullptr, FFTPadding::Native);
+        vector<vector<complex<double>>> expectedHalf(rows);
+        for (int r = 0; r < rows; ++r) {
+            expectedHalf[r].assign(full[r].begin(), full[r].begin() + cols / 2 + 1);
+        }
+        error = maxRelativeError(half, expectedHalf);
+        reportCheck("DFT2DRealFFT " + shape, error < 1e-9, errorText(error));
+
+        error = maxRelativeError(DFT2DFFT(matrix, nullptr, FFTPadding::PowerOf2, FFTBackend::InHouse, FFTPrecision::Float), DFT2DFFT(matrix));
+        reportCheck("DFT2DFFT float pow2 " + shape, error < 1e-5, errorText(error));
+
+        // View overloads write into arena storage, here with a row stride wider than the transform
+        Arena scratch;
+        BinaryImage image = toBinaryImage(matrix);
+        Matrix<complex<double>> wide(rows, cols + 5, scratch);
+        MatrixView<complex<double>> fullView = wide.view().block(0, 0, rows, cols);
+        DFT2DFFT(image.view(), fullView);
+        error = maxRelativeError(toNested<double>(fullView), full);
+        reportCheck("DFT2DFFT view " + shape, error < 1e-12, errorText(error));
+        MatrixView<complex<double>> halfView = wide.view().block(0, 0, rows, cols / 2 + 1);
+        DFT2DRealFFT(image.view(), halfView, cols);
+        error = maxRelativeError(toNested<double>(halfView), half);
+        reportCheck("DFT2DRealFFT view " + shape, error < 1e-12, errorText(error));
+
+        // Single precision views; odd sizes stay in float storage but go through the double plans
+        Matrix<complex<float>> floatFull(rows, cols, scratch);
+        DFT2DFFT(image.view(), floatFull, nullptr);
+        error = maxRelativeError(toNested<float>(floatFull), direct);
+        reportCheck("DFT2DFFT float " + shape, error < 1e-5, errorText(error));
+        Matrix<complex<float>> floatHalf(rows, cols / 2 + 1, scratch);
+        DFT2DRealFFT(image.view(), floatHalf, cols, &getDefaultThreadPool());
+        error = maxRelativeError(toNested<float>(floatHalf), expectedHalf);
+        reportCheck("DFT2DRealFFT float " + shape, error < 1e-5, errorText(error));
+
+        Matrix<complex<double>> transposed(cols, rows, scratch);
+        DFT2DFFT(image.view(), fullView);
+        transposeMatrix(fullView, transposed);
+        reportCheck("transposeMatrix view " + shape, toNested<double>(transposed) == transposeMatrix(toNested<double>(fullView)));
+
+        vector<vector<complex<double>>> padded = DFT2DFFT(matrix);
+        error = maxRelativeError(DFT2DFFT(matrix, nullptr, FFTPadding::PowerOf2, FFTBackend::FFTW), padded);
+        reportCheck("DFT2DFFT fftw " + shape, error < 1e-9, errorText(error));
+
+        // Inverse recovers the (padded) input
+        vector<vector<complex<double>>> inverse;
+        performIFFT(padded, inverse);
+        vector<vector<complex<double>>> input(inverse.size(), vector<complex<double>>(inverse[0].size(), 0));
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                input[r][c] = matrix[r][c];
+            }
+        }
+        error = maxRelativeError(inverse, input);
+        reportCheck("performIFFT round trip " + shape, error < 1e-9, errorText(error));
+
+        Matrix<complex<double>> paddedGrid(padded.size(), padded[0].size());
+        DFT2DFFT(image.view(), paddedGrid);
+        performIFFT(paddedGrid, paddedGrid);
+        error = maxRelativeError(toNested<double>(paddedGrid), input);
+        reportCheck("performIFFT view round trip " + shape, error < 1e-9, errorText(error));
+
+        // Top-K matches the strongest entries of the full threshold scan
+        vector<FrequencyComponent> all = extractDominantFrequencies(full, 0.0);
+        sort(all.begin(), all.end(), [](const FrequencyComponent& a, const FrequencyComponent& b) { return a.amplitude > b.amplitude; });
+        vector<FrequencyComponent> top = extractTopFrequencies(full, 10, 0, false);
+        bool same = top.size() == min<size_t>(10, all.size());
+        for (size_t i = 0; same && i < top.size(); ++i) {
+            same = abs(top[i].amplitude - all[i].amplitude) <= 1e-9 * all[0].amplitude;
+        }
+        reportCheck("extractTopFrequencies " + shape, same);
+
+        // Fed in uneven row strips, the running top-K picks the same bins
+        vector<FrequencyComponent> whole = extractTopFrequencies(full, 10);
+        TopFrequencyCollector collector(10, full.size());
+        for (size_t top = 0; top < full.size(); top += 7) {
+            collector.addRows(vector<vector<complex<double>>>(full.begin() + top, full.begin() + min(full.size(), top + 7)), top);
+        }
+        vector<FrequencyComponent> collected = collector.finish();
+        same = collected.size() == whole.size();
+        for (size_t i = 0; same && i < whole.size(); ++i) {
+            same = collected[i].k == whole[i].k && collected[i].l == whole[i].l && collected[i].hasConjugate == whole[i].hasConjugate &&
+                   collected[i].amplitude == whole[i].amplitude;
+        }
+        reportCheck("TopFrequencyCollector strips " + shape, same);
+    }
+
+    // Batched transforms against the per-image view overloads. 35 images cover a partial block;
+    // the images sit in a wider matrix, so rows and images are strided.
+    struct BatchCase {
+        int rows, cols;
+        size_t transformRows, transformCols;
+    };
+    for (const BatchCase& batchCase : {BatchCase{32, 32, 32, 32}, {24, 20, 32, 32}, {21, 35, 21, 35}}) {
+        auto [rows, cols, transformRows, transformCols] = batchCase;
+        size_t halfCols = transformCols / 2 + 1;
+        for (size_t count : {1, 5, 35}) {
+            string shape = to_string(rows) + "x" + to_string(cols) + " x" + to_string(count);
+            Matrix<uint8_t> stacked(count * rows, cols + 3);
+            MatrixBatchView<uint8_t> images(stacked.view().block(0, 0, count * rows, cols), count);
+            for (size_t i = 0; i < count; ++i) {
+                BinaryImage image = makeStrokes(rows, cols, 10 + i);
+                for (int r = 0; r < rows; ++r) {
+                    copy(image.row(r), image.row(r) + cols, images[i].row(r));
+                }
+            }
+            Matrix<complex<double>> full(count * transformRows, transformCols), half(count * transformRows, halfCols);
+            Matrix<complex<double>> single(transformRows, transformCols), singleHalf(transformRows, halfCols);
+            Matrix<complex<float>> fullFloat(count * transformRows, transformCols), halfFloat(count * transformRows, halfCols);
+            MatrixBatchView<complex<double>> spectra(full.view(), count), halfSpectra(half.view(), count);
+            DFT2DFFT(images, spectra, &getDefaultThreadPool());
+            DFT2DRealFFT(images, halfSpectra, transformCols, &getDefaultThreadPool());
+            DFT2DFFT(images, MatrixBatchView<complex<float>>(fullFloat.view(), count));
+            DFT2DRealFFT(images, MatrixBatchView<complex<float>>(halfFloat.view(), count), transformCols);
+
+            double fullError = 0, halfError = 0, floatError = 0;
+            for (size_t i = 0; i < count; ++i) {
+                DFT2DFFT(images[i], single);
+                DFT2DRealFFT(images[i], singleHalf, transformCols);
+                vector<vector<complex<double>>> expected = toNested<double>(single), expectedHalf = toNested<double>(singleHalf);
+                fullError = max(fullError, maxRelativeError(toNested<double>(spectra[i]), expected));
+                halfError = max(halfError, maxRelativeError(toNested<double>(halfSpectra[i]), expectedHalf));
+                floatError = max(floatError, maxRelativeError(toNested<float>(MatrixBatchView<complex<float>>(fullFloat.view(), count)[i]), expected));
+                floatError = max(floatError, maxRelativeError(toNested<float>(MatrixBatchView<complex<float>>(halfFloat.view(), count)[i]), expectedHalf));
+            }
+            reportCheck("DFT2DFFT batch " + shape, fullError < 1e-12, errorText(fullError));
+            reportCheck("DFT2DRealFFT batch " + shape, halfError < 1e-12, errorText(halfError));
+            reportCheck("DFT2DFFT float batch " + shape, floatError < 1e-5, errorText(floatError));
+
+            Matrix<complex<double>> fftwFull(count * transformRows, transformCols), fftwHalf(count * transformRows, halfCols);
+            DFT2DFFT(images, MatrixBatchView<complex<double>>(fftwFull.view(), count), nullptr, FFTBackend::FFTW);
+            DFT2DRealFFT(images, MatrixBatchView<complex<double>>(fftwHalf.view(), count), transformCols, nullptr, FFTBackend::FFTW);
+            double fftwError = max(maxRelativeError(toNested<double>(fftwFull.view()), toNested<double>(full.view())),
+                                   maxRelativeError(toNested<double>(fftwHalf.view()), toNested<double>(half.view())));
+            reportCheck("DFT2D batch fftw " + shape, fftwError < 1e-9, errorText(fftwError));
+
+            // Both inverses give back the zero-padded images
+            Matrix<complex<double>> expectedInput(count * transformRows, transformCols), inverse(count * transformRows, transformCols);
+            for (size_t i = 0; i < count; ++i) {
+                for (int r = 0; r < rows; ++r) {
+                    copy(images[i].row(r), images[i].row(r) + cols, MatrixBatchView<complex<double>>(expectedInput.view(), count)[i].row(r));
+                }
+            }
+            performIFFT(MatrixBatchView<complex<double>>(fftwFull.view(), count), MatrixBatchView<complex<double>>(inverse.view(), count),
+                        nullptr, FFTBackend::FFTW);
+            double inverseError = maxRelativeError(toNested<double>(inverse.view()), toNested<double>(expectedInput.view()));
+            performIFFT(spectra, spectra, &getDefaultThreadPool());
+            inverseError = max(inverseError, maxRelativeError(toNested<double>(full.view()), toNested<double>(expectedInput.view())));
+            reportCheck("performIFFT batch round trip " + shape, inverseError < 1e-9, errorText(inverseError));
+        }
+    }
+}
+
+// Streamed thinning and transform against the in-memory engines, with budgets small enough to
+// force many strips
+static void runStreamingChecks() {
+    struct Case {
+        string name;
+        BinaryImage image;
+        int haloRows;
+    };
+    vector<Case> cases = {
+        {"strokes 300x200", makeStrokes(300, 200), 8},
+        {"shapes 150x200", makeShapes(150, 200), 4},
+        {"glyphs 97x301", makeGlyphs(97, 301), 6},
+    };
+    string inputPath = getTempPath("check_in.pbm");
+    string skeletonPath = getTempPath("check_skeleton.pbm");
+    string spectrumPath = getTempPath("check.spec");
+    for (const Case& c : cases) {
+        if (!writeBitmap(inputPath, c.image)) {
+            reportCheck("streaming input " + c.name, false, "cannot write " + inputPath);
+            continue;
+        }
+        BinaryImage expected = c.image;
+        ThinningStats expectedStats, stats;
+        thinImage(expected, &expectedStats);
+
+        StreamingOptions options;
+        options.haloRows = c.haloRows;
+        options.memoryBudget = 2 * c.image.cols * (3 * c.haloRows + 2 * c.haloRows);
+        string error;
+        BinaryImage skeleton;
+        bool ok = thinImageStreaming(inputPath, skeletonPath, options, &stats, error) && loadBinaryImage(skeletonPath, skeleton, error);
+        reportCheck("thinImageStreaming " + c.name, ok && skeleton.pixels == expected.pixels, error);
+        // Skipped strips and strips that stop early visit fewer pixels, never more
+        bool visitedBounded = stats.visitedPerPass.size() == expectedStats.visitedPerPass.size();
+        for (size_t i = 0; visitedBounded && i < stats.visitedPerPass.size(); ++i) {
+            visitedBounded = stats.visitedPerPass[i] <= expectedStats.visitedPerPass[i];
+        }
+        reportCheck("thinImageStreaming stats " + c.name,
+                    stats.iterations == expectedStats.iterations && stats.deletedPerPass == expectedStats.deletedPerPass && visitedBounded);
+        options.pool = &getDefaultThreadPool();
+        ok = thinImageStreaming(inputPath, skeletonPath, options, nullptr, error) && loadBinaryImage(skeletonPath, skeleton, error);
+        reportCheck("thinImageStreaming pool " + c.name, ok && skeleton.pixels == expected.pixels, error);
+
+        // Room for a few rows or columns of the transform at a time
+        options.memoryBudget = 64 * 1024;
+        for (FFTPadding padding : {FFTPadding::Native, FFTPadding::PowerOf2}) {
+            size_t transformRows = getTransformSize(expected.rows, padding);
+            size_t transformCols = getTransformSize(expected.cols, padding);
+            Matrix<complex<double>> half(transformRows, transformCols / 2 + 1);
+            DFT2DRealFFT(expected.view(), half.view(), transformCols);
+            vector<FrequencyComponent> expectedTop = extractTopFrequencies(MatrixView<const complex<double>>(half.view()), 16, transformCols);
+            string shape = string(padding == FFTPadding::Native ? " native " : " pow2 ") + c.name;
+
+            for (SpectrumDType dtype : {SpectrumDType::Float64, SpectrumDType::Float32}) {
+                bool single = dtype == SpectrumDType::Float32;
+                vector<FrequencyComponent> top;
+                MappedSpectrumFile file;
+                if (!DFT2DRealFFTStreaming(skeletonPath, spectrumPath, padding, dtype, 16, options, &top, error) ||
+                    !file.open(spectrumPath, error)) {
+                    reportCheck("DFT2DRealFFTStreaming" + shape, false, error);
+                    continue;
+                }
+                vector<vector<complex<double>>> streamed(transformRows);
+                for (size_t r = 0; r < transformRows; ++r) {
+                    if (single) {
+                        streamed[r].assign(file.row32(r).begin(), file.row32(r).end());
+                    } else {
+                        streamed[r].assign(file.row64(r).begin(), file.row64(r).end());
+                    }
+                }
+                double spectrumError = maxRelativeError(streamed, toNested<double>(half.view()));
+                string name = string("DFT2DRealFFTStreaming ") + (single ? "float32" : "float64") + shape;
+                reportCheck(name, spectrumError < (single ? 1e-6 : 1e-12), errorText(spectrumError));
+                bool sameTop = top.size() == expectedTop.size() && file.components().size() == top.size();
+                for (size_t i = 0; sameTop && i < top.size(); ++i) {
+                    sameTop = abs(top[i].amplitude - expectedTop[i].amplitude) <= 1e-5 * expectedTop[0].amplitude &&
+                              file.components()[i].amplitude == top[i].amplitude;
+                }
+                reportCheck(name + " components", sameTop);
+            }
+        }
+    }
+    filesystem::remove(inputPath);
+    filesystem::remove(skeletonPath);
+    filesystem::remove(spectrumPath);
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    string jsonPath, comparePath;
+    bool checkOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--max-size" && i + 1 < argc) {
+            options.maxSize = stoll(argv[++i]);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.minSeconds = stod(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            comparePath = argv[++i];
+        } else if (arg == "--check") {
+            checkOnly = true;
+        } else {
+            cerr << "usage: draw_bench [--check] [--filter text] [--max-size n] [--min-time s] [--json out.json] [--compare baseline.json]\n";
+            return 1;
+        }
+    }
+
+    if (checkOnly) {
+        runThinningChecks();
+        runFourierChecks();
+        runStreamingChecks();
+        cout << (failedChecks == 0 ? "All checks passed\n" : to_string(failedChecks) + " checks failed\n");
+        return failedChecks == 0 ? 0 : 1;
+    }
+
+    registerThinningBenchmarks();
+    registerFourierBenchmarks();
+    registerStreamingBenchmarks();
+    vector<BenchResult> results = runBenchmarks(options, cout);
+
+    if (!jsonPath.empty()) {
+        ofstream out(jsonPath);
+        writeBenchJSON(results, out);
+        if (!out) {
+            cerr << "Could not write " << jsonPath << "\n";
+            return 1;
+        }
+    }
+    if (!comparePath.empty()) {
+        vector<BenchResult> baseline;
+        if (!loadBenchJSON(comparePath, baseline)) {
+            cerr << "Could not read " << comparePath << "\n";
+            return 1;
+        }
+        cout << "\nChange against " << comparePath << ":\n";
+        return compareBenchResults(baseline, results, 0.10, cout) == 0 ? 0 : 2;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "bench_harness.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include <sys/resource.h>
+
+using namespace std;
+
+struct RegisteredBenchmark {
+    string name;
+    vector<int64_t> sizes;
+    function<void(BenchState&)> body;
+};
+
+static vector<RegisteredBenchmark>& getRegistry() {
+    static vector<RegisteredBenchmark> registry;
+    return registry;
+}
+
+void registerBenchmark(const string& name, const vector<int64_t>& sizes, const function<void(BenchState&)>& body) {
+    getRegistry().push_back({name, sizes, body});
+}
+
+static long getPeakRSSKiB() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+vector<BenchResult> runBenchmarks(const BenchOptions& options, ostream& table) {
+    vector<BenchResult> results;
+    table << left << setw(44) << "benchmark" << right << setw(12) << "iterations" << setw(14) << "ns/iter" << setw(12) << "ns/item"
+          << setw(12) << "allocs/it" << setw(14) << "bytes/it" << setw(12) << "peak KiB" << "\n";
+
+    for (const RegisteredBenchmark& benchmark : getRegistry()) {
+        for (int64_t size : benchmark.sizes) {
+            string name = benchmark.name + "/" + to_string(size);
+            if (size > options.maxSize || (!options.filter.empty() && name.find(options.filter) == string::npos)) {
+                continue;
+            }
+
+            BenchState state(size, options.minSeconds);
+            benchmark.body(state);
+            if (!state.skipReason.empty()) {
+                table << left << setw(44) << name << " skipped: " << state.skipReason << "\n";
+                continue;
+            }
+
+            BenchResult result;
+            result.name = name;
+            result.size = size;
+            result.iterations = state.iterations;
+            double iterations = static_cast<double>(max<uint64_t>(state.iterations, 1));
+            result.nsPerIteration = chrono::duration<double, nano>(state.elapsed).count() / iterations;
+            result.nsPerItem = state.itemsPerIteration > 0 ? result.nsPerIteration / state.itemsPerIteration : 0;
+            result.allocationsPerIteration = state.allocations / iterations;
+            result.bytesPerIteration = state.bytes / iterations;
+            result.peakRSSKiB = getPeakRSSKiB();
+            results.push_back(result);
+
+            table << left << setw(44) << name << right << setw(12) << result.iterations << fixed << setprecision(0) << setw(14)
+                  << result.nsPerIteration << setprecision(3) << setw(12) << result.nsPerItem << setprecision(1) << setw(12)
+                  << result.allocationsPerIteration << setprecision(0) << setw(14) << result.bytesPerIteration << setw(12)
+                  << result.peakRSSKiB << defaultfloat << "\n";
+            table.flush();
+        }
+    }
+    return results;
+}
+
+void writeBenchJSON(const vector<BenchResult>& results, ostream& out) {
+    out << "{\"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << setprecision(17) << "{\"name\": \"" << r.name << "\", \"size\": " << r.size << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_iteration\": " << r.nsPerIteration << ", \"ns_per_item\": " << r.nsPerItem
+            << ", \"allocations_per_iteration\": " << r.allocationsPerIteration << ", \"bytes_per_iteration\": " << r.bytesPerIteration
+            << ", \"peak_rss_kib\": " << r.peakRSSKiB << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]}\n";
+}
+
+// Value following "key": on a writeBenchJSON line
+static bool findField(const string& line, const string& key, string& value) {
+    size_t pos = line.find("\"" + key + "\": ");
+    if (pos == string::npos) {
+        return false;
+    }
+    pos += key.size() + 4;
+    if (line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        value = line.substr(pos + 1, end - pos - 1);
+    } else {
+        size_t end = line.find_first_of(",}", pos);
+        value = line.substr(pos, end - pos);
+    }
+    return true;
+}
+
+bool loadBenchJSON(const string& path, vector<BenchResult>& results) {
+    ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    string line, value;
+    while (getline(in, line)) {
+        BenchResult r;
+        if (!findField(line, "name", r.name)) {
+            continue;
+        }
+        if (findField(line, "size", value)) r.size = stoll(value);
+        if (findField(line, "iterations", value)) r.iterations = stoull(value);
+        if (findField(line, "ns_per_iteration", value)) r.nsPerIteration = stod(value);
+        if (findField(line, "ns_per_item", value)) r.nsPerItem = stod(value);
+        if (findField(line, "allocations_per_iteration", value)) r.allocationsPerIteration = stod(value);
+        if (findField(line, "bytes_per_iteration", value)) r.bytesPerIteration = stod(value);
+        if (findField(line, "peak_rss_kib", value)) r.peakRSSKiB = stol(value);
+        results.push_back(r);
+    }
+    return true;
+}
+
+int compareBenchResults(const vector<BenchResult>& baseline, const vector<BenchResult>& current, double threshold, ostream& out) {
+    map<string, const BenchResult*> before;
+    for (const BenchResult& r : baseline) {
+        before[r.name] = &r;
+    }
+    int regressions = 0;
+    for (const BenchResult& r : current) {
+        auto it = before.find(r.name);
+        if (it == before.end() || it->second->nsPerIteration <= 0) {
+            continue;
+        }
+        // Per item when both runs have it, so results stay comparable if the item count changes
+        const BenchResult& old = *it->second;
+        bool perItem = r.nsPerItem > 0 && old.nsPerItem > 0;
+        double change = perItem ? r.nsPerItem / old.nsPerItem - 1.0 : r.nsPerIteration / old.nsPerIteration - 1.0;
+        bool slower = change > threshold;
+        regressions += slower;
+        out << left << setw(44) << r.name << right << fixed << setprecision(1) << setw(8) << showpos << change * 100.0 << "%"
+            << noshowpos << defaultfloat << (slower ? "  REGRESSION" : "") << "\n";
+    }
+    return regressions;
+}
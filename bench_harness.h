@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <algorithm>
+#include "alloc_counter.h"
+
+using namespace std;
+
+// Minimal Google Benchmark-style harness for the draw_bench target.
+//
+//   registerBenchmark("FFT", {64, 256}, [](BenchState& state) {
+//       auto input = makeInput(state.size());          // setup, not timed
+//       while (state.keepRunning()) {
+//           FFT(input);
+//       }
+//       state.setItemsPerIteration(state.size());     // enables ns/item
+//   });
+//
+// keepRunning() times batches of iterations and grows the batch until the benchmark has run
+// for the minimum time. Allocation counts come from the counting operator new in alloc_counter.cpp.
+
+class BenchState {
+public:
+    BenchState(int64_t size, double minSeconds) : argument(size), minSeconds(minSeconds) {}
+
+    int64_t size() const { return argument; }
+
+    bool keepRunning() {
+        auto now = chrono::steady_clock::now();
+        if (remaining > 0) {
+            --remaining;
+            return true;
+        }
+        if (started) {
+            elapsed += now - batchStart - pausedInBatch;
+            allocations += getAllocationCount() - batchAllocations - pausedAllocations;
+            bytes += getAllocatedBytes() - batchBytes - pausedBytes;
+            iterations += batch;
+            if (chrono::duration<double>(elapsed).count() >= minSeconds || iterations >= maxIterations) {
+                return false;
+            }
+            // Aim straight for the minimum time based on what the batch so far cost
+            double perIteration = chrono::duration<double>(elapsed).count() / iterations;
+            double wanted = perIteration > 0 ? (minSeconds - chrono::duration<double>(elapsed).count()) / perIteration : batch * 10.0;
+            batch = static_cast<uint64_t>(min(max(wanted * 1.2, 1.0), static_cast<double>(maxIterations - iterations)));
+        }
+        started = true;
+        remaining = batch - 1;
+        pausedInBatch = chrono::steady_clock::duration::zero();
+        pausedAllocations = pausedBytes = 0;
+        batchAllocations = getAllocationCount();
+        batchBytes = getAllocatedBytes();
+        batchStart = chrono::steady_clock::now();
+        return true;
+    }
+
+    // Exclude per-iteration setup (such as restoring an input that the code under test mutates)
+    void pauseTiming() {
+        pauseStart = chrono::steady_clock::now();
+        pauseAllocations = getAllocationCount();
+        pauseBytes = getAllocatedBytes();
+    }
+    void resumeTiming() {
+        pausedInBatch += chrono::steady_clock::now() - pauseStart;
+        pausedAllocations += getAllocationCount() - pauseAllocations;
+        pausedBytes += getAllocatedBytes() - pauseBytes;
+    }
+
+    void setItemsPerIteration(uint64_t items) { itemsPerIteration = items; }
+    void skip(const string& why) { skipReason = why; }
+
+    uint64_t iterations = 0;
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::duration::zero();
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t itemsPerIteration = 0;
+    string skipReason;
+
+private:
+    static const uint64_t maxIterations = 1000000000;
+
+    int64_t argument;
+    double minSeconds;
+    bool started = false;
+    uint64_t batch = 1;
+    uint64_t remaining = 0;
+    chrono::steady_clock::time_point batchStart;
+    uint64_t batchAllocations = 0, batchBytes = 0;
+    chrono::steady_clock::time_point pauseStart;
+    uint64_t pauseAllocations = 0, pauseBytes = 0;
+    chrono::steady_clock::duration pausedInBatch = chrono::steady_clock::duration::zero();
+    uint64_t pausedAllocations = 0, pausedBytes = 0;
+};
+
+struct BenchResult {
+    string name;
+    int64_t size = 0;
+    uint64_t iterations = 0;
+    double nsPerIteration = 0;
+    double nsPerItem = 0;
+    double allocationsPerIteration = 0;
+    double bytesPerIteration = 0;
+    long peakRSSKiB = 0;        // process high-water mark after the benchmark
+};
+
+struct BenchOptions {
+    string filter;              // substring of "name/size"; empty runs everything
+    int64_t maxSize = 1024;
+    double minSeconds = 0.2;
+};
+
+void registerBenchmark(const string& name, const vector<int64_t>& sizes, const function<void(BenchState&)>& body);
+
+// Run every registered benchmark that passes the options, printing a table row per result
+vector<BenchResult> runBenchmarks(const BenchOptions& options, ostream& table);
+
+// One result object per line, so writeBenchJSON output can be read back by loadBenchJSON
+void writeBenchJSON(const vector<BenchResult>& results, ostream& out);
+bool loadBenchJSON(const string& path, vector<BenchResult>& results);
+
+// Print the ns/item change of each benchmark present in both runs (ns/iteration when either run
+// has no item count); returns how many got slower than threshold (0.10 = 10%)
+int compareBenchResults(const vector<BenchResult>& baseline, const vector<BenchResult>& current, double threshold, ostream& out);
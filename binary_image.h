@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "matrix.h"
+
+using namespace std;
+
+// Contiguous row-major binary plane, one byte per pixel (1 = black, 0 = white)
+struct BinaryImage {
+    int rows = 0;
+    int cols = 0;
+    vector<uint8_t> pixels;
+
+    BinaryImage() = default;
+    BinaryImage(int rows, int cols) : rows(rows), cols(cols), pixels(static_cast<size_t>(rows) * cols, 0) {}
+
+    uint8_t* row(int r) { return pixels.data() + static_cast<size_t>(r) * cols; }
+    const uint8_t* row(int r) const { return pixels.data() + static_cast<size_t>(r) * cols; }
+    uint8_t& at(int r, int c) { return pixels[static_cast<size_t>(r) * cols + c]; }
+    uint8_t at(int r, int c) const { return pixels[static_cast<size_t>(r) * cols + c]; }
+
+    MatrixView<uint8_t> view() { return {pixels.data(), static_cast<size_t>(rows), static_cast<size_t>(cols)}; }
+    MatrixView<const uint8_t> view() const { return {pixels.data(), static_cast<size_t>(rows), static_cast<size_t>(cols)}; }
+};
+
+// Pack a 0/1 int matrix into a binary plane (any non-zero value counts as black)
+inline BinaryImage toBinaryImage(const vector<vector<int>>& matrix) {
+    int rows = static_cast<int>(matrix.size());
+    int cols = rows > 0 ? static_cast<int>(matrix[0].size()) : 0;
+    BinaryImage image(rows, cols);
+    for (int r = 0; r < rows; ++r) {
+        uint8_t* dst = image.row(r);
+        for (int c = 0; c < cols; ++c) {
+            dst[c] = matrix[r][c] != 0;
+        }
+    }
+    return image;
+}
+
+// Copy a binary plane back into an existing int matrix of the same shape
+inline void copyToPixelMatrix(const BinaryImage& image, vector<vector<int>>& matrix) {
+    matrix.resize(image.rows);
+    for (int r = 0; r < image.rows; ++r) {
+        const uint8_t* src = image.row(r);
+        matrix[r].assign(src, src + image.cols);
+    }
+}
@@ -0,0 +1,242 @@
+#include "contour.h"
+#include "fourier.h"
+#include <algorithm>
+#include <numbers>
+#include <cmath>
+
+using namespace std;
+
+// Clockwise from the top, matching the neighbour order used by the thinning code
+static const int neighborRowOffsets[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+static const int neighborColOffsets[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+static bool isInk(const BinaryImage& image, int r, int c) {
+    return r >= 0 && r < image.rows && c >= 0 && c < image.cols && image.at(r, c) != 0;
+}
+
+// m-adjacent neighbours of (r, c); returns how many were written to out
+static int getLinkedNeighbors(const BinaryImage& image, int r, int c, PixelPoint out[8]) {
+    int count = 0;
+    for (int i = 0; i < 8; ++i) {
+        int nr = r + neighborRowOffsets[i];
+        int nc = c + neighborColOffsets[i];
+        if (!isInk(image, nr, nc)) {
+            continue;
+        }
+        // Diagonal links only when no 4-neighbour path joins the two pixels
+        bool diagonal = (i & 1) != 0;
+        if (diagonal && (isInk(image, nr, c) || isInk(image, r, nc))) {
+            continue;
+        }
+        out[count++] = {nr, nc};
+    }
+    return count;
+}
+
+static bool samePoint(const PixelPoint& a, const PixelPoint& b) {
+    return a.row == b.row && a.col == b.col;
+}
+
+vector<Polyline> traceSkeleton(const BinaryImage& skeleton, size_t minPoints) {
+    int rows = skeleton.rows;
+    int cols = skeleton.cols;
+    auto index = [cols](const PixelPoint& p) { return static_cast<size_t>(p.row) * cols + p.col; };
+
+    // Link count per pixel; anything other than 2 ends a path
+    vector<uint8_t> degree(skeleton.pixels.size(), 0);
+    PixelPoint neighbors[8];
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            if (skeleton.at(r, c)) {
+                degree[static_cast<size_t>(r) * cols + c] = getLinkedNeighbors(skeleton, r, c, neighbors);
+            }
+        }
+    }
+
+    vector<uint8_t> visited(skeleton.pixels.size(), 0);
+    vector<Polyline> paths;
+    auto addPath = [&](Polyline&& path) {
+        if (path.points.size() >= minPoints) {
+            paths.push_back(std::move(path));
+        }
+    };
+
+    // Follow degree-2 pixels from start through first until a node or a visited pixel
+    auto walk = [&](PixelPoint start, PixelPoint first) {
+        Polyline path;
+        path.points.push_back(start);
+        PixelPoint prev = start;
+        PixelPoint current = first;
+        while (true) {
+            path.points.push_back(current);
+            size_t currentIndex = index(current);
+            if (degree[currentIndex] != 2 || visited[currentIndex]) {
+                break;
+            }
+            visited[currentIndex] = 1;
+            getLinkedNeighbors(skeleton, current.row, current.col, neighbors);
+            PixelPoint next = samePoint(neighbors[0], prev) ? neighbors[1] : neighbors[0];
+            prev = current;
+            current = next;
+        }
+        path.closed = samePoint(path.points.front(), path.points.back()) && path.points.size() > 2;
+        return path;
+    };
+
+    // Open strokes and branches: every link out of an endpoint or junction
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            PixelPoint node = {r, c};
+            size_t nodeIndex = index(node);
+            if (!skeleton.at(r, c) || degree[nodeIndex] == 2) {
+                continue;
+            }
+            visited[nodeIndex] = 1;
+            if (degree[nodeIndex] == 0) {
+                addPath(Polyline{{node}, false});
+                continue;
+            }
+            PixelPoint links[8];
+            int linkCount = getLinkedNeighbors(skeleton, r, c, links);
+            for (int i = 0; i < linkCount; ++i) {
+                size_t linkIndex = index(links[i]);
+                if (degree[linkIndex] != 2) {
+                    // Two nodes touching: emit the link once
+                    if (nodeIndex < linkIndex) {
+                        addPath(Polyline{{node, links[i]}, false});
+                    }
+                } else if (!visited[linkIndex]) {
+                    addPath(walk(node, links[i]));
+                }
+            }
+        }
+    }
+
+    // Whatever is left has no endpoints or junctions: closed loops
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            PixelPoint start = {r, c};
+            size_t startIndex = index(start);
+            if (!skeleton.at(r, c) || visited[startIndex]) {
+                continue;
+            }
+            visited[startIndex] = 1;
+            getLinkedNeighbors(skeleton, r, c, neighbors);
+            addPath(walk(start, neighbors[0]));
+        }
+    }
+    return paths;
+}
+
+// Points evenly spaced by arc length; closed paths wrap, open paths keep both ends
+static vector<complex<double>> resamplePath(const vector<complex<double>>& points, size_t sampleCount, bool closed) {
+    vector<double> distance(points.size(), 0.0);
+    for (size_t i = 1; i < points.size(); ++i) {
+        distance[i] = distance[i - 1] + abs(points[i] - points[i - 1]);
+    }
+    double length = distance.back();
+    if (length == 0.0 || points.size() < 2) {
+        return vector<complex<double>>(sampleCount, points.front());
+    }
+
+    vector<complex<double>> samples(sampleCount);
+    double step = closed || sampleCount < 2 ? length / sampleCount : length / (sampleCount - 1);
+    size_t segment = 1;
+    for (size_t j = 0; j < sampleCount; ++j) {
+        double target = min(j * step, length);
+        while (segment + 1 < points.size() && distance[segment] < target) {
+            ++segment;
+        }
+        double span = distance[segment] - distance[segment - 1];
+        double fraction = span > 0 ? (target - distance[segment - 1]) / span : 0.0;
+        samples[j] = points[segment - 1] + fraction * (points[segment] - points[segment - 1]);
+    }
+    return samples;
+}
+
+FourierDescriptors computeFourierDescriptors(const Polyline& path, size_t sampleCount) {
+    FourierDescriptors descriptors;
+    descriptors.closed = path.closed;
+    if (path.points.empty()) {
+        return descriptors;
+    }
+
+    vector<complex<double>> points;
+    points.reserve(path.points.size());
+    for (const PixelPoint& p : path.points) {
+        points.emplace_back(p.col, p.row);
+    }
+
+    vector<complex<double>> signal;
+    if (path.closed) {
+        // Closed polylines repeat their first point; the period is one lap
+        signal = sampleCount > 0 ? resamplePath(points, sampleCount, true) : vector<complex<double>>(points.begin(), points.end() - 1);
+    } else {
+        vector<complex<double>> forward = sampleCount > 0 ? resamplePath(points, sampleCount, false) : points;
+        signal = forward;
+        for (size_t i = forward.size() - 1; i-- > 1;) {
+            signal.push_back(forward[i]);
+        }
+    }
+
+    descriptors.coefficients = FFT(signal, FFTPadding::Native);
+    double scale = 1.0 / static_cast<double>(descriptors.coefficients.size());
+    for (complex<double>& c : descriptors.coefficients) {
+        c *= scale;
+    }
+    return descriptors;
+}
+
+// Signed frequency of coefficient index k out of n
+static int getSignedFrequency(size_t k, size_t n) {
+    return k <= n / 2 ? static_cast<int>(k) : static_cast<int>(k) - static_cast<int>(n);
+}
+
+vector<complex<double>> reconstructCurve(const FourierDescriptors& descriptors, size_t termCount, size_t outputSamples) {
+    size_t n = descriptors.coefficients.size();
+    if (termCount == 0 || termCount > n) {
+        termCount = n;
+    }
+
+    // Lowest frequencies first: 0, 1, -1, 2, -2, ...
+    vector<Epicycle> terms;
+    terms.reserve(termCount);
+    for (size_t i = 0; i < termCount; ++i) {
+        int frequency = (i % 2 == 1) ? static_cast<int>(i / 2 + 1) : -static_cast<int>(i / 2);
+        size_t k = frequency >= 0 ? frequency : n + frequency;
+        const complex<double>& c = descriptors.coefficients[k];
+        terms.push_back({frequency, abs(c), arg(c)});
+    }
+
+    vector<complex<double>> curve(outputSamples);
+    for (size_t s = 0; s < outputSamples; ++s) {
+        curve[s] = evaluateEpicycles(terms, static_cast<double>(s) / outputSamples);
+    }
+    return curve;
+}
+
+vector<Epicycle> getEpicycles(const FourierDescriptors& descriptors, size_t termCount) {
+    size_t n = descriptors.coefficients.size();
+    vector<Epicycle> epicycles;
+    epicycles.reserve(n);
+    for (size_t k = 0; k < n; ++k) {
+        const complex<double>& c = descriptors.coefficients[k];
+        epicycles.push_back({getSignedFrequency(k, n), abs(c), arg(c)});
+    }
+
+    if (termCount == 0 || termCount > n) {
+        termCount = n;
+    }
+    auto larger = [](const Epicycle& a, const Epicycle& b) { return a.radius > b.radius; };
+    partial_sort(epicycles.begin(), epicycles.begin() + termCount, epicycles.end(), larger);
+    epicycles.resize(termCount);
+    return epicycles;
+}
+
+complex<double> evaluateEpicycles(const vector<Epicycle>& epicycles, double t) {
+    complex<double> tip = 0;
+    for (const Epicycle& e : epicycles) {
+        tip += polar(e.radius, 2.0 * numbers::pi * e.frequency * t + e.phase);
+    }
+    return tip;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <complex>
+#include <cstddef>
+#include "binary_image.h"
+
+using namespace std;
+
+// Skeleton pixel, (row, col) in image coordinates
+struct PixelPoint {
+    int row = 0;
+    int col = 0;
+};
+
+// Ordered pixels along one skeleton stroke. Closed loops repeat the first point at the end.
+struct Polyline {
+    vector<PixelPoint> points;
+    bool closed = false;
+};
+
+// Split a one-pixel-wide skeleton into polylines. Pixels are linked with m-adjacency (a diagonal
+// neighbour only counts when the two pixels between them are white), so the corners Zhang-Suen
+// leaves on diagonal strokes don't show up as junctions. Paths run between endpoints and
+// junctions; what is left afterwards are closed loops. Paths shorter than minPoints are dropped.
+vector<Polyline> traceSkeleton(const BinaryImage& skeleton, size_t minPoints = 2);
+
+// 1D Fourier descriptors of a path seen as the complex signal z = col + i * row.
+// coefficients[k] is the FFT of the samples divided by their count, so the curve is
+// z(t) = sum_k coefficients[k] * exp(2 pi i k t), t in [0, 1), with k > n / 2 read as k - n.
+// Open paths are traced out and back so the signal is periodic without a jump.
+struct FourierDescriptors {
+    vector<complex<double>> coefficients;
+    bool closed = false;
+};
+
+// sampleCount == 0 uses the polyline's own points; otherwise the path is resampled to that many
+// points spaced evenly along its length first
+FourierDescriptors computeFourierDescriptors(const Polyline& path, size_t sampleCount = 0);
+
+// Curve from the termCount lowest-frequency coefficients (0, 1, -1, 2, -2, ...), evaluated at
+// outputSamples evenly spaced t over one period (for open paths that is the out-and-back trace).
+// termCount 0 or beyond the coefficient count uses them all.
+vector<complex<double>> reconstructCurve(const FourierDescriptors& descriptors, size_t termCount, size_t outputSamples);
+
+// One rotating arm: radius * exp(i * (2 pi * frequency * t + phase))
+struct Epicycle {
+    int frequency = 0;
+    double radius = 0;
+    double phase = 0;
+};
+
+// The termCount largest arms, largest first, which is the usual drawing order for an animation.
+// termCount 0 returns every coefficient.
+vector<Epicycle> getEpicycles(const FourierDescriptors& descriptors, size_t termCount = 0);
+
+// Tip of the epicycle chain at t in [0, 1)
+complex<double> evaluateEpicycles(const vector<Epicycle>& epicycles, double t);
@@ -0,0 +1,183 @@
+#include "fourier.h"
+
+using namespace std;
+
+// Mixed-radix decimation in time: each level splits the transform into p interleaved
+// sub-transforms of length m, computes them recursively straight into out, then combines
+// them with radix-p butterflies. twiddleStride is the input stride at this level, which is
+// also the step through the plan's twiddle table.
+
+static void butterfly2(complex<double>* out, const FFTPlan& plan, size_t twiddleStride, size_t m) {
+    for (size_t k = 0; k < m; ++k) {
+        complex<double> t = out[k + m] * plan.twiddles[k * twiddleStride];
+        out[k + m] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+static void butterfly3(complex<double>* out, const FFTPlan& plan, size_t twiddleStride, size_t m) {
+    const double sin60 = -sqrt(3.0) / 2.0;
+    for (size_t k = 0; k < m; ++k) {
+        complex<double> a0 = out[k];
+        complex<double> a1 = out[k + m] * plan.twiddles[k * twiddleStride];
+        complex<double> a2 = out[k + 2 * m] * plan.twiddles[2 * k * twiddleStride];
+
+        complex<double> sum = a1 + a2;
+        complex<double> mid = a0 - 0.5 * sum;
+        complex<double> rot = sin60 * (a1 - a2);
+        complex<double> iRot(-rot.imag(), rot.real());
+
+        out[k] = a0 + sum;
+        out[k + m] = mid + iRot;
+        out[k + 2 * m] = mid - iRot;
+    }
+}
+
+static void butterfly4(complex<double>* out, const FFTPlan& plan, size_t twiddleStride, size_t m) {
+    for (size_t k = 0; k < m; ++k) {
+        complex<double> a0 = out[k];
+        complex<double> a1 = out[k + m] * plan.twiddles[k * twiddleStride];
+        complex<double> a2 = out[k + 2 * m] * plan.twiddles[2 * k * twiddleStride];
+        complex<double> a3 = out[k + 3 * m] * plan.twiddles[3 * k * twiddleStride];
+
+        complex<double> even = a0 + a2;
+        complex<double> evenDiff = a0 - a2;
+        complex<double> odd = a1 + a3;
+        complex<double> oddDiff = a1 - a3;
+
+        // -i * oddDiff
+        complex<double> rotated(oddDiff.imag(), -oddDiff.real());
+
+        out[k] = even + odd;
+        out[k + m] = evenDiff + rotated;
+        out[k + 2 * m] = even - odd;
+        out[k + 3 * m] = evenDiff - rotated;
+    }
+}
+
+static void butterfly5(complex<double>* out, const FFTPlan& plan, size_t twiddleStride, size_t m) {
+    const double c1 = cos(2.0 * numbers::pi / 5.0);
+    const double c2 = cos(4.0 * numbers::pi / 5.0);
+    const double s1 = -sin(2.0 * numbers::pi / 5.0);
+    const double s2 = -sin(4.0 * numbers::pi / 5.0);
+    for (size_t k = 0; k < m; ++k) {
+        complex<double> a0 = out[k];
+        complex<double> a1 = out[k + m] * plan.twiddles[k * twiddleStride];
+        complex<double> a2 = out[k + 2 * m] * plan.twiddles[2 * k * twiddleStride];
+        complex<double> a3 = out[k + 3 * m] * plan.twiddles[3 * k * twiddleStride];
+        complex<double> a4 = out[k + 4 * m] * plan.twiddles[4 * k * twiddleStride];
+
+        complex<double> sum14 = a1 + a4, diff14 = a1 - a4;
+        complex<double> sum23 = a2 + a3, diff23 = a2 - a3;
+
+        complex<double> real1 = a0 + c1 * sum14 + c2 * sum23;
+        complex<double> real2 = a0 + c2 * sum14 + c1 * sum23;
+        complex<double> imag1 = s1 * diff14 + s2 * diff23;
+        complex<double> imag2 = s2 * diff14 - s1 * diff23;
+        complex<double> iImag1(-imag1.imag(), imag1.real());
+        complex<double> iImag2(-imag2.imag(), imag2.real());
+
+        out[k] = a0 + sum14 + sum23;
+        out[k + m] = real1 + iImag1;
+        out[k + 4 * m] = real1 - iImag1;
+        out[k + 2 * m] = real2 + iImag2;
+        out[k + 3 * m] = real2 - iImag2;
+    }
+}
+
+// Direct O(p^2) butterfly for the remaining small primes
+static void butterflyGeneric(complex<double>* out, const FFTPlan& plan, size_t twiddleStride, size_t m, size_t p) {
+    complex<double> inputs[maxDirectRadix];
+    size_t n = plan.size;
+    for (size_t k = 0; k < m; ++k) {
+        for (size_t q = 0; q < p; ++q) {
+            inputs[q] = out[k + q * m];
+        }
+        for (size_t u = 0; u < p; ++u) {
+            size_t index = k + u * m;
+            complex<double> sum = inputs[0];
+            for (size_t q = 1; q < p; ++q) {
+                sum += inputs[q] * plan.twiddles[(q * index * twiddleStride) % n];
+            }
+            out[index] = sum;
+        }
+    }
+}
+
+static void mixedRadixPass(complex<double>* out, const complex<double>* in, size_t twiddleStride, const size_t* factors, const FFTPlan& plan) {
+    size_t p = factors[0];
+    size_t m = factors[1];
+
+    if (m == 1) {
+        for (size_t q = 0; q < p; ++q) {
+            out[q] = in[q * twiddleStride];
+        }
+    } else {
+        for (size_t q = 0; q < p; ++q) {
+            mixedRadixPass(out + q * m, in + q * twiddleStride, twiddleStride * p, factors + 2, plan);
+        }
+    }
+
+    switch (p) {
+        case 2: butterfly2(out, plan, twiddleStride, m); break;
+        case 3: butterfly3(out, plan, twiddleStride, m); break;
+        case 4: butterfly4(out, plan, twiddleStride, m); break;
+        case 5: butterfly5(out, plan, twiddleStride, m); break;
+        default: butterflyGeneric(out, plan, twiddleStride, m, p); break;
+    }
+}
+
+void executeMixedRadixFFT(const FFTPlan& plan, complex<double>* data) {
+    // The recursion reads a copy of the input and writes the result in place
+    thread_local vector<complex<double>> scratch;
+    scratch.assign(data, data + plan.size);
+    mixedRadixPass(data, scratch.data(), 1, plan.factors.data(), plan);
+}
+
+// Bluestein: with nk = (n^2 + k^2 - (k - n)^2) / 2 the DFT becomes
+// X[k] = chirp[k] * sum_n (x[n] * chirp[n]) * conj(chirp[k - n]),
+// a convolution that is done with power-of-two FFTs of at least 2 * size - 1 points.
+void buildBluesteinTables(FFTPlan& plan) {
+    size_t n = plan.size;
+    plan.convolutionPlan = &getFFTPlan(getNextPowerOf2(2 * n - 1));
+    size_t m = plan.convolutionPlan->size;
+
+    // n^2 is reduced mod 2n first so the angle stays exact for large n
+    plan.chirp.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        size_t square = (i * i) % (2 * n);
+        plan.chirp[i] = polar(1.0, -numbers::pi * static_cast<double>(square) / static_cast<double>(n));
+    }
+
+    plan.chirpSpectrum.assign(m, 0);
+    plan.chirpSpectrum[0] = conj(plan.chirp[0]);
+    for (size_t i = 1; i < n; ++i) {
+        plan.chirpSpectrum[i] = conj(plan.chirp[i]);
+        plan.chirpSpectrum[m - i] = conj(plan.chirp[i]);
+    }
+    executeFFT(*plan.convolutionPlan, plan.chirpSpectrum.data());
+}
+
+void executeBluesteinFFT(const FFTPlan& plan, complex<double>* data) {
+    size_t n = plan.size;
+    const FFTPlan& convolution = *plan.convolutionPlan;
+    size_t m = convolution.size;
+
+    thread_local vector<complex<double>> scratch;
+    scratch.assign(m, 0);
+    for (size_t i = 0; i < n; ++i) {
+        scratch[i] = data[i] * plan.chirp[i];
+    }
+    executeFFT(convolution, scratch.data());
+
+    // Multiply the spectra, then invert with conj(fft(conj(x))) / m
+    for (size_t i = 0; i < m; ++i) {
+        scratch[i] = conj(scratch[i] * plan.chirpSpectrum[i]);
+    }
+    executeFFT(convolution, scratch.data());
+
+    double scale = 1.0 / static_cast<double>(m);
+    for (size_t k = 0; k < n; ++k) {
+        data[k] = plan.chirp[k] * conj(scratch[k]) * scale;
+    }
+}
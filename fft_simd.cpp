@@ -0,0 +1,302 @@
+#include "fourier.h"
+#include <map>
+#include <mutex>
+#include <memory>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FFT_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Split-storage FFT: real and imaginary parts live in separate arrays, so a SIMD register holds
+// the same part of consecutive values and a complex multiply is two FMAs and two multiplies with
+// no shuffles. The transform is a radix-4 Stockham autosort (radix 2 for the last stage when the
+// size is an odd power of two): every stage reads one buffer and writes the other in order, so
+// there is no bit-reversal pass.
+//
+// A stage of length m and stride s computes s interleaved transforms of length m. The inner loop
+// runs over those s transforms with one twiddle for all of them, which is what gets vectorised;
+// s grows by 4 every stage. Starting with s = batch runs batch interleaved transforms at once,
+// which is how column blocks keep every stage vectorised.
+
+template <typename T>
+SplitFFTPlan<T>::SplitFFTPlan(size_t size) : size(size), cosTable(size), sinTable(size) {
+    // Computed in double and rounded once, so the float tables are as accurate as they can be
+    for (size_t j = 0; j < size; ++j) {
+        double angle = -2.0 * numbers::pi * static_cast<double>(j) / static_cast<double>(size);
+        cosTable[j] = static_cast<T>(cos(angle));
+        sinTable[j] = static_cast<T>(sin(angle));
+    }
+}
+
+template <typename T>
+const SplitFFTPlan<T>& getSplitFFTPlan(size_t size) {
+    static mutex planMutex;
+    static map<size_t, unique_ptr<SplitFFTPlan<T>>> plans;
+
+    lock_guard<mutex> lock(planMutex);
+    unique_ptr<SplitFFTPlan<T>>& plan = plans[size];
+    if (!plan) {
+        plan = make_unique<SplitFFTPlan<T>>(size);
+    }
+    return *plan;
+}
+
+// Pointers to the four inputs and four outputs of one radix-4 butterfly column
+template <typename T>
+struct Radix4Block {
+    const T *ar, *ai, *br, *bi, *cr, *ci, *dr, *di;
+    T *y0r, *y0i, *y1r, *y1i, *y2r, *y2i, *y3r, *y3i;
+    T w1r, w1i, w2r, w2i, w3r, w3i;
+};
+
+template <typename T>
+static inline void radix4Scalar(const Radix4Block<T>& b, size_t q) {
+    T apcR = b.ar[q] + b.cr[q], apcI = b.ai[q] + b.ci[q];
+    T amcR = b.ar[q] - b.cr[q], amcI = b.ai[q] - b.ci[q];
+    T bpdR = b.br[q] + b.dr[q], bpdI = b.bi[q] + b.di[q];
+    // j * (b - d)
+    T jbmdR = b.di[q] - b.bi[q], jbmdI = b.br[q] - b.dr[q];
+
+    b.y0r[q] = apcR + bpdR;
+    b.y0i[q] = apcI + bpdI;
+    T t1r = amcR - jbmdR, t1i = amcI - jbmdI;
+    b.y1r[q] = b.w1r * t1r - b.w1i * t1i;
+    b.y1i[q] = b.w1r * t1i + b.w1i * t1r;
+    T t2r = apcR - bpdR, t2i = apcI - bpdI;
+    b.y2r[q] = b.w2r * t2r - b.w2i * t2i;
+    b.y2i[q] = b.w2r * t2i + b.w2i * t2r;
+    T t3r = amcR + jbmdR, t3i = amcI + jbmdI;
+    b.y3r[q] = b.w3r * t3r - b.w3i * t3i;
+    b.y3i[q] = b.w3r * t3i + b.w3i * t3r;
+}
+
+template <typename T>
+static Radix4Block<T> makeRadix4Block(const SplitFFTPlan<T>& plan, size_t m, size_t s, size_t p,
+                                      const T* xr, const T* xi, T* yr, T* yi) {
+    size_t quarter = m / 4;
+    size_t step = plan.size / m;
+    Radix4Block<T> b;
+    b.ar = xr + s * p;
+    b.ai = xi + s * p;
+    b.br = xr + s * (p + quarter);
+    b.bi = xi + s * (p + quarter);
+    b.cr = xr + s * (p + 2 * quarter);
+    b.ci = xi + s * (p + 2 * quarter);
+    b.dr = xr + s * (p + 3 * quarter);
+    b.di = xi + s * (p + 3 * quarter);
+    b.y0r = yr + s * (4 * p);
+    b.y0i = yi + s * (4 * p);
+    b.y1r = yr + s * (4 * p + 1);
+    b.y1i = yi + s * (4 * p + 1);
+    b.y2r = yr + s * (4 * p + 2);
+    b.y2i = yi + s * (4 * p + 2);
+    b.y3r = yr + s * (4 * p + 3);
+    b.y3i = yi + s * (4 * p + 3);
+    b.w1r = plan.cosTable[p * step];
+    b.w1i = plan.sinTable[p * step];
+    b.w2r = plan.cosTable[2 * p * step];
+    b.w2i = plan.sinTable[2 * p * step];
+    b.w3r = plan.cosTable[3 * p * step];
+    b.w3i = plan.sinTable[3 * p * step];
+    return b;
+}
+
+template <typename T>
+static void radix4StageScalar(const SplitFFTPlan<T>& plan, size_t m, size_t s, const T* xr, const T* xi, T* yr, T* yi) {
+    for (size_t p = 0; p < m / 4; ++p) {
+        Radix4Block<T> b = makeRadix4Block(plan, m, s, p, xr, xi, yr, yi);
+        for (size_t q = 0; q < s; ++q) {
+            radix4Scalar(b, q);
+        }
+    }
+}
+
+#ifdef FFT_X86
+
+// The same butterfly on a register of consecutive q values
+template <typename T>
+struct AVX2Lanes;
+
+template <>
+struct AVX2Lanes<float> {
+    using Vector = __m256;
+    static constexpr size_t width = 8;
+    __attribute__((target("avx2,fma"))) static Vector load(const float* p) { return _mm256_loadu_ps(p); }
+    __attribute__((target("avx2,fma"))) static void store(float* p, Vector v) { _mm256_storeu_ps(p, v); }
+    __attribute__((target("avx2,fma"))) static Vector broadcast(float v) { return _mm256_set1_ps(v); }
+    __attribute__((target("avx2,fma"))) static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static Vector sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static Vector mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+    // a * b - c and a * b + c in one rounding
+    __attribute__((target("avx2,fma"))) static Vector mulSub(Vector a, Vector b, Vector c) { return _mm256_fmsub_ps(a, b, c); }
+    __attribute__((target("avx2,fma"))) static Vector mulAdd(Vector a, Vector b, Vector c) { return _mm256_fmadd_ps(a, b, c); }
+};
+
+template <>
+struct AVX2Lanes<double> {
+    using Vector = __m256d;
+    static constexpr size_t width = 4;
+    __attribute__((target("avx2,fma"))) static Vector load(const double* p) { return _mm256_loadu_pd(p); }
+    __attribute__((target("avx2,fma"))) static void store(double* p, Vector v) { _mm256_storeu_pd(p, v); }
+    __attribute__((target("avx2,fma"))) static Vector broadcast(double v) { return _mm256_set1_pd(v); }
+    __attribute__((target("avx2,fma"))) static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+    __attribute__((target("avx2,fma"))) static Vector sub(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+    __attribute__((target("avx2,fma"))) static Vector mul(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+    __attribute__((target("avx2,fma"))) static Vector mulSub(Vector a, Vector b, Vector c) { return _mm256_fmsub_pd(a, b, c); }
+    __attribute__((target("avx2,fma"))) static Vector mulAdd(Vector a, Vector b, Vector c) { return _mm256_fmadd_pd(a, b, c); }
+};
+
+// Strides below the register width fall back to the scalar butterfly for the whole stage
+template <typename T>
+__attribute__((target("avx2,fma")))
+static void radix4StageAVX2(const SplitFFTPlan<T>& plan, size_t m, size_t s, const T* xr, const T* xi, T* yr, T* yi) {
+    using L = AVX2Lanes<T>;
+    using V = typename L::Vector;
+    if (s < L::width) {
+        radix4StageScalar(plan, m, s, xr, xi, yr, yi);
+        return;
+    }
+    size_t vectorEnd = s / L::width * L::width;
+    for (size_t p = 0; p < m / 4; ++p) {
+        Radix4Block<T> b = makeRadix4Block(plan, m, s, p, xr, xi, yr, yi);
+        V w1r = L::broadcast(b.w1r), w1i = L::broadcast(b.w1i);
+        V w2r = L::broadcast(b.w2r), w2i = L::broadcast(b.w2i);
+        V w3r = L::broadcast(b.w3r), w3i = L::broadcast(b.w3i);
+        for (size_t q = 0; q < vectorEnd; q += L::width) {
+            V ar = L::load(b.ar + q), ai = L::load(b.ai + q);
+            V br = L::load(b.br + q), bi = L::load(b.bi + q);
+            V cr = L::load(b.cr + q), ci = L::load(b.ci + q);
+            V dr = L::load(b.dr + q), di = L::load(b.di + q);
+
+            V apcR = L::add(ar, cr), apcI = L::add(ai, ci);
+            V amcR = L::sub(ar, cr), amcI = L::sub(ai, ci);
+            V bpdR = L::add(br, dr), bpdI = L::add(bi, di);
+            V jbmdR = L::sub(di, bi), jbmdI = L::sub(br, dr);
+
+            L::store(b.y0r + q, L::add(apcR, bpdR));
+            L::store(b.y0i + q, L::add(apcI, bpdI));
+            V t1r = L::sub(amcR, jbmdR), t1i = L::sub(amcI, jbmdI);
+            L::store(b.y1r + q, L::mulSub(w1r, t1r, L::mul(w1i, t1i)));
+            L::store(b.y1i + q, L::mulAdd(w1r, t1i, L::mul(w1i, t1r)));
+            V t2r = L::sub(apcR, bpdR), t2i = L::sub(apcI, bpdI);
+            L::store(b.y2r + q, L::mulSub(w2r, t2r, L::mul(w2i, t2i)));
+            L::store(b.y2i + q, L::mulAdd(w2r, t2i, L::mul(w2i, t2r)));
+            V t3r = L::add(amcR, jbmdR), t3i = L::add(amcI, jbmdI);
+            L::store(b.y3r + q, L::mulSub(w3r, t3r, L::mul(w3i, t3i)));
+            L::store(b.y3i + q, L::mulAdd(w3r, t3i, L::mul(w3i, t3r)));
+        }
+        for (size_t q = vectorEnd; q < s; ++q) {
+            radix4Scalar(b, q);
+        }
+    }
+}
+
+#endif
+
+template <typename T>
+using Radix4Stage = void (*)(const SplitFFTPlan<T>&, size_t, size_t, const T*, const T*, T*, T*);
+
+struct SplitKernel {
+    FFTKernel kind;
+    Radix4Stage<float> stageFloat;
+    Radix4Stage<double> stageDouble;
+
+    Radix4Stage<float> stage(float*) const { return stageFloat; }
+    Radix4Stage<double> stage(double*) const { return stageDouble; }
+};
+
+static bool kernelSupported(FFTKernel kernel) {
+#ifdef FFT_X86
+    __builtin_cpu_init();
+    if (kernel == FFTKernel::AVX2) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+#endif
+    return kernel == FFTKernel::Scalar;
+}
+
+// Kernels live in static storage and the active one is swapped as a pointer, so a pool thread
+// always sees a complete kernel even while another thread changes it
+static const SplitKernel* makeSplitKernel(FFTKernel kernel) {
+    static const SplitKernel scalar{FFTKernel::Scalar, radix4StageScalar<float>, radix4StageScalar<double>};
+#ifdef FFT_X86
+    static const SplitKernel avx2{FFTKernel::AVX2, radix4StageAVX2<float>, radix4StageAVX2<double>};
+    if (kernel == FFTKernel::AVX2) {
+        return &avx2;
+    }
+#endif
+    return &scalar;
+}
+
+static const SplitKernel* detectSplitKernel() {
+    return makeSplitKernel(kernelSupported(FFTKernel::AVX2) ? FFTKernel::AVX2 : FFTKernel::Scalar);
+}
+
+static atomic<const SplitKernel*> activeKernel{detectSplitKernel()};
+
+bool setFFTKernel(FFTKernel kernel) {
+    if (kernel == FFTKernel::Auto) {
+        activeKernel.store(detectSplitKernel(), memory_order_relaxed);
+        return true;
+    }
+    if (!kernelSupported(kernel)) {
+        return false;
+    }
+    activeKernel.store(makeSplitKernel(kernel), memory_order_relaxed);
+    return true;
+}
+
+FFTKernel getFFTKernel() {
+    return activeKernel.load(memory_order_relaxed)->kind;
+}
+
+template <typename T>
+void executeSplitFFT(const SplitFFTPlan<T>& plan, T* re, T* im, size_t batch) {
+    size_t n = plan.size;
+    if (n <= 1) {
+        return;
+    }
+    thread_local vector<T> scratch;
+    scratch.resize(2 * n * batch);
+
+    Radix4Stage<T> stage = activeKernel.load(memory_order_relaxed)->stage(static_cast<T*>(nullptr));
+    T* sourceR = re;
+    T* sourceI = im;
+    T* targetR = scratch.data();
+    T* targetI = scratch.data() + n * batch;
+    size_t s = batch;
+    size_t m = n;
+    for (; m >= 4; m /= 4, s *= 4) {
+        stage(plan, m, s, sourceR, sourceI, targetR, targetI);
+        swap(sourceR, targetR);
+        swap(sourceI, targetI);
+    }
+    if (m == 2) {
+        // Last radix-2 stage, the twiddle is 1
+        for (size_t q = 0; q < s; ++q) {
+            T ar = sourceR[q], ai = sourceI[q];
+            T br = sourceR[q + s], bi = sourceI[q + s];
+            targetR[q] = ar + br;
+            targetI[q] = ai + bi;
+            targetR[q + s] = ar - br;
+            targetI[q + s] = ai - bi;
+        }
+        swap(sourceR, targetR);
+        swap(sourceI, targetI);
+    }
+    if (sourceR != re) {
+        copy(sourceR, sourceR + n * batch, re);
+        copy(sourceI, sourceI + n * batch, im);
+    }
+}
+
+template struct SplitFFTPlan<float>;
+template struct SplitFFTPlan<double>;
+template const SplitFFTPlan<float>& getSplitFFTPlan<float>(size_t);
+template const SplitFFTPlan<double>& getSplitFFTPlan<double>(size_t);
+template void executeSplitFFT<float>(const SplitFFTPlan<float>&, float*, float*, size_t);
+template void executeSplitFFT<double>(const SplitFFTPlan<double>&, double*, double*, size_t);
@@ -0,0 +1,130 @@
+#include "fftw_plan_cache.h"
+#include <map>
+#include <memory>
+#include <atomic>
+#include <limits>
+
+using namespace std;
+
+// FFTW's planner is not thread safe, so every planner call goes through this lock
+static mutex plannerMutex;
+static map<FFTWPlanKey, unique_ptr<FFTWPlanEntry>> planCache;
+static atomic<FFTWRigor> planningRigor{FFTWRigor::Estimate};
+
+static unsigned rigorFlags(FFTWRigor rigor) {
+    switch (rigor) {
+        case FFTWRigor::Measure: return FFTW_MEASURE;
+        case FFTWRigor::Patient: return FFTW_PATIENT;
+        default: return FFTW_ESTIMATE;
+    }
+}
+
+static void destroyEntry(FFTWPlanEntry& entry) {
+    if (entry.plan) {
+        fftw_destroy_plan(entry.plan);
+    }
+    if (entry.complexOut != entry.complexIn) {
+        fftw_free(entry.complexOut);
+    }
+    fftw_free(entry.complexIn);
+    fftw_free(entry.realData);
+}
+
+// Batched plans over howMany contiguous slots, one transform of size points each (halfSize on the
+// complex side of real transforms). plan_many takes the slot distances as int, so a key whose
+// transforms are too large for that is left unplanned.
+static void planMany(FFTWPlanEntry& entry, const FFTWPlanKey& key, size_t size, size_t halfSize, unsigned flags) {
+    if (size > static_cast<size_t>(numeric_limits<int>::max())) {
+        return;
+    }
+    int dims[2] = {key.rows, key.cols};
+    int distance = static_cast<int>(size);
+    int halfDistance = static_cast<int>(halfSize);
+    switch (key.transform) {
+        case FFTWTransform::Complex:
+            entry.plan = fftw_plan_many_dft(2, dims, key.howMany, entry.complexIn, nullptr, 1, distance, entry.complexOut, nullptr, 1, distance,
+                                            key.direction, flags);
+            break;
+        case FFTWTransform::RealToComplex:
+            entry.plan = fftw_plan_many_dft_r2c(2, dims, key.howMany, entry.realData, nullptr, 1, distance, entry.complexOut, nullptr, 1,
+                                                halfDistance, flags);
+            break;
+        case FFTWTransform::ComplexToReal:
+            entry.plan = fftw_plan_many_dft_c2r(2, dims, key.howMany, entry.complexIn, nullptr, 1, halfDistance, entry.realData, nullptr, 1,
+                                                distance, flags);
+            break;
+    }
+}
+
+static unique_ptr<FFTWPlanEntry> createEntry(const FFTWPlanKey& key) {
+    auto entry = make_unique<FFTWPlanEntry>();
+    size_t size = static_cast<size_t>(key.rows) * key.cols;
+    size_t halfSize = static_cast<size_t>(key.rows) * (key.cols / 2 + 1);
+    size_t howMany = key.howMany;
+    unsigned flags = rigorFlags(planningRigor.load());
+
+    // Buffers are allocated before planning because measuring overwrites them
+    switch (key.transform) {
+        case FFTWTransform::Complex:
+            entry->complexIn = fftw_alloc_complex(size * howMany);
+            entry->complexOut = key.inPlace ? entry->complexIn : fftw_alloc_complex(size * howMany);
+            break;
+        case FFTWTransform::RealToComplex:
+            entry->realData = fftw_alloc_real(size * howMany);
+            entry->complexOut = fftw_alloc_complex(halfSize * howMany);
+            break;
+        case FFTWTransform::ComplexToReal:
+            entry->complexIn = fftw_alloc_complex(halfSize * howMany);
+            entry->realData = fftw_alloc_real(size * howMany);
+            break;
+    }
+    if (howMany > 1) {
+        planMany(*entry, key, size, halfSize, flags);
+        return entry;
+    }
+
+    switch (key.transform) {
+        case FFTWTransform::Complex:
+            entry->plan = fftw_plan_dft_2d(key.rows, key.cols, entry->complexIn, entry->complexOut, key.direction, flags);
+            break;
+        case FFTWTransform::RealToComplex:
+            entry->plan = fftw_plan_dft_r2c_2d(key.rows, key.cols, entry->realData, entry->complexOut, flags);
+            break;
+        case FFTWTransform::ComplexToReal:
+            entry->plan = fftw_plan_dft_c2r_2d(key.rows, key.cols, entry->complexIn, entry->realData, flags);
+            break;
+    }
+    return entry;
+}
+
+FFTWPlanEntry& getFFTWPlan(const FFTWPlanKey& key) {
+    lock_guard<mutex> lock(plannerMutex);
+    unique_ptr<FFTWPlanEntry>& entry = planCache[key];
+    if (!entry) {
+        entry = createEntry(key);
+    }
+    return *entry;
+}
+
+void setFFTWPlanningRigor(FFTWRigor rigor) {
+    planningRigor.store(rigor);
+}
+
+bool loadFFTWWisdom(const string& path) {
+    lock_guard<mutex> lock(plannerMutex);
+    return fftw_import_wisdom_from_filename(path.c_str()) != 0;
+}
+
+bool saveFFTWWisdom(const string& path) {
+    lock_guard<mutex> lock(plannerMutex);
+    return fftw_export_wisdom_to_filename(path.c_str()) != 0;
+}
+
+void clearFFTWPlanCache() {
+    lock_guard<mutex> lock(plannerMutex);
+    for (auto& [key, entry] : planCache) {
+        lock_guard<mutex> entryLock(entry->lock);
+        destroyEntry(*entry);
+    }
+    planCache.clear();
+}
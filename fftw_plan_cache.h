@@ -0,0 +1,60 @@
+#pragma once
+#include <fftw3.h>
+#include <mutex>
+#include <string>
+#include <compare>
+
+using namespace std;
+
+// How much time FFTW may spend finding a fast plan. Anything above Estimate runs trial
+// transforms, so it is only worth it for sizes that are used many times or with saved wisdom.
+enum class FFTWRigor {
+    Estimate,
+    Measure,
+    Patient
+};
+
+enum class FFTWTransform {
+    Complex,        // complex to complex, either direction
+    RealToComplex,  // real input, half-spectrum output (forward)
+    ComplexToReal   // half-spectrum input, real output (backward)
+};
+
+struct FFTWPlanKey {
+    int rows = 0;
+    int cols = 0;
+    int direction = FFTW_FORWARD;
+    bool inPlace = false;
+    FFTWTransform transform = FFTWTransform::Complex;
+    int howMany = 1;    // transforms per execute, each in its own rows x cols slot of the buffers
+
+    auto operator<=>(const FFTWPlanKey&) const = default;
+};
+
+// A cached 2D plan together with the aligned buffers it was planned on. Buffers stay alive with
+// the plan, so each call only copies data in and out. Lock `lock` around fill, execute and read.
+// For real transforms the real side holds rows * cols doubles and the complex side
+// rows * (cols / 2 + 1) values, times howMany back to back; in-place is only supported for complex
+// transforms.
+struct FFTWPlanEntry {
+    fftw_plan plan = nullptr;
+    fftw_complex* complexIn = nullptr;
+    fftw_complex* complexOut = nullptr;
+    double* realData = nullptr;
+    mutex lock;
+};
+
+// Cached plan for key, planned on first use with the current rigor. howMany > 1 is planned with
+// plan_many, whose slot distances are int: if one transform has more points than an int holds,
+// the entry's plan is null and the transforms have to be run one at a time.
+FFTWPlanEntry& getFFTWPlan(const FFTWPlanKey& key);
+
+// Rigor used for plans created from now on (default Estimate)
+void setFFTWPlanningRigor(FFTWRigor rigor);
+
+// Load / save accumulated FFTW wisdom so later runs skip planning. Both return false on failure.
+bool loadFFTWWisdom(const string& path);
+bool saveFFTWWisdom(const string& path);
+
+// Destroy every cached plan and free its buffers
+void clearFFTWPlanCache();
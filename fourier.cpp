@@ -1,202 +1,1657 @@
-#include "fourier.h"
-
-using namespace std;
-
-vector<vector<complex<double>>> DFT2D(vector<vector<int>>& matrix)   {
-    vector<vector<complex<double>>> dftMatrix(matrix.size(), vector<complex<double>>(matrix[0].size(), 0));
-    for(size_t r = 0; r < matrix.size(); ++r)   {
-        for(size_t c = 0; c < matrix[0].size(); ++c)    {
-            //naive approach O(n^4)!
-            dftMatrix[r][c] = calculateDFT2D(matrix, r, c);
-        }
-    }
-    return dftMatrix;
-}
-
-int getNextPowerOf2(size_t currentSize)   {
-    currentSize--;
-    currentSize |= currentSize >> 1;
-    currentSize |= currentSize >> 2;
-    currentSize |= currentSize >> 4;
-    currentSize |= currentSize >> 8;
-    currentSize |= currentSize >> 16;
-    currentSize++;
-    return currentSize;
-}
-
-vector<vector<complex<double>>> DFT2DFFT(vector<vector<int>>& matrix) {
-    // Step 1: Convert each row to complex and apply FFT
-    vector<vector<complex<double>>> rowTransformed(matrix.size());
-    for (size_t r = 0; r < matrix.size(); ++r) {
-        vector<complex<double>> complexRow(matrix[r].begin(), matrix[r].end());
-        rowTransformed[r] = FFT(complexRow);
-    }
-
-    // Step 2: Transpose the result of the row-wise FFT
-    auto transposed = transposeMatrix(rowTransformed);
-
-    // Step 3: Perform FFT on each "column" of the original matrix (each row of the transposed matrix)
-    for (size_t c = 0; c < transposed.size(); ++c) {
-        transposed[c] = FFT(transposed[c]);
-    }
-
-    // Step 4: Transpose back to original orientation
-    auto finalResult = transposeMatrix(transposed);
-
-    return finalResult;
-}
-
-vector<vector<complex<double>>> transposeMatrix(const vector<vector<complex<double>>>& matrix) {
-    size_t rows = matrix.size();
-    size_t cols = matrix[0].size();
-    
-    // Create a new matrix with transposed dimensions
-    vector<vector<complex<double>>> transposed(cols, vector<complex<double>>(rows));
-
-    // Fill the new matrix by swapping rows and columns
-    for (size_t i = 0; i < rows; ++i) {
-        for (size_t j = 0; j < cols; ++j) {
-            transposed[j][i] = matrix[i][j];
-        }
-    }
-    
-    return transposed;
-}
-
-
-
-vector<complex<double>> FFT(vector<complex<double>>& input) {
-    // Find next power of two to pad for efficient FFT calculation
-    int powerOf2Size = getNextPowerOf2(input.size());
-    vector<complex<double>> paddedInput(powerOf2Size, 0);
-
-    // Copy over initial values to padded vector as complex numbers
-    for (size_t i = 0; i < input.size(); ++i) {
-        paddedInput[i] = input[i];
-    }
-
-    // Reorder paddedInput array for bottom-up FFT solution
-    reorderInput(paddedInput);
-
-    // Perform FFT calculations
-    // Outer loop over stages (each stage doubles the butterfly size)
-    for (int stageSize = 2; stageSize <= powerOf2Size; stageSize *= 2) {
-        
-        // Calculate the twiddle increment factor for this stage
-        complex<double> twiddleIncrement = exp(-2.0 * numbers::pi * imaginary_i / static_cast<double>(stageSize));
-
-        // Loop over each butterfly block in the current stage
-        for (int start = 0; start < powerOf2Size; start += stageSize) {
-            complex<double> twiddleFactor = 1.0;  // Reset for each new butterfly
-
-            // Inner loop over each butterfly pair in the block
-            for (int pair = 0; pair < stageSize / 2; ++pair) {
-                // Top and bottom index within the butterfly
-                int topIndex = start + pair;
-                int bottomIndex = start + pair + stageSize / 2;
-
-                // Calculate butterfly values
-                complex<double> top = paddedInput[topIndex];
-                complex<double> bottom = twiddleFactor * paddedInput[bottomIndex];
-
-                // Update values in-place
-                paddedInput[topIndex] = top + bottom;
-                paddedInput[bottomIndex] = top - bottom;
-
-                // Update twiddle factor
-                twiddleFactor *= twiddleIncrement;
-            }
-        }
-    }
-
-    // Return the transformed array
-    return paddedInput;
-}
-
-
-void reorderInput(vector<complex<double>>& input)   {
-    for (int i = 0; i < input.size(); ++i) {
-        int j = getBitReversedIndex(i, input.size()); // Function to calculate bit-reversed index
-        if (i < j) {
-            swap(input[i], input[j]);
-        }
-    }
-}
-
-int getBitReversedIndex(int index, int listSize) {
-    int rev = 0;
-    int bits = static_cast<int>(log2(listSize)); // Number of bits in listSize (assuming listSize is a power of 2)
-
-    for (int i = 0; i < bits; i++) {
-        // Shift rev left to make space for the next bit
-        rev = (rev << 1) | (index & 1); // Add the least significant bit of index to rev
-        index >>= 1; // Shift index right to get the next bit in the next iteration
-    }
-
-    return rev;
-}
-
-complex<double> calculateDFT2D(vector<vector<int>>& matrix, size_t k, size_t l)    {
-    complex<double> dftSum = 0;
-    for(size_t r = 0; r < matrix.size(); ++r)   {
-        for(size_t c = 0; c < matrix[0].size(); ++c)    {
-            dftSum += getDftStep(matrix, r, c, k, l);
-        }
-    }
-    return dftSum;
-}
-
-complex<double> getDftStep(vector<vector<int>>& matrix, size_t r, size_t c, size_t k, size_t l) {
-    double M = static_cast<double>(matrix.size());
-    double N = static_cast<double>(matrix[0].size());
-    double angle = -2.0 * numbers::pi * ((k * r) / M) + ((l * c) / N);
-    return static_cast<double>(matrix[r][c]) * exp(imaginary_i * angle);
-}
-
-void performIFFT(const vector<vector<complex<double>>>& fft_output, vector<vector<complex<double>>>& ifft_result) {
-    int rows = fft_output.size();
-    int cols = fft_output[0].size();
-    int N = rows * cols;
-
-    // Allocate memory for FFTW input/output in 1D format
-    fftw_complex *in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * N);
-    fftw_complex *out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * N);
-
-    // Convert 2D vector to 1D fftw_complex array
-    for (int r = 0; r < rows; ++r) {
-        for (int c = 0; c < cols; ++c) {
-            int idx = r * cols + c;
-            in[idx][0] = fft_output[r][c].real();
-            in[idx][1] = fft_output[r][c].imag();
-        }
-    }
-
-    // Create FFTW plan for IFFT
-    fftw_plan ifft_plan = fftw_plan_dft_2d(rows, cols, in, out, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-    // Execute IFFT
-    fftw_execute(ifft_plan);
-
-    // Convert 1D fftw_complex array back to 2D vector and normalize
-    ifft_result.resize(rows, vector<complex<double>>(cols));
-    for (int r = 0; r < rows; ++r) {
-        for (int c = 0; c < cols; ++c) {
-            int idx = r * cols + c;
-            ifft_result[r][c] = complex<double>(out[idx][0] / N, out[idx][1] / N);  // Normalize
-        }
-    }
-
-    // Clean up
-    fftw_destroy_plan(ifft_plan);
-    fftw_free(in);
-    fftw_free(out);
-}
-
-void printComplexMatrix(const vector<vector<complex<double>>>& matrix) {
-    for (const auto& row : matrix) {
-        for (const auto& elem : row) {
-            cout << "(" << elem.real() << ", " << elem.imag() << "i) ";
-        }
-        cout << endl;
-    }
+#include "fourier.h"
+#include "fftw_plan_cache.h"
+#include "trace.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+int getNextPowerOf2(size_t currentSize)   {
+    currentSize--;
+    currentSize |= currentSize >> 1;
+    currentSize |= currentSize >> 2;
+    currentSize |= currentSize >> 4;
+    currentSize |= currentSize >> 8;
+    currentSize |= currentSize >> 16;
+    currentSize++;
+    return currentSize;
+}
+
+// Copy a contiguous row-major grid out into the nested layout the public API returns
+static vector<vector<complex<double>>> toNestedMatrix(const vector<complex<double>>& grid, size_t rows, size_t cols) {
+    vector<vector<complex<double>>> matrix(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        matrix[r].assign(grid.begin() + r * cols, grid.begin() + (r + 1) * cols);
+    }
+    return matrix;
+}
+
+// Columns per batch handed to executeFFTColumns
+static const size_t columnBlockWidth = 16;
+
+// Run body over [0, count) in batches on the pool, or inline when there is none.
+// A few batches per thread leave room for stealing when batches finish unevenly.
+// Inline runs call body directly, so they never pay for wrapping it in a std::function.
+template <typename Body>
+static void forEachBatch(ThreadPool* pool, size_t count, const Body& body) {
+    if (!pool) {
+        body(0, count);
+        return;
+    }
+    size_t grainSize = max<size_t>(1, count / (4 * pool->concurrency()));
+    pool->parallelFor(count, grainSize, body);
+}
+
+// Column FFTs over [0, cols) split into batches of whole column blocks
+static void fftColumnBatches(const FFTPlan& plan, complex<double>* data, size_t cols, size_t rowStride, ThreadPool* pool) {
+    size_t blockCount = (cols + columnBlockWidth - 1) / columnBlockWidth;
+    forEachBatch(pool, blockCount, [&](size_t begin, size_t end) {
+        executeFFTColumns(plan, data, rowStride, begin * columnBlockWidth, min(end * columnBlockWidth, cols));
+    });
+}
+
+// Rows of a forward-transform input, either a nested int matrix or a byte view
+static size_t getInputRows(const vector<vector<int>>& matrix) { return matrix.size(); }
+static size_t getInputCols(const vector<vector<int>>& matrix) { return matrix[0].size(); }
+static const int* getInputRow(const vector<vector<int>>& matrix, size_t r) { return matrix[r].data(); }
+static size_t getInputRows(MatrixView<const uint8_t> image) { return image.rows; }
+static size_t getInputCols(MatrixView<const uint8_t> image) { return image.cols; }
+static const uint8_t* getInputRow(MatrixView<const uint8_t> image, size_t r) { return image.row(r); }
+
+// Forward complex 2D transform through a cached FFTW plan; outputRow(r) is where row r of the result goes
+template <typename Input, typename OutputRow>
+static void DFT2DFFTW(const Input& input, size_t rows, size_t cols, OutputRow outputRow) {
+    FFTWPlanEntry& plan = getFFTWPlan({static_cast<int>(rows), static_cast<int>(cols), FFTW_FORWARD, true, FFTWTransform::Complex});
+    lock_guard<mutex> lock(plan.lock);
+
+    fill_n(&plan.complexIn[0][0], 2 * rows * cols, 0.0);
+    for (size_t r = 0; r < getInputRows(input); ++r) {
+        const auto* row = getInputRow(input, r);
+        for (size_t c = 0; c < getInputCols(input); ++c) {
+            plan.complexIn[r * cols + c][0] = row[c];
+        }
+    }
+    fftw_execute(plan.plan);
+
+    for (size_t r = 0; r < rows; ++r) {
+        complex<double>* out = outputRow(r);
+        for (size_t c = 0; c < cols; ++c) {
+            out[c] = complex<double>(plan.complexOut[r * cols + c][0], plan.complexOut[r * cols + c][1]);
+        }
+    }
+}
+
+// Forward real-to-half-spectrum 2D transform through a cached FFTW plan
+template <typename Input, typename OutputRow>
+static void DFT2DRealFFTW(const Input& input, size_t rows, size_t cols, OutputRow outputRow) {
+    FFTWPlanEntry& plan = getFFTWPlan({static_cast<int>(rows), static_cast<int>(cols), FFTW_FORWARD, false, FFTWTransform::RealToComplex});
+    lock_guard<mutex> lock(plan.lock);
+
+    fill_n(plan.realData, rows * cols, 0.0);
+    for (size_t r = 0; r < getInputRows(input); ++r) {
+        const auto* row = getInputRow(input, r);
+        copy(row, row + getInputCols(input), plan.realData + r * cols);
+    }
+    fftw_execute(plan.plan);
+
+    size_t halfCols = cols / 2 + 1;
+    for (size_t r = 0; r < rows; ++r) {
+        complex<double>* out = outputRow(r);
+        for (size_t c = 0; c < halfCols; ++c) {
+            out[c] = complex<double>(plan.complexOut[r * halfCols + c][0], plan.complexOut[r * halfCols + c][1]);
+        }
+    }
+}
+
+// Transform size and zero padding of one 2D transform
+static void traceTransformSize(size_t rows, size_t cols, size_t paddedRows, size_t paddedCols) {
+    TRACE_COUNTER("fft.pixels", paddedRows * paddedCols);
+    TRACE_COUNTER("fft.paddingPixels", paddedRows * paddedCols - rows * cols);
+}
+
+static void fft2DStrided(complex<double>* data, size_t rows, size_t cols, size_t rowStride, ThreadPool* pool) {
+    const FFTPlan& rowPlan = getFFTPlan(cols);
+    const FFTPlan& colPlan = getFFTPlan(rows);
+
+    TRACE_SCOPE_NAMED(rowPass, "fft2D.rows");
+    forEachBatch(pool, rows, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            executeFFT(rowPlan, data + r * rowStride);
+        }
+    });
+    TRACE_END(rowPass);
+
+    TRACE_SCOPE("fft2D.columns");
+    fftColumnBatches(colPlan, data, cols, rowStride, pool);
+}
+
+// In-house complex transform of input zero padded to the shape of grid
+template <typename Input>
+static void complexFFT2D(const Input& input, MatrixView<complex<double>> grid, ThreadPool* pool) {
+    for (size_t r = 0; r < grid.rows; ++r) {
+        complex<double>* row = grid.row(r);
+        size_t filled = 0;
+        if (r < getInputRows(input)) {
+            const auto* source = getInputRow(input, r);
+            filled = getInputCols(input);
+            copy(source, source + filled, row);
+        }
+        fill(row + filled, row + grid.cols, 0);
+    }
+    fft2DStrided(grid.data, grid.rows, grid.cols, grid.stride, pool);
+}
+
+// In-house half-spectrum transform of input zero padded to grid.rows x cols; grid is cols / 2 + 1 wide
+// Half-spectrum of every input row into the first input rows of grid: two real rows go through
+// one complex FFT (x + iy) and are split using X[k] = (Z[k] + conj(Z[N-k])) / 2 and
+// Y[k] = (Z[k] - conj(Z[N-k])) / 2i.
+template <typename Input>
+static void realRowFFTs(const Input& input, MatrixView<complex<double>> grid, size_t cols, ThreadPool* pool) {
+    const FFTPlan& rowPlan = getFFTPlan(cols);
+    size_t halfCols = cols / 2 + 1;
+    size_t inputRows = getInputRows(input);
+    size_t inputCols = getInputCols(input);
+    size_t pairCount = (inputRows + 1) / 2;
+    forEachBatch(pool, pairCount, [&](size_t pairBegin, size_t pairEnd) {
+        // Reused across calls so steady-state transforms don't allocate
+        thread_local vector<complex<double>> packed;
+        packed.resize(cols);
+        for (size_t r = 2 * pairBegin; r < 2 * pairEnd; r += 2) {
+            bool hasPair = r + 1 < inputRows;
+            const auto* first = getInputRow(input, r);
+            const auto* second = hasPair ? getInputRow(input, r + 1) : nullptr;
+            fill(packed.begin(), packed.end(), 0);
+            for (size_t c = 0; c < inputCols; ++c) {
+                packed[c] = complex<double>(first[c], hasPair ? second[c] : 0);
+            }
+            executeFFT(rowPlan, packed.data());
+
+            complex<double>* firstOut = grid.row(r);
+            complex<double>* secondOut = hasPair ? grid.row(r + 1) : nullptr;
+            for (size_t k = 0; k < halfCols; ++k) {
+                complex<double> z = packed[k];
+                complex<double> mirrored = conj(packed[(cols - k) % cols]);
+                firstOut[k] = 0.5 * (z + mirrored);
+                if (hasPair) {
+                    secondOut[k] = complex<double>(0, -0.5) * (z - mirrored);
+                }
+            }
+        }
+    });
+}
+
+template <typename Input>
+static void realFFT2D(const Input& input, MatrixView<complex<double>> grid, size_t cols, ThreadPool* pool) {
+    const FFTPlan& colPlan = getFFTPlan(grid.rows);
+    size_t halfCols = cols / 2 + 1;
+    size_t inputRows = getInputRows(input);
+
+    // Step 1: Row FFTs of the real input
+    realRowFFTs(input, grid, cols, pool);
+    // Padding rows stay zero
+    for (size_t r = inputRows; r < grid.rows; ++r) {
+        fill_n(grid.row(r), halfCols, 0);
+    }
+
+    // Step 2: Column FFTs over the kept half only
+    TRACE_SCOPE("DFT2DRealFFT.columns");
+    fftColumnBatches(colPlan, grid.data, halfCols, grid.stride, pool);
+}
+
+// Single precision ---------------------------------------------------------------------------
+// Split float planes transformed by the kernels in fft_simd.cpp. Power-of-two axes use the split
+// plans; other sizes go through the complex<double> plans a row or column at a time.
+
+static bool isPowerOf2(size_t n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// Transform engine for one axis of a split-storage grid
+template <typename T>
+struct SplitAxis {
+    const SplitFFTPlan<T>* split = nullptr;
+    const FFTPlan* fallback = nullptr;
+
+    explicit SplitAxis(size_t n) {
+        if (isPowerOf2(n)) {
+            split = &getSplitFFTPlan<T>(n);
+        } else {
+            fallback = &getFFTPlan(n);
+        }
+    }
+};
+
+template <typename T>
+static void splitFFTRow(const SplitAxis<T>& axis, T* re, T* im) {
+    if (axis.split) {
+        executeSplitFFT(*axis.split, re, im);
+        return;
+    }
+    size_t n = axis.fallback->size;
+    thread_local vector<complex<double>> row;
+    row.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        row[i] = complex<double>(re[i], im[i]);
+    }
+    executeFFT(*axis.fallback, row.data());
+    for (size_t i = 0; i < n; ++i) {
+        re[i] = static_cast<T>(row[i].real());
+        im[i] = static_cast<T>(row[i].imag());
+    }
+}
+
+// Columns [colBegin, colEnd) of a split grid, gathered a block at a time into contiguous
+// interleaved columns so one batched transform covers the whole block
+template <typename T>
+static void splitFFTColumns(const SplitAxis<T>& axis, T* re, T* im, size_t rowStride, size_t colBegin, size_t colEnd) {
+    const size_t blockWidth = columnBlockWidth;
+    size_t n = axis.split ? axis.split->size : axis.fallback->size;
+    thread_local vector<T> blockRe, blockIm;
+    thread_local vector<complex<double>> column;
+    blockRe.resize(n * blockWidth);
+    blockIm.resize(n * blockWidth);
+
+    for (size_t blockBegin = colBegin; blockBegin < colEnd; blockBegin += blockWidth) {
+        size_t width = min(blockWidth, colEnd - blockBegin);
+        if (!axis.split) {
+            for (size_t j = blockBegin; j < blockBegin + width; ++j) {
+                column.resize(n);
+                for (size_t i = 0; i < n; ++i) {
+                    column[i] = complex<double>(re[i * rowStride + j], im[i * rowStride + j]);
+                }
+                executeFFT(*axis.fallback, column.data());
+                for (size_t i = 0; i < n; ++i) {
+                    re[i * rowStride + j] = static_cast<T>(column[i].real());
+                    im[i * rowStride + j] = static_cast<T>(column[i].imag());
+                }
+            }
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            copy_n(re + i * rowStride + blockBegin, width, blockRe.data() + i * width);
+            copy_n(im + i * rowStride + blockBegin, width, blockIm.data() + i * width);
+        }
+        executeSplitFFT(*axis.split, blockRe.data(), blockIm.data(), width);
+        for (size_t i = 0; i < n; ++i) {
+            copy_n(blockRe.data() + i * width, width, re + i * rowStride + blockBegin);
+            copy_n(blockIm.data() + i * width, width, im + i * rowStride + blockBegin);
+        }
+    }
+}
+
+// Rows [rowBegin, rowEnd) of a split grid. Split plans take up to a block of rows at a time,
+// transposed into interleaved columns, so short rows still run every stage vectorised.
+template <typename T>
+static void splitFFTRows(const SplitAxis<T>& axis, T* re, T* im, size_t rowStride, size_t rowBegin, size_t rowEnd) {
+    if (!axis.split) {
+        for (size_t r = rowBegin; r < rowEnd; ++r) {
+            splitFFTRow(axis, re + r * rowStride, im + r * rowStride);
+        }
+        return;
+    }
+    const size_t blockHeight = columnBlockWidth;
+    size_t n = axis.split->size;
+    thread_local vector<T> blockRe, blockIm;
+    blockRe.resize(n * blockHeight);
+    blockIm.resize(n * blockHeight);
+
+    for (size_t blockBegin = rowBegin; blockBegin < rowEnd; blockBegin += blockHeight) {
+        size_t height = min(blockHeight, rowEnd - blockBegin);
+        for (size_t j = 0; j < height; ++j) {
+            const T* rowRe = re + (blockBegin + j) * rowStride;
+            const T* rowIm = im + (blockBegin + j) * rowStride;
+            for (size_t i = 0; i < n; ++i) {
+                blockRe[i * height + j] = rowRe[i];
+                blockIm[i * height + j] = rowIm[i];
+            }
+        }
+        executeSplitFFT(*axis.split, blockRe.data(), blockIm.data(), height);
+        for (size_t j = 0; j < height; ++j) {
+            T* rowRe = re + (blockBegin + j) * rowStride;
+            T* rowIm = im + (blockBegin + j) * rowStride;
+            for (size_t i = 0; i < n; ++i) {
+                rowRe[i] = blockRe[i * height + j];
+                rowIm[i] = blockIm[i * height + j];
+            }
+        }
+    }
+}
+
+// Column pass over a rows x cols split grid, in batches of whole column blocks
+template <typename T>
+static void splitFFTColumnBatches(const SplitAxis<T>& axis, T* re, T* im, size_t cols, size_t rowStride, ThreadPool* pool) {
+    size_t blockCount = (cols + columnBlockWidth - 1) / columnBlockWidth;
+    forEachBatch(pool, blockCount, [&](size_t begin, size_t end) {
+        splitFFTColumns(axis, re, im, rowStride, begin * columnBlockWidth, min(end * columnBlockWidth, cols));
+    });
+}
+
+// Split planes kept in a complex grid's own storage, so no scratch grid is needed: row r of the
+// real plane is the first cols values of grid row r and row r of the imaginary plane the next
+// cols, giving both planes a row stride of two grid rows' worth of T
+template <typename T>
+struct SplitGrid {
+    T* re;
+    T* im;
+    size_t rowStride;
+};
+
+template <typename T>
+static SplitGrid<T> splitInPlace(MatrixView<complex<T>> grid) {
+    T* base = reinterpret_cast<T*>(grid.data);
+    return {base, base + grid.cols, 2 * grid.stride};
+}
+
+// Turn every row of a grid split in place back into complex values
+template <typename T>
+static void interleaveInPlace(MatrixView<complex<T>> grid, ThreadPool* pool) {
+    forEachBatch(pool, grid.rows, [&](size_t begin, size_t end) {
+        thread_local vector<T> row;
+        row.resize(2 * grid.cols);
+        for (size_t r = begin; r < end; ++r) {
+            complex<T>* out = grid.row(r);
+            copy_n(reinterpret_cast<const T*>(out), 2 * grid.cols, row.data());
+            for (size_t c = 0; c < grid.cols; ++c) {
+                out[c] = complex<T>(row[c], row[grid.cols + c]);
+            }
+        }
+    });
+}
+
+template <typename Input>
+static void complexFFT2DFloat(const Input& input, MatrixView<complex<float>> spectrum, ThreadPool* pool) {
+    size_t rows = spectrum.rows;
+    size_t cols = spectrum.cols;
+    SplitAxis<float> rowAxis(cols);
+    SplitAxis<float> colAxis(rows);
+
+    // The input is real, so the imaginary plane starts out zero
+    SplitGrid<float> planes = splitInPlace(spectrum);
+    for (size_t r = 0; r < rows; ++r) {
+        float* rowRe = planes.re + r * planes.rowStride;
+        fill_n(rowRe, 2 * cols, 0.0f);
+        if (r < getInputRows(input)) {
+            const auto* source = getInputRow(input, r);
+            copy(source, source + getInputCols(input), rowRe);
+        }
+    }
+
+    TRACE_SCOPE_NAMED(rowPass, "fft2D.rows");
+    size_t blockCount = (rows + columnBlockWidth - 1) / columnBlockWidth;
+    forEachBatch(pool, blockCount, [&](size_t begin, size_t end) {
+        splitFFTRows(rowAxis, planes.re, planes.im, planes.rowStride, begin * columnBlockWidth, min(end * columnBlockWidth, rows));
+    });
+    TRACE_END(rowPass);
+
+    TRACE_SCOPE("fft2D.columns");
+    splitFFTColumnBatches(colAxis, planes.re, planes.im, cols, planes.rowStride, pool);
+    interleaveInPlace(spectrum, pool);
+}
+
+template <typename Input>
+static void realFFT2DFloat(const Input& input, MatrixView<complex<float>> halfSpectrum, size_t cols, ThreadPool* pool) {
+    size_t rows = halfSpectrum.rows;
+    size_t halfCols = cols / 2 + 1;
+    size_t inputRows = getInputRows(input);
+    size_t inputCols = getInputCols(input);
+    SplitAxis<float> rowAxis(cols);
+    SplitAxis<float> colAxis(rows);
+
+    SplitGrid<float> planes = splitInPlace(halfSpectrum);
+    float* re = planes.re;
+    float* im = planes.im;
+    size_t rowStride = planes.rowStride;
+    // Padding rows stay zero
+    for (size_t r = inputRows; r < rows; ++r) {
+        fill_n(re + r * rowStride, 2 * halfCols, 0.0f);
+    }
+
+    // Two real rows per complex FFT, one in each plane, split as in the double path:
+    // X[k] = (Z[k] + conj(Z[N-k])) / 2 and Y[k] = (Z[k] - conj(Z[N-k])) / 2i
+    size_t pairCount = (inputRows + 1) / 2;
+    forEachBatch(pool, pairCount, [&](size_t pairBegin, size_t pairEnd) {
+        // One row pair of scratch per thread, as in the double path
+        thread_local vector<float> packed;
+        packed.resize(2 * cols);
+        float* packedRe = packed.data();
+        float* packedIm = packed.data() + cols;
+        for (size_t r = 2 * pairBegin; r < 2 * pairEnd; r += 2) {
+            bool hasPair = r + 1 < inputRows;
+            fill(packed.begin(), packed.end(), 0.0f);
+            const auto* first = getInputRow(input, r);
+            copy(first, first + inputCols, packedRe);
+            if (hasPair) {
+                const auto* second = getInputRow(input, r + 1);
+                copy(second, second + inputCols, packedIm);
+            }
+            splitFFTRow(rowAxis, packedRe, packedIm);
+
+            for (size_t k = 0; k < halfCols; ++k) {
+                size_t mirror = (cols - k) % cols;
+                float a = packedRe[k], b = packedIm[k];
+                float c = packedRe[mirror], d = packedIm[mirror];
+                re[r * rowStride + k] = 0.5f * (a + c);
+                im[r * rowStride + k] = 0.5f * (b - d);
+                if (hasPair) {
+                    re[(r + 1) * rowStride + k] = 0.5f * (b + d);
+                    im[(r + 1) * rowStride + k] = 0.5f * (c - a);
+                }
+            }
+        }
+    });
+
+    TRACE_SCOPE("DFT2DRealFFT.columns");
+    splitFFTColumnBatches(colAxis, re, im, halfCols, rowStride, pool);
+    interleaveInPlace(halfSpectrum, pool);
+}
+
+// Nested copy of a single-precision grid
+static vector<vector<complex<double>>> toNestedMatrix(MatrixView<const complex<float>> grid) {
+    vector<vector<complex<double>>> matrix(grid.rows);
+    for (size_t r = 0; r < grid.rows; ++r) {
+        matrix[r].assign(grid.row(r), grid.row(r) + grid.cols);
+    }
+    return matrix;
+}
+
+vector<vector<complex<double>>> DFT2DFFT(vector<vector<int>>& matrix, ThreadPool* pool, FFTPadding padding, FFTBackend backend,
+                                         FFTPrecision precision) {
+    TRACE_SCOPE("DFT2DFFT");
+    size_t rows = getTransformSize(matrix.size(), padding);
+    size_t cols = getTransformSize(matrix[0].size(), padding);
+    traceTransformSize(matrix.size(), matrix[0].size(), rows, cols);
+    if (backend == FFTBackend::FFTW) {
+        vector<vector<complex<double>>> result(rows, vector<complex<double>>(cols));
+        DFT2DFFTW(matrix, rows, cols, [&](size_t r) { return result[r].data(); });
+        return result;
+    }
+    // Other sizes would go through the double plans anyway, and then there is nothing to gain
+    if (precision == FFTPrecision::Float && isPowerOf2(rows) && isPowerOf2(cols)) {
+        Matrix<complex<float>> grid(rows, cols);
+        complexFFT2DFloat(matrix, grid.view(), pool);
+        return toNestedMatrix(grid.view());
+    }
+
+    // One zero-padded contiguous grid, transformed in place
+    vector<complex<double>> grid(rows * cols);
+    complexFFT2D(matrix, MatrixView<complex<double>>(grid.data(), rows, cols), pool);
+    return toNestedMatrix(grid, rows, cols);
+}
+
+void DFT2DFFT(MatrixView<const uint8_t> image, MatrixView<complex<double>> spectrum, ThreadPool* pool, FFTBackend backend) {
+    TRACE_SCOPE("DFT2DFFT");
+    traceTransformSize(image.rows, image.cols, spectrum.rows, spectrum.cols);
+    if (backend == FFTBackend::FFTW) {
+        DFT2DFFTW(image, spectrum.rows, spectrum.cols, [&](size_t r) { return spectrum.row(r); });
+        return;
+    }
+    complexFFT2D(image, spectrum, pool);
+}
+
+vector<vector<complex<double>>> DFT2DRealFFT(vector<vector<int>>& matrix, ThreadPool* pool, FFTPadding padding, FFTBackend backend,
+                                             FFTPrecision precision) {
+    TRACE_SCOPE("DFT2DRealFFT");
+    size_t rows = getTransformSize(matrix.size(), padding);
+    size_t cols = getTransformSize(matrix[0].size(), padding);
+    size_t halfCols = cols / 2 + 1;
+    traceTransformSize(matrix.size(), matrix[0].size(), rows, cols);
+    if (backend == FFTBackend::FFTW) {
+        vector<vector<complex<double>>> result(rows, vector<complex<double>>(halfCols));
+        DFT2DRealFFTW(matrix, rows, cols, [&](size_t r) { return result[r].data(); });
+        return result;
+    }
+    if (precision == FFTPrecision::Float && isPowerOf2(rows) && isPowerOf2(cols)) {
+        Matrix<complex<float>> grid(rows, halfCols);
+        realFFT2DFloat(matrix, grid.view(), cols, pool);
+        return toNestedMatrix(grid.view());
+    }
+
+    vector<complex<double>> grid(rows * halfCols);
+    realFFT2D(matrix, MatrixView<complex<double>>(grid.data(), rows, halfCols), cols, pool);
+    return toNestedMatrix(grid, rows, halfCols);
+}
+
+void DFT2DRealFFT(MatrixView<const uint8_t> image, MatrixView<complex<double>> halfSpectrum, size_t cols, ThreadPool* pool, FFTBackend backend) {
+    TRACE_SCOPE("DFT2DRealFFT");
+    traceTransformSize(image.rows, image.cols, halfSpectrum.rows, cols);
+    if (backend == FFTBackend::FFTW) {
+        DFT2DRealFFTW(image, halfSpectrum.rows, cols, [&](size_t r) { return halfSpectrum.row(r); });
+        return;
+    }
+    realFFT2D(image, halfSpectrum, cols, pool);
+}
+
+void DFT2DRealFFTRows(MatrixView<const uint8_t> image, MatrixView<complex<double>> halfRows, size_t cols, ThreadPool* pool) {
+    realRowFFTs(image, halfRows, cols, pool);
+}
+
+void DFT2DFFT(MatrixView<const uint8_t> image, MatrixView<complex<float>> spectrum, ThreadPool* pool) {
+    TRACE_SCOPE("DFT2DFFT");
+    traceTransformSize(image.rows, image.cols, spectrum.rows, spectrum.cols);
+    complexFFT2DFloat(image, spectrum, pool);
+}
+
+void DFT2DRealFFT(MatrixView<const uint8_t> image, MatrixView<complex<float>> halfSpectrum, size_t cols, ThreadPool* pool) {
+    TRACE_SCOPE("DFT2DRealFFT");
+    traceTransformSize(image.rows, image.cols, halfSpectrum.rows, cols);
+    realFFT2DFloat(image, halfSpectrum, cols, pool);
+}
+
+// Batches -----------------------------------------------------------------------------------
+// Images of one size share a plan and run as interleaved split transforms: row r of up to a block
+// of images is gathered into one batched executeSplitFFT call, so small images still keep every
+// stage vectorised, and the column pass takes whole column blocks of one image at a time. Both
+// axes must be powers of two; other sizes use the single-image transforms an image at a time.
+
+// Images per FFTW plan_many execute: as many as fit in this many bytes of plan buffers, so a
+// large batch reuses one cached plan (plus one for the remainder) whatever its count. Images of
+// more than half the budget go one per execute through the plain 2D plan, so batched plans
+// always have slot distances that fit plan_many's int arguments.
+static const size_t fftwBatchBytes = size_t(64) << 20;
+
+static size_t getFFTWBatchSize(size_t count, size_t bytesPerImage) {
+    // Empty images (rows or cols of 0) go one at a time
+    if (bytesPerImage == 0) {
+        return 1;
+    }
+    return clamp<size_t>(fftwBatchBytes / bytesPerImage, 1, max<size_t>(count, 1));
+}
+
+// Cached plan for howMany transforms of key. getFFTWPlan leaves a batched plan null when
+// plan_many cannot take it; the rest of the batch then goes one image per execute, with howMany
+// and batchSize dropped to 1.
+static FFTWPlanEntry& getFFTWBatchPlan(FFTWPlanKey key, size_t& howMany, size_t& batchSize) {
+    key.howMany = static_cast<int>(howMany);
+    FFTWPlanEntry* entry = &getFFTWPlan(key);
+    if (!entry->plan && howMany > 1) {
+        howMany = batchSize = 1;
+        key.howMany = 1;
+        entry = &getFFTWPlan(key);
+    }
+    assert(entry->plan);
+    return *entry;
+}
+
+// In-place row pass over every grid of a batch. inverse conjugates the input; the matching
+// conjugate and scale are applied by the column pass.
+template <typename T>
+static void splitFFTRowsBatch(MatrixBatchView<complex<T>> grids, bool inverse, ThreadPool* pool) {
+    const SplitFFTPlan<T>& plan = getSplitFFTPlan<T>(grids.cols);
+    const size_t blockWidth = columnBlockWidth;
+    size_t n = grids.cols;
+    size_t groupCount = (grids.count + blockWidth - 1) / blockWidth;
+    T sign = inverse ? T(-1) : T(1);
+    // Task t is row t % rows of image group t / rows, so neighbouring tasks share a group
+    forEachBatch(pool, groupCount * grids.rows, [&](size_t begin, size_t end) {
+        thread_local vector<T> blockRe, blockIm;
+        blockRe.resize(n * blockWidth);
+        blockIm.resize(n * blockWidth);
+        for (size_t task = begin; task < end; ++task) {
+            size_t first = task / grids.rows * blockWidth;
+            size_t r = task % grids.rows;
+            size_t width = min(blockWidth, grids.count - first);
+            for (size_t j = 0; j < width; ++j) {
+                const complex<T>* row = grids[first + j].row(r);
+                for (size_t i = 0; i < n; ++i) {
+                    blockRe[i * width + j] = row[i].real();
+                    blockIm[i * width + j] = sign * row[i].imag();
+                }
+            }
+            executeSplitFFT(plan, blockRe.data(), blockIm.data(), width);
+            for (size_t j = 0; j < width; ++j) {
+                complex<T>* row = grids[first + j].row(r);
+                for (size_t i = 0; i < n; ++i) {
+                    row[i] = complex<T>(blockRe[i * width + j], blockIm[i * width + j]);
+                }
+            }
+        }
+    });
+}
+
+// In-place column pass over every grid of a batch; inverse finishes conj(fft(conj(x))) / N
+template <typename T>
+static void splitFFTColumnsBatch(MatrixBatchView<complex<T>> grids, bool inverse, ThreadPool* pool) {
+    const SplitFFTPlan<T>& plan = getSplitFFTPlan<T>(grids.rows);
+    const size_t blockWidth = columnBlockWidth;
+    size_t n = grids.rows;
+    size_t blockCount = (grids.cols + blockWidth - 1) / blockWidth;
+    T scale = inverse ? T(1) / static_cast<T>(grids.rows * grids.cols) : T(1);
+    T sign = inverse ? -scale : scale;
+    forEachBatch(pool, grids.count * blockCount, [&](size_t begin, size_t end) {
+        thread_local vector<T> blockRe, blockIm;
+        blockRe.resize(n * blockWidth);
+        blockIm.resize(n * blockWidth);
+        for (size_t task = begin; task < end; ++task) {
+            MatrixView<complex<T>> grid = grids[task / blockCount];
+            size_t blockBegin = task % blockCount * blockWidth;
+            size_t width = min(blockWidth, grids.cols - blockBegin);
+            for (size_t i = 0; i < n; ++i) {
+                const complex<T>* row = grid.row(i) + blockBegin;
+                for (size_t j = 0; j < width; ++j) {
+                    blockRe[i * width + j] = row[j].real();
+                    blockIm[i * width + j] = row[j].imag();
+                }
+            }
+            executeSplitFFT(plan, blockRe.data(), blockIm.data(), width);
+            for (size_t i = 0; i < n; ++i) {
+                complex<T>* row = grid.row(i) + blockBegin;
+                for (size_t j = 0; j < width; ++j) {
+                    row[j] = complex<T>(scale * blockRe[i * width + j], sign * blockIm[i * width + j]);
+                }
+            }
+        }
+    });
+}
+
+template <typename T>
+static void complexFFT2DBatch(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<T>> spectra, ThreadPool* pool) {
+    forEachBatch(pool, images.count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            MatrixView<const uint8_t> image = images[i];
+            MatrixView<complex<T>> spectrum = spectra[i];
+            for (size_t r = 0; r < spectrum.rows; ++r) {
+                complex<T>* row = spectrum.row(r);
+                size_t filled = r < image.rows ? image.cols : 0;
+                if (filled > 0) {
+                    copy(image.row(r), image.row(r) + filled, row);
+                }
+                fill(row + filled, row + spectrum.cols, complex<T>(0));
+            }
+        }
+    });
+    TRACE_SCOPE_NAMED(rowPass, "fft2D.rows");
+    splitFFTRowsBatch(spectra, false, pool);
+    TRACE_END(rowPass);
+    TRACE_SCOPE("fft2D.columns");
+    splitFFTColumnsBatch(spectra, false, pool);
+}
+
+// Row r of two images goes through one packed FFT (first image real, second imaginary) and up to
+// a block of such pairs are interleaved, then split as in realFFT2DFloat
+template <typename T>
+static void realFFT2DBatch(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<T>> halfSpectra, size_t cols, ThreadPool* pool) {
+    const SplitFFTPlan<T>& plan = getSplitFFTPlan<T>(cols);
+    const size_t blockWidth = columnBlockWidth;
+    const size_t groupImages = 2 * blockWidth;
+    size_t rows = halfSpectra.rows;
+    size_t halfCols = cols / 2 + 1;
+    size_t groupCount = (images.count + groupImages - 1) / groupImages;
+
+    TRACE_SCOPE_NAMED(rowPass, "DFT2DRealFFT.rows");
+    forEachBatch(pool, groupCount * rows, [&](size_t begin, size_t end) {
+        thread_local vector<T> blockRe, blockIm;
+        blockRe.resize(cols * blockWidth);
+        blockIm.resize(cols * blockWidth);
+        for (size_t task = begin; task < end; ++task) {
+            size_t first = task / rows * groupImages;
+            size_t r = task % rows;
+            size_t imageCount = min(groupImages, images.count - first);
+            if (r >= images.rows) {
+                // Padding rows stay zero
+                for (size_t j = 0; j < imageCount; ++j) {
+                    fill_n(halfSpectra[first + j].row(r), halfCols, complex<T>(0));
+                }
+                continue;
+            }
+            size_t width = (imageCount + 1) / 2;
+            fill_n(blockRe.data(), cols * width, T(0));
+            fill_n(blockIm.data(), cols * width, T(0));
+            for (size_t j = 0; j < imageCount; ++j) {
+                const uint8_t* row = images[first + j].row(r);
+                T* plane = j % 2 == 0 ? blockRe.data() : blockIm.data();
+                for (size_t c = 0; c < images.cols; ++c) {
+                    plane[c * width + j / 2] = row[c];
+                }
+            }
+            executeSplitFFT(plan, blockRe.data(), blockIm.data(), width);
+
+            // X[k] = (Z[k] + conj(Z[N-k])) / 2 and Y[k] = (Z[k] - conj(Z[N-k])) / 2i
+            for (size_t j = 0; j < imageCount; j += 2) {
+                bool hasPair = j + 1 < imageCount;
+                complex<T>* firstOut = halfSpectra[first + j].row(r);
+                complex<T>* secondOut = hasPair ? halfSpectra[first + j + 1].row(r) : nullptr;
+                size_t lane = j / 2;
+                for (size_t k = 0; k < halfCols; ++k) {
+                    size_t mirror = (cols - k) % cols;
+                    T a = blockRe[k * width + lane], b = blockIm[k * width + lane];
+                    T c = blockRe[mirror * width + lane], d = blockIm[mirror * width + lane];
+                    firstOut[k] = complex<T>(T(0.5) * (a + c), T(0.5) * (b - d));
+                    if (hasPair) {
+                        secondOut[k] = complex<T>(T(0.5) * (b + d), T(0.5) * (c - a));
+                    }
+                }
+            }
+        }
+    });
+    TRACE_END(rowPass);
+
+    TRACE_SCOPE("DFT2DRealFFT.columns");
+    splitFFTColumnsBatch(halfSpectra, false, pool);
+}
+
+// plan_many versions of DFT2DFFTW and DFT2DRealFFTW, a plan's worth of images at a time
+static void DFT2DFFTWBatch(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<double>> spectra) {
+    size_t rows = spectra.rows;
+    size_t cols = spectra.cols;
+    size_t size = rows * cols;
+    size_t batchSize = getFFTWBatchSize(images.count, size * sizeof(fftw_complex));
+    for (size_t first = 0; first < images.count; first += batchSize) {
+        size_t howMany = min(batchSize, images.count - first);
+        FFTWPlanEntry& plan = getFFTWBatchPlan({static_cast<int>(rows), static_cast<int>(cols), FFTW_FORWARD, true, FFTWTransform::Complex},
+                                               howMany, batchSize);
+        lock_guard<mutex> lock(plan.lock);
+
+        fill_n(&plan.complexIn[0][0], 2 * howMany * size, 0.0);
+        for (size_t i = 0; i < howMany; ++i) {
+            MatrixView<const uint8_t> image = images[first + i];
+            fftw_complex* in = plan.complexIn + i * size;
+            for (size_t r = 0; r < image.rows; ++r) {
+                for (size_t c = 0; c < image.cols; ++c) {
+                    in[r * cols + c][0] = image(r, c);
+                }
+            }
+        }
+        fftw_execute(plan.plan);
+
+        for (size_t i = 0; i < howMany; ++i) {
+            MatrixView<complex<double>> spectrum = spectra[first + i];
+            const fftw_complex* out = plan.complexOut + i * size;
+            for (size_t r = 0; r < rows; ++r) {
+                for (size_t c = 0; c < cols; ++c) {
+                    spectrum(r, c) = complex<double>(out[r * cols + c][0], out[r * cols + c][1]);
+                }
+            }
+        }
+    }
+}
+
+static void DFT2DRealFFTWBatch(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<double>> halfSpectra, size_t cols) {
+    size_t rows = halfSpectra.rows;
+    size_t halfCols = cols / 2 + 1;
+    size_t size = rows * cols;
+    size_t halfSize = rows * halfCols;
+    size_t batchSize = getFFTWBatchSize(images.count, size * sizeof(double) + halfSize * sizeof(fftw_complex));
+    for (size_t first = 0; first < images.count; first += batchSize) {
+        size_t howMany = min(batchSize, images.count - first);
+        FFTWPlanEntry& plan = getFFTWBatchPlan({static_cast<int>(rows), static_cast<int>(cols), FFTW_FORWARD, false, FFTWTransform::RealToComplex},
+                                               howMany, batchSize);
+        lock_guard<mutex> lock(plan.lock);
+
+        fill_n(plan.realData, howMany * size, 0.0);
+        for (size_t i = 0; i < howMany; ++i) {
+            MatrixView<const uint8_t> image = images[first + i];
+            for (size_t r = 0; r < image.rows; ++r) {
+                copy(image.row(r), image.row(r) + image.cols, plan.realData + i * size + r * cols);
+            }
+        }
+        fftw_execute(plan.plan);
+
+        for (size_t i = 0; i < howMany; ++i) {
+            MatrixView<complex<double>> halfSpectrum = halfSpectra[first + i];
+            const fftw_complex* out = plan.complexOut + i * halfSize;
+            for (size_t r = 0; r < rows; ++r) {
+                for (size_t c = 0; c < halfCols; ++c) {
+                    halfSpectrum(r, c) = complex<double>(out[r * halfCols + c][0], out[r * halfCols + c][1]);
+                }
+            }
+        }
+    }
+}
+
+// Pixel counts of a whole batch, plus the number of images
+static void traceBatchSize(MatrixBatchView<const uint8_t> images, size_t rows, size_t cols) {
+    TRACE_COUNTER("fft.batchImages", images.count);
+    traceTransformSize(images.count * images.rows, images.cols, images.count * rows, cols);
+}
+
+void DFT2DFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<double>> spectra, ThreadPool* pool, FFTBackend backend) {
+    TRACE_SCOPE("DFT2DFFT.batch");
+    traceBatchSize(images, spectra.rows, spectra.cols);
+    if (backend == FFTBackend::FFTW) {
+        DFT2DFFTWBatch(images, spectra);
+    } else if (isPowerOf2(spectra.rows) && isPowerOf2(spectra.cols)) {
+        complexFFT2DBatch(images, spectra, pool);
+    } else {
+        for (size_t i = 0; i < images.count; ++i) {
+            complexFFT2D(images[i], spectra[i], pool);
+        }
+    }
+}
+
+void DFT2DRealFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<double>> halfSpectra, size_t cols, ThreadPool* pool,
+                  FFTBackend backend) {
+    TRACE_SCOPE("DFT2DRealFFT.batch");
+    traceBatchSize(images, halfSpectra.rows, cols);
+    if (backend == FFTBackend::FFTW) {
+        DFT2DRealFFTWBatch(images, halfSpectra, cols);
+    } else if (isPowerOf2(halfSpectra.rows) && isPowerOf2(cols)) {
+        realFFT2DBatch(images, halfSpectra, cols, pool);
+    } else {
+        for (size_t i = 0; i < images.count; ++i) {
+            realFFT2D(images[i], halfSpectra[i], cols, pool);
+        }
+    }
+}
+
+void DFT2DFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<float>> spectra, ThreadPool* pool) {
+    TRACE_SCOPE("DFT2DFFT.batch");
+    traceBatchSize(images, spectra.rows, spectra.cols);
+    if (isPowerOf2(spectra.rows) && isPowerOf2(spectra.cols)) {
+        complexFFT2DBatch(images, spectra, pool);
+    } else {
+        for (size_t i = 0; i < images.count; ++i) {
+            complexFFT2DFloat(images[i], spectra[i], pool);
+        }
+    }
+}
+
+void DFT2DRealFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<float>> halfSpectra, size_t cols, ThreadPool* pool) {
+    TRACE_SCOPE("DFT2DRealFFT.batch");
+    traceBatchSize(images, halfSpectra.rows, cols);
+    if (isPowerOf2(halfSpectra.rows) && isPowerOf2(cols)) {
+        realFFT2DBatch(images, halfSpectra, cols, pool);
+    } else {
+        for (size_t i = 0; i < images.count; ++i) {
+            realFFT2DFloat(images[i], halfSpectra[i], cols, pool);
+        }
+    }
+}
+
+void fft2D(complex<double>* data, size_t rows, size_t cols, ThreadPool* pool) {
+    fft2DStrided(data, rows, cols, cols, pool);
+}
+
+static void ifft2DStrided(complex<double>* data, size_t rows, size_t cols, size_t rowStride, ThreadPool* pool) {
+    // ifft(x) = conj(fft(conj(x))) / N
+    double scale = 1.0 / static_cast<double>(rows * cols);
+    for (size_t r = 0; r < rows; ++r) {
+        complex<double>* row = data + r * rowStride;
+        for (size_t c = 0; c < cols; ++c) {
+            row[c] = conj(row[c]);
+        }
+    }
+    fft2DStrided(data, rows, cols, rowStride, pool);
+    for (size_t r = 0; r < rows; ++r) {
+        complex<double>* row = data + r * rowStride;
+        for (size_t c = 0; c < cols; ++c) {
+            row[c] = conj(row[c]) * scale;
+        }
+    }
+}
+
+void ifft2D(complex<double>* data, size_t rows, size_t cols, ThreadPool* pool) {
+    ifft2DStrided(data, rows, cols, cols, pool);
+}
+
+void executeFFTColumns(const FFTPlan& plan, complex<double>* data, size_t rowStride, size_t colBegin, size_t colEnd) {
+    // Columns are transformed a block at a time, so every butterfly works on whole cache lines
+    // of two rows instead of striding down a single column
+    const size_t blockWidth = columnBlockWidth;
+    size_t n = plan.size;
+
+    if (plan.algorithm != FFTAlgorithm::Radix2) {
+        // Other sizes copy a block out row by row into contiguous columns, transform those and copy back
+        thread_local vector<complex<double>> columns;
+        columns.resize(blockWidth * n);
+        for (size_t blockBegin = colBegin; blockBegin < colEnd; blockBegin += blockWidth) {
+            size_t width = min(blockWidth, colEnd - blockBegin);
+            for (size_t i = 0; i < n; ++i) {
+                const complex<double>* row = data + i * rowStride + blockBegin;
+                for (size_t j = 0; j < width; ++j) {
+                    columns[j * n + i] = row[j];
+                }
+            }
+            for (size_t j = 0; j < width; ++j) {
+                executeFFT(plan, columns.data() + j * n);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                complex<double>* row = data + i * rowStride + blockBegin;
+                for (size_t j = 0; j < width; ++j) {
+                    row[j] = columns[j * n + i];
+                }
+            }
+        }
+        return;
+    }
+
+    for (size_t blockBegin = colBegin; blockBegin < colEnd; blockBegin += blockWidth) {
+        size_t width = min(blockWidth, colEnd - blockBegin);
+        complex<double>* block = data + blockBegin;
+
+        // Reorder rows of the block for the bottom-up solution
+        for (size_t i = 0; i < n; ++i) {
+            size_t j = plan.bitReversed[i];
+            if (i < j) {
+                swap_ranges(block + i * rowStride, block + i * rowStride + width, block + j * rowStride);
+            }
+        }
+
+        for (size_t stageSize = 2; stageSize <= n; stageSize *= 2) {
+            size_t halfSize = stageSize / 2;
+            size_t twiddleStride = n / stageSize;
+
+            for (size_t start = 0; start < n; start += stageSize) {
+                for (size_t pair = 0; pair < halfSize; ++pair) {
+                    complex<double> twiddle = plan.twiddles[pair * twiddleStride];
+                    complex<double>* top = block + (start + pair) * rowStride;
+                    complex<double>* bottom = top + halfSize * rowStride;
+
+                    for (size_t j = 0; j < width; ++j) {
+                        complex<double> t = top[j];
+                        complex<double> b = twiddle * bottom[j];
+                        top[j] = t + b;
+                        bottom[j] = t - b;
+                    }
+                }
+            }
+        }
+    }
+}
+
+complex<double> getHalfSpectrumBin(const vector<vector<complex<double>>>& halfSpectrum, size_t cols, size_t k, size_t l) {
+    if (l < halfSpectrum[0].size()) {
+        return halfSpectrum[k][l];
+    }
+    size_t rows = halfSpectrum.size();
+    return conj(halfSpectrum[(rows - k) % rows][cols - l]);
+}
+
+// Visit a rows x cols index space tile by tile so both sides of a transpose stay in cache
+template <typename Body>
+static void forEachTransposeTile(size_t rows, size_t cols, Body body) {
+    const size_t tile = 32;
+    for (size_t i0 = 0; i0 < rows; i0 += tile) {
+        for (size_t j0 = 0; j0 < cols; j0 += tile) {
+            size_t iEnd = min(i0 + tile, rows);
+            size_t jEnd = min(j0 + tile, cols);
+            for (size_t i = i0; i < iEnd; ++i) {
+                for (size_t j = j0; j < jEnd; ++j) {
+                    body(i, j);
+                }
+            }
+        }
+    }
+}
+
+vector<vector<complex<double>>> transposeMatrix(const vector<vector<complex<double>>>& matrix) {
+    size_t rows = matrix.size();
+    size_t cols = matrix[0].size();
+    
+    // Create a new matrix with transposed dimensions
+    vector<vector<complex<double>>> transposed(cols, vector<complex<double>>(rows));
+    forEachTransposeTile(rows, cols, [&](size_t i, size_t j) { transposed[j][i] = matrix[i][j]; });
+    return transposed;
+}
+
+void transposeMatrix(MatrixView<const complex<double>> matrix, MatrixView<complex<double>> transposed) {
+    forEachTransposeTile(matrix.rows, matrix.cols, [&](size_t i, size_t j) { transposed(j, i) = matrix(i, j); });
+}
+
+
+
+size_t getTransformSize(size_t currentSize, FFTPadding padding) {
+    return padding == FFTPadding::PowerOf2 ? getNextPowerOf2(currentSize) : currentSize;
+}
+
+// Split size into radices for the mixed-radix passes: 4s first, then 2, 3, 5 and any other primes.
+// Returns false if a prime factor is too large for a direct butterfly.
+static bool factorizeSize(size_t size, vector<size_t>& factors) {
+    size_t remaining = size;
+    size_t radix = 4;
+    while (remaining > 1) {
+        while (remaining % radix != 0) {
+            if (radix == 4) {
+                radix = 2;
+            } else if (radix == 2) {
+                radix = 3;
+            } else {
+                radix += 2;
+            }
+            if (radix * radix > remaining) {
+                radix = remaining;
+            }
+        }
+        if (radix > maxDirectRadix) {
+            return false;
+        }
+        remaining /= radix;
+        factors.push_back(radix);
+        factors.push_back(remaining);
+    }
+    return true;
+}
+
+FFTPlan::FFTPlan(size_t size) : size(size) {
+    bool powerOf2 = size > 0 && (size & (size - 1)) == 0;
+    if (powerOf2) {
+        algorithm = FFTAlgorithm::Radix2;
+    } else if (size > 1 && factorizeSize(size, factors)) {
+        algorithm = FFTAlgorithm::MixedRadix;
+    } else if (size > 1) {
+        algorithm = FFTAlgorithm::Bluestein;
+        factors.clear();
+    }
+
+    // Each twiddle is computed directly rather than by repeated multiplication, so long transforms keep full accuracy.
+    // Radix-2 only needs the first half; mixed-radix butterflies index the whole circle.
+    size_t twiddleCount = algorithm == FFTAlgorithm::MixedRadix ? size : size / 2;
+    twiddles.resize(twiddleCount);
+    for (size_t k = 0; k < twiddleCount; ++k) {
+        twiddles[k] = polar(1.0, -2.0 * numbers::pi * static_cast<double>(k) / static_cast<double>(size));
+    }
+
+    if (algorithm == FFTAlgorithm::Radix2) {
+        int bits = 0;
+        while ((size_t(1) << bits) < size) {
+            ++bits;
+        }
+        bitReversed.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            uint32_t rev = 0;
+            for (int b = 0; b < bits; ++b) {
+                rev |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            bitReversed[i] = rev;
+        }
+    } else if (algorithm == FFTAlgorithm::Bluestein) {
+        buildBluesteinTables(*this);
+    }
+}
+
+const FFTPlan& getFFTPlan(size_t size) {
+    static mutex planMutex;
+    static map<size_t, unique_ptr<FFTPlan>> plans;
+
+    {
+        lock_guard<mutex> lock(planMutex);
+        auto found = plans.find(size);
+        if (found != plans.end()) {
+            return *found->second;
+        }
+    }
+
+    // Built outside the lock: a Bluestein plan asks for its power-of-two plan while it is being built
+    auto plan = make_unique<FFTPlan>(size);
+    lock_guard<mutex> lock(planMutex);
+    auto inserted = plans.emplace(size, move(plan));
+    return *inserted.first->second;
+}
+
+void executeFFT(const FFTPlan& plan, complex<double>* data) {
+    if (plan.algorithm == FFTAlgorithm::MixedRadix) {
+        executeMixedRadixFFT(plan, data);
+        return;
+    }
+    if (plan.algorithm == FFTAlgorithm::Bluestein) {
+        executeBluesteinFFT(plan, data);
+        return;
+    }
+
+    size_t n = plan.size;
+
+    // Reorder for the bottom-up solution
+    for (size_t i = 0; i < n; ++i) {
+        size_t j = plan.bitReversed[i];
+        if (i < j) {
+            swap(data[i], data[j]);
+        }
+    }
+
+    // Outer loop over stages (each stage doubles the butterfly size)
+    for (size_t stageSize = 2; stageSize <= n; stageSize *= 2) {
+        size_t halfSize = stageSize / 2;
+        size_t twiddleStride = n / stageSize;
+
+        // Loop over each butterfly block in the current stage
+        for (size_t start = 0; start < n; start += stageSize) {
+            for (size_t pair = 0; pair < halfSize; ++pair) {
+                size_t topIndex = start + pair;
+                size_t bottomIndex = topIndex + halfSize;
+
+                complex<double> top = data[topIndex];
+                complex<double> bottom = plan.twiddles[pair * twiddleStride] * data[bottomIndex];
+
+                data[topIndex] = top + bottom;
+                data[bottomIndex] = top - bottom;
+            }
+        }
+    }
+}
+
+vector<complex<double>> FFT(vector<complex<double>>& input, FFTPadding padding) {
+    TRACE_SCOPE("FFT");
+    // Pad to the next power of two by default; native sizes go through the mixed-radix path
+    const FFTPlan& plan = getFFTPlan(getTransformSize(input.size(), padding));
+    TRACE_COUNTER("fft1D.paddingPoints", plan.size - input.size());
+
+    // Copy over initial values to the zero padded output and transform it in place
+    vector<complex<double>> paddedInput(plan.size, 0);
+    copy(input.begin(), input.end(), paddedInput.begin());
+    executeFFT(plan, paddedInput.data());
+
+    return paddedInput;
+}
+
+vector<complex<float>> FFT(vector<complex<float>>& input, FFTPadding padding) {
+    TRACE_SCOPE("FFT");
+    size_t n = getTransformSize(input.size(), padding);
+    TRACE_COUNTER("fft1D.paddingPoints", n - input.size());
+
+    vector<float> re(n, 0.0f), im(n, 0.0f);
+    for (size_t i = 0; i < input.size(); ++i) {
+        re[i] = input[i].real();
+        im[i] = input[i].imag();
+    }
+    splitFFTRow(SplitAxis<float>(n), re.data(), im.data());
+
+    vector<complex<float>> output(n);
+    for (size_t i = 0; i < n; ++i) {
+        output[i] = complex<float>(re[i], im[i]);
+    }
+    return output;
+}
+
+
+void reorderInput(vector<complex<double>>& input)   {
+    for (int i = 0; i < input.size(); ++i) {
+        int j = getBitReversedIndex(i, input.size()); // Function to calculate bit-reversed index
+        if (i < j) {
+            swap(input[i], input[j]);
+        }
+    }
+}
+
+int getBitReversedIndex(int index, int listSize) {
+    int rev = 0;
+    int bits = static_cast<int>(log2(listSize)); // Number of bits in listSize (assuming listSize is a power of 2)
+
+    for (int i = 0; i < bits; i++) {
+        // Shift rev left to make space for the next bit
+        rev = (rev << 1) | (index & 1); // Add the least significant bit of index to rev
+        index >>= 1; // Shift index right to get the next bit in the next iteration
+    }
+
+    return rev;
+}
+
+// exp(-2*pi*i*j/n) for j in [0, n). Exponents are reduced mod n before the lookup, so every
+// term uses an exactly reduced angle no matter how large k * r gets.
+static vector<complex<double>> makeDFTTable(size_t n) {
+    vector<complex<double>> table(n);
+    for (size_t j = 0; j < n; ++j) {
+        double angle = -2.0 * numbers::pi * static_cast<double>(j) / static_cast<double>(n);
+        table[j] = complex<double>(cos(angle), sin(angle));
+    }
+    return table;
+}
+
+// Row pass of the separable DFT for the requested columns ls: partial[r * ls.size() + i] is the
+// 1D DFT of input row r at bin ls[i]. Black pixels are gathered first, so sparse drawings cost
+// O(rows * black pixels per row * ls.size()).
+template <typename Input>
+static vector<complex<double>> directRowPass(const Input& input, const vector<size_t>& ls) {
+    size_t rows = getInputRows(input);
+    size_t cols = getInputCols(input);
+    vector<complex<double>> table = makeDFTTable(cols);
+    vector<complex<double>> partial(rows * ls.size(), 0);
+    vector<size_t> inkColumns;
+    vector<double> inkValues;
+    for (size_t r = 0; r < rows; ++r) {
+        const auto* row = getInputRow(input, r);
+        inkColumns.clear();
+        inkValues.clear();
+        for (size_t c = 0; c < cols; ++c) {
+            if (row[c] != 0) {
+                inkColumns.push_back(c);
+                inkValues.push_back(row[c]);
+            }
+        }
+        for (size_t i = 0; i < ls.size(); ++i) {
+            complex<double> sum = 0;
+            for (size_t j = 0; j < inkColumns.size(); ++j) {
+                sum += inkValues[j] * table[(ls[i] * inkColumns[j]) % cols];
+            }
+            partial[r * ls.size() + i] = sum;
+        }
+    }
+    return partial;
+}
+
+template <typename Input>
+static void directDFT2D(const Input& input, MatrixView<complex<double>> spectrum) {
+    size_t rows = getInputRows(input);
+    size_t cols = getInputCols(input);
+    vector<size_t> ls(cols);
+    for (size_t l = 0; l < cols; ++l) {
+        ls[l] = l;
+    }
+    vector<complex<double>> partial = directRowPass(input, ls);
+
+    // Column pass: X[k][l] = sum_r partial[r][l] * exp(-2*pi*i*k*r/rows), the exponent stepped mod rows
+    vector<complex<double>> table = makeDFTTable(rows);
+    for (size_t k = 0; k < rows; ++k) {
+        complex<double>* out = spectrum.row(k);
+        fill_n(out, cols, 0);
+        size_t exponent = 0;
+        for (size_t r = 0; r < rows; ++r) {
+            complex<double> w = table[exponent];
+            const complex<double>* source = partial.data() + r * cols;
+            for (size_t l = 0; l < cols; ++l) {
+                out[l] += source[l] * w;
+            }
+            exponent += k;
+            if (exponent >= rows) {
+                exponent -= rows;
+            }
+        }
+    }
+}
+
+template <typename Input>
+static vector<complex<double>> directDFT2DBins(const Input& input, const vector<SpectrumBin>& bins) {
+    size_t rows = getInputRows(input);
+    size_t cols = getInputCols(input);
+
+    // Row pass only for the distinct columns asked for
+    vector<size_t> ls;
+    for (const SpectrumBin& bin : bins) {
+        ls.push_back(bin.l % cols);
+    }
+    sort(ls.begin(), ls.end());
+    ls.erase(unique(ls.begin(), ls.end()), ls.end());
+    vector<complex<double>> partial = directRowPass(input, ls);
+
+    vector<complex<double>> table = makeDFTTable(rows);
+    vector<complex<double>> values(bins.size(), 0);
+    for (size_t b = 0; b < bins.size(); ++b) {
+        size_t i = lower_bound(ls.begin(), ls.end(), bins[b].l % cols) - ls.begin();
+        size_t k = bins[b].k % rows;
+        complex<double> sum = 0;
+        for (size_t r = 0; r < rows; ++r) {
+            sum += partial[r * ls.size() + i] * table[(k * r) % rows];
+        }
+        values[b] = sum;
+    }
+    return values;
+}
+
+vector<vector<complex<double>>> DFT2D(vector<vector<int>>& matrix)   {
+    TRACE_SCOPE("DFT2D");
+    size_t rows = matrix.size();
+    size_t cols = matrix[0].size();
+    vector<complex<double>> grid(rows * cols);
+    directDFT2D(matrix, MatrixView<complex<double>>(grid.data(), rows, cols));
+    return toNestedMatrix(grid, rows, cols);
+}
+
+void DFT2D(MatrixView<const uint8_t> image, MatrixView<complex<double>> spectrum) {
+    TRACE_SCOPE("DFT2D");
+    directDFT2D(image, spectrum);
+}
+
+vector<complex<double>> DFT2DBins(vector<vector<int>>& matrix, const vector<SpectrumBin>& bins) {
+    TRACE_SCOPE("DFT2DBins");
+    return directDFT2DBins(matrix, bins);
+}
+
+vector<complex<double>> DFT2DBins(MatrixView<const uint8_t> image, const vector<SpectrumBin>& bins) {
+    TRACE_SCOPE("DFT2DBins");
+    return directDFT2DBins(image, bins);
+}
+
+complex<double> calculateDFT2D(vector<vector<int>>& matrix, size_t k, size_t l)    {
+    complex<double> dftSum = 0;
+    for(size_t r = 0; r < matrix.size(); ++r)   {
+        for(size_t c = 0; c < matrix[0].size(); ++c)    {
+            dftSum += getDftStep(matrix, r, c, k, l);
+        }
+    }
+    return dftSum;
+}
+
+complex<double> getDftStep(vector<vector<int>>& matrix, size_t r, size_t c, size_t k, size_t l) {
+    size_t M = matrix.size();
+    size_t N = matrix[0].size();
+    //Both terms belong inside the -2*pi factor; reducing the products first keeps the angle exact
+    double angle = -2.0 * numbers::pi * (static_cast<double>((k * r) % M) / M + static_cast<double>((l * c) % N) / N);
+    return static_cast<double>(matrix[r][c]) * exp(imaginary_i * angle);
+}
+
+void performIFFT(const vector<vector<complex<double>>>& fft_output, vector<vector<complex<double>>>& ifft_result, ThreadPool* pool) {
+    TRACE_SCOPE("performIFFT");
+    int rows = fft_output.size();
+    int cols = fft_output[0].size();
+    int N = rows * cols;
+
+    // With a pool, the grid is inverted by the in-house transform, split across the pool
+    if (pool) {
+        vector<complex<double>> grid(N);
+        for (int r = 0; r < rows; ++r) {
+            copy(fft_output[r].begin(), fft_output[r].end(), grid.begin() + static_cast<size_t>(r) * cols);
+        }
+        ifft2D(grid.data(), rows, cols, pool);
+        ifft_result = toNestedMatrix(grid, rows, cols);
+        return;
+    }
+
+    // Cached plan and buffers for this size; only the copies in and out happen per call
+    FFTWPlanEntry& plan = getFFTWPlan({rows, cols, FFTW_BACKWARD, false, FFTWTransform::Complex});
+    lock_guard<mutex> lock(plan.lock);
+    fftw_complex *in = plan.complexIn;
+    fftw_complex *out = plan.complexOut;
+
+    // Convert 2D vector to 1D fftw_complex array
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            int idx = r * cols + c;
+            in[idx][0] = fft_output[r][c].real();
+            in[idx][1] = fft_output[r][c].imag();
+        }
+    }
+
+    // Execute IFFT
+    fftw_execute(plan.plan);
+
+    // Convert 1D fftw_complex array back to 2D vector and normalize
+    ifft_result.resize(rows, vector<complex<double>>(cols));
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            int idx = r * cols + c;
+            ifft_result[r][c] = complex<double>(out[idx][0] / N, out[idx][1] / N);  // Normalize
+        }
+    }
+}
+
+void performIFFT(MatrixView<const complex<double>> spectrum, MatrixView<complex<double>> result, ThreadPool* pool) {
+    TRACE_SCOPE("performIFFT");
+    if (result.data != spectrum.data) {
+        for (size_t r = 0; r < spectrum.rows; ++r) {
+            copy(spectrum.row(r), spectrum.row(r) + spectrum.cols, result.row(r));
+        }
+    }
+    ifft2DStrided(result.data, result.rows, result.cols, result.stride, pool);
+}
+
+void performIFFT(MatrixBatchView<const complex<double>> spectra, MatrixBatchView<complex<double>> results, ThreadPool* pool, FFTBackend backend) {
+    TRACE_SCOPE("performIFFT.batch");
+    size_t rows = spectra.rows;
+    size_t cols = spectra.cols;
+    if (backend == FFTBackend::FFTW) {
+        size_t size = rows * cols;
+        size_t batchSize = getFFTWBatchSize(spectra.count, 2 * size * sizeof(fftw_complex));
+        double scale = 1.0 / static_cast<double>(size);
+        for (size_t first = 0; first < spectra.count; first += batchSize) {
+            size_t howMany = min(batchSize, spectra.count - first);
+            FFTWPlanEntry& plan = getFFTWBatchPlan({static_cast<int>(rows), static_cast<int>(cols), FFTW_BACKWARD, false, FFTWTransform::Complex},
+                                                   howMany, batchSize);
+            lock_guard<mutex> lock(plan.lock);
+            for (size_t i = 0; i < howMany; ++i) {
+                MatrixView<const complex<double>> spectrum = spectra[first + i];
+                fftw_complex* in = plan.complexIn + i * size;
+                for (size_t r = 0; r < rows; ++r) {
+                    for (size_t c = 0; c < cols; ++c) {
+                        in[r * cols + c][0] = spectrum(r, c).real();
+                        in[r * cols + c][1] = spectrum(r, c).imag();
+                    }
+                }
+            }
+            fftw_execute(plan.plan);
+            for (size_t i = 0; i < howMany; ++i) {
+                MatrixView<complex<double>> result = results[first + i];
+                const fftw_complex* out = plan.complexOut + i * size;
+                for (size_t r = 0; r < rows; ++r) {
+                    for (size_t c = 0; c < cols; ++c) {
+                        result(r, c) = complex<double>(out[r * cols + c][0] * scale, out[r * cols + c][1] * scale);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    if (results.data != spectra.data) {
+        for (size_t i = 0; i < spectra.count; ++i) {
+            for (size_t r = 0; r < rows; ++r) {
+                copy(spectra[i].row(r), spectra[i].row(r) + cols, results[i].row(r));
+            }
+        }
+    }
+    if (isPowerOf2(rows) && isPowerOf2(cols)) {
+        splitFFTRowsBatch(results, true, pool);
+        splitFFTColumnsBatch(results, true, pool);
+        return;
+    }
+    for (size_t i = 0; i < results.count; ++i) {
+        ifft2DStrided(results[i].data, rows, cols, results.stride, pool);
+    }
+}
+
+void performIFFTReal(const vector<vector<complex<double>>>& halfSpectrum, size_t cols, vector<vector<double>>& ifft_result) {
+    TRACE_SCOPE("performIFFTReal");
+    int rows = halfSpectrum.size();
+    int halfCols = halfSpectrum[0].size();
+    int N = rows * static_cast<int>(cols);
+
+    // Half-spectrum input and real output, no full complex grid
+    FFTWPlanEntry& plan = getFFTWPlan({rows, static_cast<int>(cols), FFTW_BACKWARD, false, FFTWTransform::ComplexToReal});
+    lock_guard<mutex> lock(plan.lock);
+    fftw_complex *in = plan.complexIn;
+    double *out = plan.realData;
+
+    // Complex-to-real plans overwrite their input, so it is refilled on every call
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < halfCols; ++c) {
+            int idx = r * halfCols + c;
+            in[idx][0] = halfSpectrum[r][c].real();
+            in[idx][1] = halfSpectrum[r][c].imag();
+        }
+    }
+
+    fftw_execute(plan.plan);
+
+    // Copy back and normalize
+    ifft_result.assign(rows, vector<double>(cols));
+    for (int r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            ifft_result[r][c] = out[r * cols + c] / N;
+        }
+    }
+}
+
+// Describe bin (k, l) of an M x N spectrum as a frequency component
+static FrequencyComponent makeFrequencyComponent(complex<double> value, int k, int l, int M, int N) {
+    FrequencyComponent component;
+    component.k = k;
+    component.l = l;
+    component.amplitude = abs(value);
+    component.frequencyX = 2.0 * numbers::pi * k / M;
+    component.frequencyY = 2.0 * numbers::pi * l / N;
+    component.phase = arg(value);
+    return component;
+}
+
+// Shape and bins of a spectrum, either nested or a view
+static int getSpectrumRows(const vector<vector<complex<double>>>& spectrum) { return spectrum.size(); }
+static int getSpectrumCols(const vector<vector<complex<double>>>& spectrum) { return spectrum[0].size(); }
+static complex<double> getSpectrumBin(const vector<vector<complex<double>>>& spectrum, int k, int l) { return spectrum[k][l]; }
+static int getSpectrumRows(MatrixView<const complex<double>> spectrum) { return spectrum.rows; }
+static int getSpectrumCols(MatrixView<const complex<double>> spectrum) { return spectrum.cols; }
+static complex<double> getSpectrumBin(MatrixView<const complex<double>> spectrum, int k, int l) { return spectrum(k, l); }
+static int getSpectrumRows(MatrixView<const complex<float>> spectrum) { return spectrum.rows; }
+static int getSpectrumCols(MatrixView<const complex<float>> spectrum) { return spectrum.cols; }
+static complex<double> getSpectrumBin(MatrixView<const complex<float>> spectrum, int k, int l) { return spectrum(k, l); }
+
+template <typename Spectrum>
+static vector<FrequencyComponent> extractDominant(const Spectrum& spectrum, double threshold, size_t fullCols) {
+    int rows = getSpectrumRows(spectrum);
+    int cols = getSpectrumCols(spectrum);
+    int M = rows;
+    int N = fullCols > 0 ? static_cast<int>(fullCols) : cols;
+
+    vector<FrequencyComponent> components;
+    for (int k = 0; k < rows; ++k) {
+        for (int l = 0; l < cols; ++l) {
+            complex<double> value = getSpectrumBin(spectrum, k, l);
+            if (abs(value) <= threshold) {
+                continue;
+            }
+            components.push_back(makeFrequencyComponent(value, k, l, M, N));
+
+            // Bins 0 and N/2 are their own mirror
+            bool selfConjugate = l == 0 || 2 * l == N;
+            if (fullCols > 0 && !selfConjugate) {
+                components.push_back(makeFrequencyComponent(conj(value), (M - k) % M, N - l, M, N));
+            }
+        }
+    }
+    return components;
+}
+
+vector<FrequencyComponent> extractDominantFrequencies(const vector<vector<complex<double>>>& spectrum, double threshold, size_t fullCols) {
+    return extractDominant(spectrum, threshold, fullCols);
+}
+
+vector<FrequencyComponent> extractDominantFrequencies(MatrixView<const complex<double>> spectrum, double threshold, size_t fullCols) {
+    return extractDominant(spectrum, threshold, fullCols);
+}
+
+vector<FrequencyComponent> extractDominantFrequencies(MatrixView<const complex<float>> spectrum, double threshold, size_t fullCols) {
+    return extractDominant(spectrum, threshold, fullCols);
+}
+
+// Higher power first, then earlier row-major position so the order is deterministic
+template <typename Bin>
+static bool isStrongerBin(const Bin& a, const Bin& b) {
+    if (a.power != b.power) {
+        return a.power > b.power;
+    }
+    return a.k != b.k ? a.k < b.k : a.l < b.l;
+}
+
+TopFrequencyCollector::TopFrequencyCollector(size_t count, size_t rows, size_t fullCols, bool collapseConjugates)
+    : count(count), rows(rows), fullCols(fullCols), collapseConjugates(collapseConjugates) {
+    heap.reserve(count + 1);
+}
+
+void TopFrequencyCollector::offer(const RankedBin& bin) {
+    if (heap.size() < count) {
+        heap.push_back(bin);
+        push_heap(heap.begin(), heap.end(), isStrongerBin<RankedBin>);
+    } else if (count > 0 && isStrongerBin(bin, heap.front())) {
+        pop_heap(heap.begin(), heap.end(), isStrongerBin<RankedBin>);
+        heap.back() = bin;
+        push_heap(heap.begin(), heap.end(), isStrongerBin<RankedBin>);
+    }
+}
+
+template <typename Spectrum>
+void TopFrequencyCollector::offerRows(const Spectrum& strip, size_t firstRow) {
+    int stripRows = getSpectrumRows(strip);
+    if (stripRows == 0) {
+        return;
+    }
+    int cols = getSpectrumCols(strip);
+    stripCols = cols;
+    int M = rows;
+    int N = fullCols > 0 ? static_cast<int>(fullCols) : cols;
+    bool halfLayout = fullCols > 0;
+
+    for (int r = 0; r < stripRows; ++r) {
+        int k = firstRow + r;
+        int mirrorK = (M - k) % M;
+        for (int l = 0; l < cols; ++l) {
+            complex<double> value = getSpectrumBin(strip, r, l);
+            double power = norm(value);
+            int mirrorL = (N - l) % N;
+            // A half-spectrum only stores the mirror of bins in columns 0 and N/2
+            bool mirrorStored = !halfLayout || mirrorL == l;
+            bool selfConjugate = mirrorK == k && mirrorL == l;
+
+            if (collapseConjugates) {
+                // Keep the first of each stored pair in row-major order
+                if (mirrorStored && !selfConjugate && mirrorK * N + mirrorL < k * N + l) {
+                    continue;
+                }
+                offer({power, k, l, value, !selfConjugate});
+            } else {
+                offer({power, k, l, value, false});
+                if (!mirrorStored) {
+                    offer({power, mirrorK, mirrorL, conj(value), false});
+                }
+            }
+        }
+    }
+}
+
+void TopFrequencyCollector::addRows(MatrixView<const complex<double>> strip, size_t firstRow) {
+    offerRows(strip, firstRow);
+}
+
+void TopFrequencyCollector::addRows(MatrixView<const complex<float>> strip, size_t firstRow) {
+    offerRows(strip, firstRow);
+}
+
+void TopFrequencyCollector::addRows(const vector<vector<complex<double>>>& strip, size_t firstRow) {
+    offerRows(strip, firstRow);
+}
+
+vector<FrequencyComponent> TopFrequencyCollector::finish() const {
+    vector<RankedBin> ranked = heap;
+    sort(ranked.begin(), ranked.end(), isStrongerBin<RankedBin>);
+    int N = fullCols > 0 ? fullCols : stripCols;
+    vector<FrequencyComponent> components;
+    components.reserve(ranked.size());
+    for (const RankedBin& bin : ranked) {
+        FrequencyComponent component = makeFrequencyComponent(bin.value, bin.k, bin.l, rows, N);
+        component.hasConjugate = bin.hasConjugate;
+        components.push_back(component);
+    }
+    return components;
+}
+
+template <typename Spectrum>
+static vector<FrequencyComponent> extractTop(const Spectrum& spectrum, size_t count, size_t fullCols, bool collapseConjugates) {
+    TopFrequencyCollector collector(count, getSpectrumRows(spectrum), fullCols, collapseConjugates);
+    collector.addRows(spectrum, 0);
+    return collector.finish();
+}
+
+vector<FrequencyComponent> extractTopFrequencies(const vector<vector<complex<double>>>& spectrum, size_t count, size_t fullCols, bool collapseConjugates) {
+    return extractTop(spectrum, count, fullCols, collapseConjugates);
+}
+
+vector<FrequencyComponent> extractTopFrequencies(MatrixView<const complex<double>> spectrum, size_t count, size_t fullCols, bool collapseConjugates) {
+    return extractTop(spectrum, count, fullCols, collapseConjugates);
+}
+
+vector<FrequencyComponent> extractTopFrequencies(MatrixView<const complex<float>> spectrum, size_t count, size_t fullCols, bool collapseConjugates) {
+    return extractTop(spectrum, count, fullCols, collapseConjugates);
+}
+
+void printFrequencyComponent(ostream& out, const FrequencyComponent& component) {
+    out << "Amplitude: " << component.amplitude << (component.hasConjugate ? " (with conjugate)" : "")
+        << " | cos(" << component.frequencyX << " * x + " << component.frequencyY << " * y + " << component.phase << ")\n";
+}
+
+void printHalfSpectrum(const vector<vector<complex<double>>>& halfSpectrum, size_t cols) {
+    for (size_t r = 0; r < halfSpectrum.size(); ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            complex<double> elem = getHalfSpectrumBin(halfSpectrum, cols, r, c);
+            cout << "(" << elem.real() << ", " << elem.imag() << "i) ";
+        }
+        cout << endl;
+    }
+}
+
+void printComplexMatrix(const vector<vector<complex<double>>>& matrix) {
+    for (const auto& row : matrix) {
+        for (const auto& elem : row) {
+            cout << "(" << elem.real() << ", " << elem.imag() << "i) ";
+        }
+        cout << endl;
+    }
 }
\ No newline at end of file
@@ -1,38 +1,289 @@
-#include <iostream>
-#include <vector>
-#include <complex>
-#include <numbers>
-#include <fftw3.h>
-
-using namespace std;
-
-const complex<double> imaginary_i(0.0, 1.0);
-
-// 2D Discrete Fourier Transform using FFT
-vector<vector<complex<double>>> DFT2D(vector<vector<int>>& matrix);
-
-// 2D FFT-based DFT for faster transformation
-vector<vector<complex<double>>> DFT2DFFT(vector<vector<int>>& matrix);
-
-// Helper function to calculate individual elements in the DFT matrix
-complex<double> calculateDFT2D(vector<vector<int>>& matrix, size_t k, size_t l);
-
-// Helper function to calculate each step in the DFT formula
-complex<double> getDftStep(vector<vector<int>>& matrix, size_t r, size_t c, size_t k, size_t l);
-
-// 1D FFT function for integer input with complex output and power-of-2 padding
-vector<complex<double>> FFT(vector<complex<double>>& input);
-
-// Helper functions for FFT
-void reorderInput(vector<complex<double>>& input); // Reorder input for FFT using bit-reversal
-int getBitReversedIndex(int index, int listSize);  // Bit reversal function for FFT reordering
-
-// Utility function to find the next power of 2 for padding
-int getNextPowerOf2(size_t currentSize);
-
-// Utility function to transpose a complex matrix (for 2D FFT)
-vector<vector<complex<double>>> transposeMatrix(const vector<vector<complex<double>>>& matrix);
-
-// Utility function to print a matrix of complex numbers for debugging
-void printComplexMatrix(const vector<vector<complex<double>>>& matrix);
-void performIFFT(const vector<vector<complex<double>>>& fft_output, vector<vector<complex<double>>>& ifft_result);
+#pragma once
+#include <iostream>
+#include <vector>
+#include <complex>
+#include <numbers>
+#include <fftw3.h>
+#include <cstdint>
+#include "thread_pool.h"
+#include "matrix.h"
+
+using namespace std;
+
+const complex<double> imaginary_i(0.0, 1.0);
+
+// Transform length used for an axis of n samples
+enum class FFTPadding {
+    PowerOf2,   // zero pad to getNextPowerOf2(n)
+    Native      // keep n, frequency bins line up with the canvas (mixed-radix / Bluestein)
+};
+
+// Which engine runs a forward 2D transform
+enum class FFTBackend {
+    InHouse,    // FFTPlan based FFT() path, can split work across a ThreadPool
+    FFTW        // cached FFTW plan (fftw_plan_cache.h), pool is ignored
+};
+
+// One (k, l) bin of a 2D spectrum
+struct SpectrumBin {
+    size_t k = 0;
+    size_t l = 0;
+};
+
+// Direct 2D DFT at the matrix's own size, no padding. Separable with exp(-2*pi*i*j/n) tables,
+// O(rows * cols * (rows + cols)), and zero pixels are skipped in the row pass. Meant as the
+// reference the FFT paths are checked against, and for small regions of interest.
+vector<vector<complex<double>>> DFT2D(vector<vector<int>>& matrix);
+// Into a spectrum view of the image's shape, e.g. for a block of a larger image
+void DFT2D(MatrixView<const uint8_t> image, MatrixView<complex<double>> spectrum);
+
+// Only the requested bins of DFT2D, in the order given (indices are taken mod the size).
+// Costs O(rows * cols * distinct l + rows * bins), so a few low frequencies of a large image are cheap.
+vector<complex<double>> DFT2DBins(vector<vector<int>>& matrix, const vector<SpectrumBin>& bins);
+vector<complex<double>> DFT2DBins(MatrixView<const uint8_t> image, const vector<SpectrumBin>& bins);
+
+// Arithmetic of the in-house 2D transforms
+enum class FFTPrecision {
+    Double,     // complex<double> throughout
+    Float       // split real/imaginary float planes (fft_simd.cpp): half the memory traffic and twice the
+                // SIMD width, ~1e-6 relative error, plenty for picking out visible frequencies
+};
+
+// 2D FFT-based DFT for faster transformation. With a pool, row and column batches run in parallel
+// and the result is bit for bit the same as the single-threaded transform. The FFTW backend always
+// runs in double precision, and so does FFTPrecision::Float unless both transform axes are powers of two.
+vector<vector<complex<double>>> DFT2DFFT(vector<vector<int>>& matrix, ThreadPool* pool = nullptr, FFTPadding padding = FFTPadding::PowerOf2,
+                                         FFTBackend backend = FFTBackend::InHouse, FFTPrecision precision = FFTPrecision::Double);
+
+// 2D FFT of a real (0/1) matrix returning only the non-redundant half-spectrum.
+// With M x N the transform size (see FFTPadding) the result has M rows and N / 2 + 1 columns;
+// the missing bins follow from X[k][l] = conj(X[(M - k) % M][N - l]).
+vector<vector<complex<double>>> DFT2DRealFFT(vector<vector<int>>& matrix, ThreadPool* pool = nullptr, FFTPadding padding = FFTPadding::PowerOf2,
+                                             FFTBackend backend = FFTBackend::InHouse, FFTPrecision precision = FFTPrecision::Double);
+
+// Overloads writing into caller-owned storage, typically an Arena-backed Matrix, instead of returning
+// nested vectors. The output shape is the transform size and must be at least the image size; the
+// rest is zero padding. halfSpectrum is transformRows x (cols / 2 + 1) for a cols-wide transform.
+// Neither allocates once plans and per-thread scratch exist for the size.
+void DFT2DFFT(MatrixView<const uint8_t> image, MatrixView<complex<double>> spectrum, ThreadPool* pool = nullptr,
+              FFTBackend backend = FFTBackend::InHouse);
+void DFT2DRealFFT(MatrixView<const uint8_t> image, MatrixView<complex<double>> halfSpectrum, size_t cols, ThreadPool* pool = nullptr,
+                  FFTBackend backend = FFTBackend::InHouse);
+// Single-precision versions, always in-house
+void DFT2DFFT(MatrixView<const uint8_t> image, MatrixView<complex<float>> spectrum, ThreadPool* pool = nullptr);
+void DFT2DRealFFT(MatrixView<const uint8_t> image, MatrixView<complex<float>> halfSpectrum, size_t cols, ThreadPool* pool = nullptr);
+
+// Batched versions of the view overloads for count same-size images, e.g. the skeletons of one
+// resolution stacked in a tall matrix. Every image and spectrum has the batch's shape and the
+// plans are looked up once. When both transform axes are powers of two the in-house transforms
+// interleave row r of up to 16 images (32 for the real transform, two per packed FFT) in one split
+// transform and the results match the per-image transforms to rounding; other sizes go through the
+// single-image transforms one image at a time. The FFTW backend runs plan_many over as many images
+// as fit its buffers at once.
+void DFT2DFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<double>> spectra, ThreadPool* pool = nullptr,
+              FFTBackend backend = FFTBackend::InHouse);
+void DFT2DRealFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<double>> halfSpectra, size_t cols, ThreadPool* pool = nullptr,
+                  FFTBackend backend = FFTBackend::InHouse);
+void DFT2DFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<float>> spectra, ThreadPool* pool = nullptr);
+void DFT2DRealFFT(MatrixBatchView<const uint8_t> images, MatrixBatchView<complex<float>> halfSpectra, size_t cols, ThreadPool* pool = nullptr);
+
+// Row pass of DFT2DRealFFT on its own: the cols-wide half-spectrum of every image row, written to
+// the first image.rows rows of halfRows. Lets a transform run a strip of rows at a time.
+void DFT2DRealFFTRows(MatrixView<const uint8_t> image, MatrixView<complex<double>> halfRows, size_t cols, ThreadPool* pool = nullptr);
+
+// Full-spectrum bin (k, l) read out of a half-spectrum of a transform that is cols wide
+complex<double> getHalfSpectrumBin(const vector<vector<complex<double>>>& halfSpectrum, size_t cols, size_t k, size_t l);
+
+// Single bin straight from the definition, O(rows * cols) per bin
+complex<double> calculateDFT2D(vector<vector<int>>& matrix, size_t k, size_t l);
+
+// Helper function to calculate each step in the DFT formula
+complex<double> getDftStep(vector<vector<int>>& matrix, size_t r, size_t c, size_t k, size_t l);
+
+// 1D FFT function for complex input with complex output, power-of-2 padding by default
+vector<complex<double>> FFT(vector<complex<double>>& input, FFTPadding padding = FFTPadding::PowerOf2);
+// Single precision; power-of-two sizes use the split kernels, others the double plans
+vector<complex<float>> FFT(vector<complex<float>>& input, FFTPadding padding = FFTPadding::PowerOf2);
+
+// Transform length for n samples under the given padding
+size_t getTransformSize(size_t currentSize, FFTPadding padding);
+
+enum class FFTAlgorithm {
+    Radix2,      // power-of-two sizes, in place with bit reversal
+    MixedRadix,  // radix 2/3/4/5 butterflies, plus direct butterflies for other primes up to maxDirectRadix
+    Bluestein    // sizes with a larger prime factor, as a power-of-two convolution
+};
+
+// Largest prime factor handled with a direct butterfly before falling back to Bluestein
+const size_t maxDirectRadix = 31;
+
+// Precomputed tables for one transform size, shared by every transform of that size
+struct FFTPlan {
+    size_t size = 0;
+    FFTAlgorithm algorithm = FFTAlgorithm::Radix2;
+    vector<complex<double>> twiddles;   // exp(-2*pi*i*k/size), first half only for Radix2
+    vector<uint32_t> bitReversed;       // Radix2: bit-reversal permutation of 0..size-1
+    vector<size_t> factors;             // MixedRadix: (radix, remaining length) pairs, outermost first
+
+    // Bluestein: chirp exp(-i*pi*n^2/size), FFT of its padded conjugate, and the power-of-two plan for the convolution
+    vector<complex<double>> chirp;
+    vector<complex<double>> chirpSpectrum;
+    const FFTPlan* convolutionPlan = nullptr;
+
+    explicit FFTPlan(size_t size);
+};
+
+// Cached plan for a size. Plans are built once and live for the rest of the process.
+const FFTPlan& getFFTPlan(size_t size);
+
+// In-place forward FFT of plan.size contiguous values. Radix2 never allocates; the other
+// algorithms reuse a per-thread scratch buffer.
+void executeFFT(const FFTPlan& plan, complex<double>* data);
+
+// Kernels behind executeFFT for non-power-of-two sizes (fft_mixed_radix.cpp)
+void executeMixedRadixFFT(const FFTPlan& plan, complex<double>* data);
+void executeBluesteinFFT(const FFTPlan& plan, complex<double>* data);
+void buildBluesteinTables(FFTPlan& plan);
+
+// Butterfly kernel behind the split-storage transforms, picked at runtime from the best one the CPU supports
+enum class FFTKernel {
+    Auto,
+    Scalar,
+    AVX2    // AVX2 + FMA, 8 floats or 4 doubles per register
+};
+
+// Force a split kernel (Auto re-detects). Returns false if the CPU doesn't support it. Safe to call
+// while transforms run on other threads: each executeSplitFFT call uses the kernel current when it
+// starts, and the kernels agree to rounding.
+bool setFFTKernel(FFTKernel kernel);
+FFTKernel getFFTKernel();
+
+// exp(-2*pi*i*j/size) for j in [0, size) as separate cos and sin tables
+template <typename T>
+struct SplitFFTPlan {
+    size_t size;
+    vector<T> cosTable;
+    vector<T> sinTable;
+
+    explicit SplitFFTPlan(size_t size);
+};
+
+// Cached split plan for a power-of-two size (float and double only)
+template <typename T>
+const SplitFFTPlan<T>& getSplitFFTPlan(size_t size);
+
+// In-place forward FFT of batch interleaved power-of-two transforms held as split real and imaginary
+// arrays: element i of transform j is at re[i * batch + j]. batch = 1 is a plain 1D transform; a
+// batch of a few columns keeps every stage vectorised. Uses a per-thread scratch buffer.
+template <typename T>
+void executeSplitFFT(const SplitFFTPlan<T>& plan, T* re, T* im, size_t batch = 1);
+
+// In-place 2D FFT of a contiguous row-major grid
+void fft2D(complex<double>* data, size_t rows, size_t cols, ThreadPool* pool = nullptr);
+
+// In-place normalized inverse of fft2D
+void ifft2D(complex<double>* data, size_t rows, size_t cols, ThreadPool* pool = nullptr);
+
+// In-place FFT down columns [colBegin, colEnd) of a row-major grid with plan.size rows.
+// Columns are processed in blocks, so no transpose is needed.
+void executeFFTColumns(const FFTPlan& plan, complex<double>* data, size_t rowStride, size_t colBegin, size_t colEnd);
+
+// Helper functions for FFT
+void reorderInput(vector<complex<double>>& input); // Reorder input for FFT using bit-reversal
+int getBitReversedIndex(int index, int listSize);  // Bit reversal function for FFT reordering
+
+// Utility function to find the next power of 2 for padding
+int getNextPowerOf2(size_t currentSize);
+
+// Utility function to transpose a complex matrix (for 2D FFT)
+vector<vector<complex<double>>> transposeMatrix(const vector<vector<complex<double>>>& matrix);
+// Into a cols x rows view
+void transposeMatrix(MatrixView<const complex<double>> matrix, MatrixView<complex<double>> transposed);
+
+// Utility function to print a matrix of complex numbers for debugging
+void printComplexMatrix(const vector<vector<complex<double>>>& matrix);
+// Normalized inverse 2D FFT through a cached FFTW plan. With a pool, the grid uses the in-house transform
+// split across the pool instead (matches FFTW to within rounding, ~1e-12 relative).
+void performIFFT(const vector<vector<complex<double>>>& fft_output, vector<vector<complex<double>>>& ifft_result, ThreadPool* pool = nullptr);
+// Same shape in and out, always the in-house transform; result may be the spectrum itself to invert in place
+void performIFFT(MatrixView<const complex<double>> spectrum, MatrixView<complex<double>> result, ThreadPool* pool = nullptr);
+
+// Normalized inverse of every spectrum of a batch; results may be the spectra themselves. In-house
+// transforms are batched as in the forward DFT2DFFT batch overload, FFTW runs plan_many.
+void performIFFT(MatrixBatchView<const complex<double>> spectra, MatrixBatchView<complex<double>> results, ThreadPool* pool = nullptr,
+                 FFTBackend backend = FFTBackend::InHouse);
+
+// Complex-to-real inverse of a half-spectrum produced by DFT2DRealFFT (cols is the full transform width)
+void performIFFTReal(const vector<vector<complex<double>>>& halfSpectrum, size_t cols, vector<vector<double>>& ifft_result);
+
+// One spectrum bin written as amplitude * cos(frequencyX * x + frequencyY * y + phase)
+struct FrequencyComponent {
+    int k = 0;
+    int l = 0;
+    double amplitude = 0;
+    double frequencyX = 0;
+    double frequencyY = 0;
+    double phase = 0;
+    bool hasConjugate = false;  // also stands for its conjugate mirror bin
+};
+
+// Every bin with amplitude above threshold, in row-major bin order.
+// fullCols == 0: spectrum is a full complex grid. Otherwise it is a half-spectrum of a
+// fullCols-wide transform, and the conjugate mirror of each stored bin is listed after it.
+vector<FrequencyComponent> extractDominantFrequencies(const vector<vector<complex<double>>>& spectrum, double threshold, size_t fullCols = 0);
+vector<FrequencyComponent> extractDominantFrequencies(MatrixView<const complex<double>> spectrum, double threshold, size_t fullCols = 0);
+vector<FrequencyComponent> extractDominantFrequencies(MatrixView<const complex<float>> spectrum, double threshold, size_t fullCols = 0);
+
+// The count strongest bins, strongest first (ties in row-major bin order). Ranking uses squared
+// magnitude, so only the winners pay for abs and arg. fullCols as in extractDominantFrequencies.
+// With collapseConjugates, a bin and its conjugate mirror (the same real cosine) count once and the
+// kept bin is flagged hasConjugate; otherwise mirrors are ranked as separate components.
+vector<FrequencyComponent> extractTopFrequencies(const vector<vector<complex<double>>>& spectrum, size_t count, size_t fullCols = 0,
+                                                 bool collapseConjugates = true);
+vector<FrequencyComponent> extractTopFrequencies(MatrixView<const complex<double>> spectrum, size_t count, size_t fullCols = 0,
+                                                 bool collapseConjugates = true);
+vector<FrequencyComponent> extractTopFrequencies(MatrixView<const complex<float>> spectrum, size_t count, size_t fullCols = 0,
+                                                 bool collapseConjugates = true);
+
+// Running extractTopFrequencies for a spectrum fed a row strip at a time, so a spectrum too large
+// to hold in memory can be ranked strip by strip. Every row fed once, in any order, gives the same
+// components as extractTopFrequencies over the whole spectrum with the same arguments.
+class TopFrequencyCollector {
+public:
+    // rows is the full spectrum height; fullCols and collapseConjugates as in extractTopFrequencies
+    TopFrequencyCollector(size_t count, size_t rows, size_t fullCols = 0, bool collapseConjugates = true);
+
+    // Rows firstRow .. firstRow + strip.rows of the spectrum; the strip may be released afterwards
+    void addRows(MatrixView<const complex<double>> strip, size_t firstRow);
+    void addRows(MatrixView<const complex<float>> strip, size_t firstRow);
+    void addRows(const vector<vector<complex<double>>>& strip, size_t firstRow);
+
+    // The kept components, strongest first
+    vector<FrequencyComponent> finish() const;
+
+private:
+    // Keeps the bin's value (conjugated for a mirror) so finish() needs no second look at the spectrum
+    struct RankedBin {
+        double power;
+        int k, l;
+        complex<double> value;
+        bool hasConjugate;
+    };
+
+    template <typename Spectrum>
+    void offerRows(const Spectrum& strip, size_t firstRow);
+    void offer(const RankedBin& bin);
+
+    size_t count;
+    size_t rows;
+    size_t fullCols;
+    bool collapseConjugates;
+    size_t stripCols = 0;    // stored width, seen with the first strip
+    vector<RankedBin> heap;  // weakest kept bin on top
+};
+
+// "Amplitude: a | cos(fx * x + fy * y + phase)"
+void printFrequencyComponent(ostream& out, const FrequencyComponent& component);
+
+// Print a half-spectrum as the full complex matrix it stands for
+void printHalfSpectrum(const vector<vector<complex<double>>>& halfSpectrum, size_t cols);
@@ -0,0 +1,328 @@
+#include "image_io.h"
+#include <fstream>
+#include <iterator>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <span>
+#include <png.h>
+
+using namespace std;
+
+// Whole-file read; PNM files are parsed from memory
+static bool readFile(const string& path, vector<uint8_t>& bytes) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        return false;
+    }
+    bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return true;
+}
+
+// Cursor over a PNM file: whitespace separated ASCII header values with # comments
+struct PNMReader {
+    span<const uint8_t> bytes;
+    size_t pos = 0;
+
+    void skipSpace() {
+        while (pos < bytes.size()) {
+            if (bytes[pos] == '#') {
+                while (pos < bytes.size() && bytes[pos] != '\n') {
+                    ++pos;
+                }
+            } else if (isspace(bytes[pos])) {
+                ++pos;
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool readNumber(int& value) {
+        skipSpace();
+        if (pos >= bytes.size() || !isdigit(bytes[pos])) {
+            return false;
+        }
+        long long parsed = 0;
+        while (pos < bytes.size() && isdigit(bytes[pos])) {
+            parsed = parsed * 10 + (bytes[pos++] - '0');
+            if (parsed > 1000000000) {
+                return false;
+            }
+        }
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    // P1 allows digits without separators, so read a single 0/1 character
+    bool readBit(int& value) {
+        skipSpace();
+        if (pos >= bytes.size() || (bytes[pos] != '0' && bytes[pos] != '1')) {
+            return false;
+        }
+        value = bytes[pos++] - '0';
+        return true;
+    }
+
+    // Binary rasters start after exactly one whitespace byte following the header
+    size_t remaining() const { return bytes.size() - pos; }
+};
+
+// Binary PGM/PPM sample; values above 255 use two big-endian bytes
+static int readBinarySample(const uint8_t*& data, bool wide) {
+    int value = *data++;
+    if (wide) {
+        value = (value << 8) | *data++;
+    }
+    return value;
+}
+
+// What the PNM header says; rasterOffset is where the pixel data starts
+struct PNMHeader {
+    int format = 0;             // the digit after 'P'
+    int cols = 0;
+    int rows = 0;
+    int maxValue = 1;
+    size_t rasterOffset = 0;
+
+    bool ascii() const { return format <= 3; }
+    bool bitmap() const { return format == 1 || format == 4; }
+    int channels() const { return (format == 3 || format == 6) ? 3 : 1; }
+    bool wide() const { return maxValue > 255; }
+    // Bytes per row of a binary raster
+    size_t rowBytes() const {
+        return bitmap() ? (static_cast<size_t>(cols) + 7) / 8 : static_cast<size_t>(cols) * channels() * (wide() ? 2 : 1);
+    }
+};
+
+static bool readPNMHeader(span<const uint8_t> bytes, PNMHeader& header, string& error) {
+    if (bytes.size() < 2 || bytes[0] != 'P' || bytes[1] < '1' || bytes[1] > '6') {
+        error = "not a PNM file";
+        return false;
+    }
+    header.format = bytes[1] - '0';
+
+    PNMReader reader{bytes, 2};
+    if (!reader.readNumber(header.cols) || !reader.readNumber(header.rows) || (!header.bitmap() && !reader.readNumber(header.maxValue))) {
+        error = "truncated header";
+        return false;
+    }
+    if (header.cols <= 0 || header.rows <= 0 || header.maxValue <= 0 || header.maxValue > 65535) {
+        error = "invalid header";
+        return false;
+    }
+    if (!header.ascii()) {
+        ++reader.pos;
+    }
+    header.rasterOffset = reader.pos;
+    return true;
+}
+
+// Unpack one binary raster row into 0/1 pixels
+static void unpackRasterRow(const PNMHeader& header, const uint8_t* data, uint8_t* dst) {
+    if (header.bitmap()) {
+        for (int c = 0; c < header.cols; ++c) {
+            dst[c] = (data[c >> 3] >> (7 - (c & 7))) & 1;
+        }
+        return;
+    }
+    int channels = header.channels();
+    bool wide = header.wide();
+    for (int c = 0; c < header.cols; ++c) {
+        bool white = true;
+        for (int ch = 0; ch < channels; ++ch) {
+            white = readBinarySample(data, wide) == header.maxValue && white;
+        }
+        dst[c] = !white;
+    }
+}
+
+static bool loadPNM(const string& path, BinaryImage& image, string& error) {
+    vector<uint8_t> bytes;
+    if (!readFile(path, bytes)) {
+        error = "cannot open file";
+        return false;
+    }
+    PNMHeader header;
+    if (!readPNMHeader(bytes, header, error)) {
+        return false;
+    }
+    int rows = header.rows;
+    int cols = header.cols;
+    int channels = header.channels();
+    bool bitmap = header.bitmap();
+    PNMReader reader{bytes, header.rasterOffset};
+
+    image = BinaryImage(rows, cols);
+
+    if (header.ascii()) {
+        for (int r = 0; r < rows; ++r) {
+            uint8_t* dst = image.row(r);
+            for (int c = 0; c < cols; ++c) {
+                bool white = true;
+                for (int ch = 0; ch < channels; ++ch) {
+                    int value = 0;
+                    bool ok = bitmap ? reader.readBit(value) : reader.readNumber(value);
+                    if (!ok) {
+                        error = "truncated raster";
+                        return false;
+                    }
+                    // PBM stores 1 for black; grey and colour need every channel at full scale
+                    white = white && (bitmap ? value == 0 : value == header.maxValue);
+                }
+                dst[c] = !white;
+            }
+        }
+        return true;
+    }
+
+    size_t rowBytes = header.rowBytes();
+    if (reader.remaining() < rowBytes * rows) {
+        error = "truncated raster";
+        return false;
+    }
+    const uint8_t* data = bytes.data() + reader.pos;
+    for (int r = 0; r < rows; ++r, data += rowBytes) {
+        unpackRasterRow(header, data, image.row(r));
+    }
+    return true;
+}
+
+static bool loadPNG(const string& path, BinaryImage& image, string& error) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path.c_str())) {
+        error = png.message;
+        return false;
+    }
+
+    // Decode to 8-bit RGB over a white background
+    png.format = PNG_FORMAT_RGB;
+    png_color background = {255, 255, 255};
+    vector<uint8_t> rgb(PNG_IMAGE_SIZE(png));
+    if (!png_image_finish_read(&png, &background, rgb.data(), 0, nullptr)) {
+        error = png.message;
+        png_image_free(&png);
+        return false;
+    }
+
+    int rows = static_cast<int>(png.height);
+    int cols = static_cast<int>(png.width);
+    image = BinaryImage(rows, cols);
+    const uint8_t* src = rgb.data();
+    for (int r = 0; r < rows; ++r) {
+        uint8_t* dst = image.row(r);
+        for (int c = 0; c < cols; ++c, src += 3) {
+            dst[c] = !(src[0] == 255 && src[1] == 255 && src[2] == 255);
+        }
+    }
+    return true;
+}
+
+static string getLowerExtension(const string& path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == string::npos || (slash != string::npos && dot < slash)) {
+        return "";
+    }
+    string extension = path.substr(dot + 1);
+    transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char ch) { return static_cast<char>(tolower(ch)); });
+    return extension;
+}
+
+bool isSupportedImageFile(const string& path) {
+    string extension = getLowerExtension(path);
+    return extension == "pbm" || extension == "pgm" || extension == "ppm" || extension == "pnm" || extension == "png";
+}
+
+bool loadBinaryImage(const string& path, BinaryImage& image, string& error) {
+    if (getLowerExtension(path) == "png") {
+        return loadPNG(path, image, error);
+    }
+    return loadPNM(path, image, error);
+}
+
+bool MappedBinaryImage::open(const string& path, string& error) {
+    if (!file.openRead(path, error)) {
+        return false;
+    }
+    PNMHeader header;
+    span<const uint8_t> bytes(file.bytes(), file.size());
+    if (!readPNMHeader(bytes, header, error)) {
+        file.close();
+        return false;
+    }
+    if (header.ascii()) {
+        error = "ASCII PNM rows have no fixed size; convert to P4, P5 or P6 to stream";
+        file.close();
+        return false;
+    }
+    if (file.size() - header.rasterOffset < header.rowBytes() * header.rows) {
+        error = "truncated raster";
+        file.close();
+        return false;
+    }
+    format = header.format;
+    rowCount = header.rows;
+    colCount = header.cols;
+    maxValue = header.maxValue;
+    rasterOffset = header.rasterOffset;
+    rowBytes = header.rowBytes();
+    return true;
+}
+
+bool MappedBinaryImage::create(const string& path, size_t rows, size_t cols, string& error) {
+    string header = "P4\n" + to_string(cols) + " " + to_string(rows) + "\n";
+    size_t packedBytes = (cols + 7) / 8;
+    if (rows == 0 || cols == 0) {
+        error = "empty image";
+        return false;
+    }
+    if (!file.create(path, header.size() + packedBytes * rows, error)) {
+        return false;
+    }
+    memcpy(file.writableBytes(), header.data(), header.size());
+    format = 4;
+    rowCount = rows;
+    colCount = cols;
+    maxValue = 1;
+    rasterOffset = header.size();
+    rowBytes = packedBytes;
+    return true;
+}
+
+bool MappedBinaryImage::close(string& error) {
+    return file.close(error);
+}
+
+void MappedBinaryImage::readRows(size_t firstRow, MatrixView<uint8_t> out) const {
+    PNMHeader header;
+    header.format = format;
+    header.cols = static_cast<int>(colCount);
+    header.rows = static_cast<int>(rowCount);
+    header.maxValue = maxValue;
+    const uint8_t* data = file.bytes() + rasterOffset + firstRow * rowBytes;
+    for (size_t r = 0; r < out.rows; ++r, data += rowBytes) {
+        unpackRasterRow(header, data, out.row(r));
+    }
+}
+
+void MappedBinaryImage::writeRows(size_t firstRow, MatrixView<const uint8_t> pixels) {
+    uint8_t* data = file.writableBytes() + rasterOffset + firstRow * rowBytes;
+    for (size_t r = 0; r < pixels.rows; ++r, data += rowBytes) {
+        const uint8_t* src = pixels.row(r);
+        fill_n(data, rowBytes, 0);
+        for (size_t c = 0; c < colCount; ++c) {
+            data[c >> 3] |= (src[c] != 0) << (7 - (c & 7));
+        }
+    }
+}
+
+void MappedBinaryImage::willNeedRows(size_t firstRow, size_t count) const {
+    file.willNeed(rasterOffset + firstRow * rowBytes, count * rowBytes);
+}
+
+void MappedBinaryImage::releaseRows(size_t firstRow, size_t count) const {
+    file.release(rasterOffset + firstRow * rowBytes, count * rowBytes);
+}
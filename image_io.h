@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include "binary_image.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+// Load an image file as a binary plane using the drawing window's rule: pure white
+// (255, 255, 255) is background, every other colour is ink.
+// Supported: PBM (P1/P4), PGM (P2/P5), PPM (P3/P6) and PNG. PNG transparency is
+// composited over white first, like strokes drawn on the cleared window.
+// Returns false and fills error if the file can't be read or decoded.
+bool loadBinaryImage(const string& path, BinaryImage& image, string& error);
+
+// True if the extension is one loadBinaryImage understands
+bool isSupportedImageFile(const string& path);
+
+// Binary image in a memory-mapped PNM file, read and written a strip of rows at a time so images
+// far larger than memory can be processed (see streaming.h). open() takes the raw formats P4, P5
+// and P6, whose rows have a fixed size, and applies the same white-is-background rule as
+// loadBinaryImage. create() makes a new P4 bitmap of all-white pixels, the only kind that can be
+// written back.
+class MappedBinaryImage {
+public:
+    bool open(const string& path, string& error);
+    bool create(const string& path, size_t rows, size_t cols, string& error);
+    // Flushes rows written to a created file
+    bool close(string& error);
+
+    size_t rows() const { return rowCount; }
+    size_t cols() const { return colCount; }
+
+    // Unpack rows [firstRow, firstRow + out.rows) into 0/1 bytes; out.cols must be cols()
+    void readRows(size_t firstRow, MatrixView<uint8_t> out) const;
+    // Pack pixels.rows rows back in at firstRow (created files only)
+    void writeRows(size_t firstRow, MatrixView<const uint8_t> pixels);
+
+    // Start reading rows ahead of use / drop rows no longer needed from memory
+    void willNeedRows(size_t firstRow, size_t count) const;
+    void releaseRows(size_t firstRow, size_t count) const;
+
+private:
+    MappedFile file;
+    int format = 0;
+    size_t rowCount = 0;
+    size_t colCount = 0;
+    int maxValue = 1;
+    size_t rasterOffset = 0;
+    size_t rowBytes = 0;
+};
@@ -0,0 +1,211 @@
+#include "live_analysis.h"
+#include "thinning.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+using namespace std;
+
+// New ink can change deletion decisions this far away, so tiles this close count as touched
+static const int dirtyReach = 2;
+
+LiveAnalyzer::LiveAnalyzer(int width, int height, const LiveAnalysisOptions& options) : options(options) {
+    apply({StrokeSegment{}, true, width, height, chrono::steady_clock::now()});
+    pendingAnalysis = false;
+    worker = thread(&LiveAnalyzer::run, this);
+}
+
+LiveAnalyzer::~LiveAnalyzer() {
+    stopping.store(true);
+    wakeups.fetch_add(1, memory_order_release);
+    wakeups.notify_one();
+    worker.join();
+}
+
+void LiveAnalyzer::push(const Event& event) {
+    // Keep the order: nothing new goes into the ring while older events wait outside it
+    if (!overflow.empty() || !events.tryPush(event)) {
+        overflow.push_back(event);
+        return;
+    }
+    wakeups.fetch_add(1, memory_order_release);
+    wakeups.notify_one();
+}
+
+void LiveAnalyzer::submitSegment(const StrokeSegment& segment) {
+    flush();
+    push({segment, false, 0, 0, chrono::steady_clock::now()});
+}
+
+void LiveAnalyzer::submitReset(int width, int height) {
+    flush();
+    push({StrokeSegment{}, true, width, height, chrono::steady_clock::now()});
+}
+
+void LiveAnalyzer::flush() {
+    size_t sent = 0;
+    while (sent < overflow.size() && events.tryPush(overflow[sent])) {
+        ++sent;
+    }
+    if (sent > 0) {
+        overflow.erase(overflow.begin(), overflow.begin() + sent);
+        wakeups.fetch_add(1, memory_order_release);
+        wakeups.notify_one();
+    }
+}
+
+bool LiveAnalyzer::pollResult(LiveAnalysisResult& result) {
+    unique_lock<mutex> guard(resultLock, try_to_lock);
+    if (!guard.owns_lock() || published.generation == takenGeneration) {
+        return false;
+    }
+    result = published;
+    takenGeneration = published.generation;
+    return true;
+}
+
+void LiveAnalyzer::run() {
+    while (true) {
+        // Read the counter before draining so a push after the drain still wakes us
+        uint32_t seen = wakeups.load(memory_order_acquire);
+        Event event;
+        while (events.tryPop(event)) {
+            apply(event);
+        }
+        if (stopping.load()) {
+            break;
+        }
+
+        if (!pendingAnalysis) {
+            wakeups.wait(seen, memory_order_acquire);
+            continue;
+        }
+        auto now = chrono::steady_clock::now();
+        auto due = lastAnalysis + options.minInterval;
+        if (now >= due) {
+            analyze();
+        } else {
+            // Keep draining input while waiting for the next refresh slot
+            this_thread::sleep_until(min(due, now + chrono::milliseconds(5)));
+        }
+    }
+}
+
+void LiveAnalyzer::apply(const Event& event) {
+    if (!pendingAnalysis) {
+        oldestPending = event.submitted;
+    }
+    pendingAnalysis = true;
+
+    if (event.reset) {
+        ink = BinaryImage(event.height, event.width);
+        skeleton = BinaryImage(event.height, event.width);
+        tilesX = (event.width + options.tileSize - 1) / options.tileSize;
+        tilesY = (event.height + options.tileSize - 1) / options.tileSize;
+        dirtyTiles.assign(static_cast<size_t>(tilesX) * tilesY, 0);
+        minX = minY = 0;
+        maxX = maxY = -1;
+        return;
+    }
+
+    const StrokeSegment& s = event.segment;
+    bool drawn = false;
+    forEachSegmentPixel(s, [&](int x, int y) {
+        if (x >= 0 && x < ink.cols && y >= 0 && y < ink.rows) {
+            ink.at(y, x) = 1;
+            drawn = true;
+        }
+    });
+    if (!drawn) {
+        return;
+    }
+
+    int x0 = max(min<int>(s.x0, s.x1), 0);
+    int x1 = min<int>(max<int>(s.x0, s.x1), ink.cols - 1);
+    int y0 = max(min<int>(s.y0, s.y1), 0);
+    int y1 = min<int>(max<int>(s.y0, s.y1), ink.rows - 1);
+    if (maxX < minX) {
+        minX = x0, maxX = x1, minY = y0, maxY = y1;
+    } else {
+        minX = min(minX, x0), maxX = max(maxX, x1), minY = min(minY, y0), maxY = max(maxY, y1);
+    }
+
+    int tileX0 = max(x0 - dirtyReach, 0) / options.tileSize;
+    int tileX1 = min(x1 + dirtyReach, ink.cols - 1) / options.tileSize;
+    int tileY0 = max(y0 - dirtyReach, 0) / options.tileSize;
+    int tileY1 = min(y1 + dirtyReach, ink.rows - 1) / options.tileSize;
+    for (int ty = tileY0; ty <= tileY1; ++ty) {
+        for (int tx = tileX0; tx <= tileX1; ++tx) {
+            dirtyTiles[static_cast<size_t>(ty) * tilesX + tx] = 1;
+        }
+    }
+}
+
+void LiveAnalyzer::analyze() {
+    auto start = chrono::steady_clock::now();
+    int tile = options.tileSize;
+
+    // Re-thin each touched tile from the ink around it and keep only the tile itself
+    BinaryImage region;
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            uint8_t& dirty = dirtyTiles[static_cast<size_t>(ty) * tilesX + tx];
+            if (!dirty) {
+                continue;
+            }
+            dirty = 0;
+
+            int r0 = ty * tile, r1 = min(r0 + tile, ink.rows);
+            int c0 = tx * tile, c1 = min(c0 + tile, ink.cols);
+            int haloR0 = max(r0 - options.halo, 0), haloR1 = min(r1 + options.halo, ink.rows);
+            int haloC0 = max(c0 - options.halo, 0), haloC1 = min(c1 + options.halo, ink.cols);
+
+            region = BinaryImage(haloR1 - haloR0, haloC1 - haloC0);
+            for (int r = haloR0; r < haloR1; ++r) {
+                copy(ink.row(r) + haloC0, ink.row(r) + haloC1, region.row(r - haloR0));
+            }
+            thinImage(region);
+            for (int r = r0; r < r1; ++r) {
+                const uint8_t* src = region.row(r - haloR0) + (c0 - haloC0);
+                copy(src, src + (c1 - c0), skeleton.row(r) + c0);
+            }
+        }
+    }
+
+    LiveAnalysisResult result;
+    if (maxX >= minX) {
+        // Drawn region plus a one pixel border, as in the final analysis
+        int left = max(minX - 1, 0), right = min(maxX + 1, skeleton.cols - 1);
+        int top = max(minY - 1, 0), bottom = min(maxY + 1, skeleton.rows - 1);
+        for (int r = top; r <= bottom; ++r) {
+            const uint8_t* src = skeleton.row(r);
+            for (int c = left; c <= right; ++c) {
+                if (src[c]) {
+                    result.skeleton.push_back({r, c});
+                }
+            }
+        }
+        // Transformed straight out of the skeleton through a block view
+        MatrixView<const uint8_t> drawnRegion = skeleton.view().block(top, left, bottom - top + 1, right - left + 1);
+        size_t rows = getTransformSize(drawnRegion.rows, FFTPadding::PowerOf2);
+        size_t cols = getTransformSize(drawnRegion.cols, FFTPadding::PowerOf2);
+        if (options.precision == FFTPrecision::Float) {
+            Matrix<complex<float>> spectrum(rows, cols / 2 + 1);
+            DFT2DRealFFT(drawnRegion, spectrum, cols, &getDefaultThreadPool());
+            result.components = extractTopFrequencies(spectrum, options.topCount, cols);
+        } else {
+            Matrix<complex<double>> spectrum(rows, cols / 2 + 1);
+            DFT2DRealFFT(drawnRegion, spectrum, cols, &getDefaultThreadPool());
+            result.components = extractTopFrequencies(spectrum, options.topCount, cols);
+        }
+    }
+
+    auto end = chrono::steady_clock::now();
+    result.analysisMs = chrono::duration<double, milli>(end - start).count();
+    result.latencyMs = chrono::duration<double, milli>(end - oldestPending).count();
+    lastAnalysis = end;
+    pendingAnalysis = false;
+
+    lock_guard<mutex> guard(resultLock);
+    result.generation = published.generation + 1;
+    published = std::move(result);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "spsc_queue.h"
+#include "stroke_log.h"
+#include "contour.h"
+#include "fourier.h"
+
+using namespace std;
+
+// Latest published state of the background analysis
+struct LiveAnalysisResult {
+    uint64_t generation = 0;                // increases with every publish
+    vector<PixelPoint> skeleton;            // skeleton pixels in window coordinates
+    vector<FrequencyComponent> components;  // strongest components of the drawn region
+    double analysisMs = 0;                  // time spent re-thinning and transforming
+    double latencyMs = 0;                   // oldest included segment's submit time -> publish
+};
+
+struct LiveAnalysisOptions {
+    int tileSize = 64;                              // re-thinning granularity
+    int halo = 16;                                  // extra context thinned around each dirty tile
+    size_t topCount = 8;
+    chrono::milliseconds minInterval{100};          // refresh cap (10 Hz)
+    FFTPrecision precision = FFTPrecision::Float;   // the overlay only needs the strongest bins
+};
+
+// Thins and transforms the canvas on a worker thread while the user draws.
+// The UI thread feeds segments through a lock-free SPSC queue and picks up results with
+// pollResult; neither call blocks. The worker keeps its own copy of the ink, re-thins only the
+// tiles touched since the last refresh (each with a halo of surrounding pixels, which gives the
+// full-canvas result for strokes thinner than the halo) and then recomputes the top components
+// of the drawn region, at most once per minInterval.
+class LiveAnalyzer {
+public:
+    LiveAnalyzer(int width, int height, const LiveAnalysisOptions& options = LiveAnalysisOptions());
+    ~LiveAnalyzer();
+
+    LiveAnalyzer(const LiveAnalyzer&) = delete;
+    LiveAnalyzer& operator=(const LiveAnalyzer&) = delete;
+
+    // UI thread only. Events that don't fit in the queue are held back and resent by flush().
+    void submitSegment(const StrokeSegment& segment);
+    // Drop all ink and start over on a width x height canvas (window cleared or resized)
+    void submitReset(int width, int height);
+    void flush();
+
+    // Copy out a result newer than the last one taken. Returns false if there is none or the
+    // worker is publishing right now.
+    bool pollResult(LiveAnalysisResult& result);
+
+private:
+    struct Event {
+        StrokeSegment segment;
+        bool reset;
+        int width, height;
+        chrono::steady_clock::time_point submitted;
+    };
+
+    void push(const Event& event);
+    void run();
+    void apply(const Event& event);
+    void analyze();
+
+    LiveAnalysisOptions options;
+
+    // UI side
+    SPSCQueue<Event, 1024> events;
+    vector<Event> overflow;
+    uint64_t takenGeneration = 0;
+
+    // Worker side
+    atomic<uint32_t> wakeups{0};
+    atomic<bool> stopping{false};
+    BinaryImage ink;
+    BinaryImage skeleton;
+    int tilesX = 0, tilesY = 0;
+    vector<uint8_t> dirtyTiles;
+    bool pendingAnalysis = false;
+    int minX = 0, minY = 0, maxX = -1, maxY = -1;   // ink bounding box
+    chrono::steady_clock::time_point oldestPending;
+    chrono::steady_clock::time_point lastAnalysis;
+
+    mutex resultLock;
+    LiveAnalysisResult published;
+
+    thread worker;
+};
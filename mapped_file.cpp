@@ -0,0 +1,110 @@
+#include "mapped_file.h"
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::openRead(const string& path, string& error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        error = "empty or unreadable file";
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error = strerror(errno);
+        return false;
+    }
+    data = static_cast<uint8_t*>(mapping);
+    length = info.st_size;
+    writable = false;
+    return true;
+}
+
+bool MappedFile::create(const string& path, size_t size, string& error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    // A sparse file of zeros; blocks are only allocated as pages get written
+    if (size == 0 || ftruncate(fd, size) != 0) {
+        error = size == 0 ? "empty file" : strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error = strerror(errno);
+        return false;
+    }
+    data = static_cast<uint8_t*>(mapping);
+    length = size;
+    writable = true;
+    return true;
+}
+
+bool MappedFile::close(string& error) {
+    bool ok = true;
+    if (data != nullptr && writable && msync(data, length, MS_SYNC) != 0) {
+        error = strerror(errno);
+        ok = false;
+    }
+    close();
+    return ok;
+}
+
+void MappedFile::close() {
+    if (data != nullptr) {
+        munmap(data, length);
+        data = nullptr;
+        length = 0;
+        writable = false;
+    }
+}
+
+// Page-aligned cover of [offset, offset + count) clipped to the map, or false if it is empty
+static bool getPageRange(size_t length, size_t offset, size_t count, size_t& begin, size_t& end) {
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    if (offset >= length || count == 0) {
+        return false;
+    }
+    begin = offset / pageSize * pageSize;
+    end = min(length, (offset + count + pageSize - 1) / pageSize * pageSize);
+    return true;
+}
+
+void MappedFile::willNeed(size_t offset, size_t count) const {
+    size_t begin, end;
+    if (data != nullptr && getPageRange(length, offset, count, begin, end)) {
+        madvise(data + begin, end - begin, MADV_WILLNEED);
+    }
+}
+
+void MappedFile::release(size_t offset, size_t count) const {
+    size_t begin, end;
+    // Dropping pages of a shared map keeps their contents in the file; of a private read-only
+    // map, they are simply read again if touched later
+    if (data != nullptr && getPageRange(length, offset, count, begin, end)) {
+        madvise(data + begin, end - begin, MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Memory map of a whole file, either read-only or read-write over a file created at a fixed size.
+// Pages are loaded on first touch; willNeed() starts reading a range ahead of use and release()
+// drops a range the caller is done with, so a strip-at-a-time pass over a file far larger than
+// memory keeps only the strips in flight resident. Written pages reach the file through the page
+// cache whether or not they were released.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool openRead(const string& path, string& error);
+    // Creates or truncates path to size bytes, all zero
+    bool create(const string& path, size_t size, string& error);
+    // Flushes written pages to disk when the map was created writable
+    bool close(string& error);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    size_t size() const { return length; }
+    const uint8_t* bytes() const { return data; }
+    // Null for a read-only map
+    uint8_t* writableBytes() const { return writable ? data : nullptr; }
+
+    // Hints for [offset, offset + count); both are rounded out to whole pages
+    void willNeed(size_t offset, size_t count) const;
+    void release(size_t offset, size_t count) const;
+
+private:
+    uint8_t* data = nullptr;
+    size_t length = 0;
+    bool writable = false;
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include "arena.h"
+
+using namespace std;
+
+// Every stride-th element starting at data, e.g. one column of a row-major matrix
+template <typename T>
+struct StridedView {
+    T* data = nullptr;
+    size_t size = 0;
+    size_t stride = 1;
+
+    T& operator[](size_t i) const { return data[i * stride]; }
+};
+
+// Non-owning rows x cols window onto row-major storage; rows are stride elements apart, so a
+// view can cover a block of a larger matrix. Copying a view never copies the elements.
+template <typename T>
+struct MatrixView {
+    T* data = nullptr;
+    size_t rows = 0;
+    size_t cols = 0;
+    size_t stride = 0;
+
+    MatrixView() = default;
+    MatrixView(T* data, size_t rows, size_t cols, size_t stride) : data(data), rows(rows), cols(cols), stride(stride) {}
+    MatrixView(T* data, size_t rows, size_t cols) : MatrixView(data, rows, cols, cols) {}
+
+    // Read-only views are taken from mutable ones implicitly
+    operator MatrixView<const T>() const { return {data, rows, cols, stride}; }
+
+    T* row(size_t r) const { return data + r * stride; }
+    T& operator()(size_t r, size_t c) const { return data[r * stride + c]; }
+    StridedView<T> column(size_t c) const { return {data + c, rows, stride}; }
+
+    // rowCount x colCount window starting at (r, c), sharing this view's storage
+    MatrixView block(size_t r, size_t c, size_t rowCount, size_t colCount) const { return {row(r) + c, rowCount, colCount, stride}; }
+
+    bool empty() const { return rows == 0 || cols == 0; }
+    bool isContiguous() const { return stride == cols; }
+};
+
+// count same-shape rows x cols matrices in one block, e.g. a batch of images of one resolution.
+// Matrix i starts matrixStride elements after matrix i - 1 and its rows are stride elements apart.
+template <typename T>
+struct MatrixBatchView {
+    T* data = nullptr;
+    size_t count = 0;
+    size_t rows = 0;
+    size_t cols = 0;
+    size_t stride = 0;
+    size_t matrixStride = 0;
+
+    MatrixBatchView() = default;
+    MatrixBatchView(T* data, size_t count, size_t rows, size_t cols, size_t stride, size_t matrixStride)
+        : data(data), count(count), rows(rows), cols(cols), stride(stride), matrixStride(matrixStride) {}
+    // count matrices stacked top to bottom in one view of count * rows rows
+    MatrixBatchView(MatrixView<T> stacked, size_t count)
+        : MatrixBatchView(stacked.data, count, count > 0 ? stacked.rows / count : 0, stacked.cols, stacked.stride,
+                          count > 0 ? stacked.rows / count * stacked.stride : 0) {}
+
+    operator MatrixBatchView<const T>() const { return {data, count, rows, cols, stride, matrixStride}; }
+
+    MatrixView<T> operator[](size_t i) const { return {data + i * matrixStride, rows, cols, stride}; }
+
+    bool empty() const { return count == 0 || rows == 0 || cols == 0; }
+};
+
+// Dense row-major matrix with 64-byte aligned rows-by-cols storage, either drawn from an Arena
+// (freed all at once by Arena::reset) or owned on the heap. Elements are zero-initialised.
+// Only trivially copyable element types are allowed, since arena memory is dropped without
+// running destructors.
+template <typename T>
+class Matrix {
+    static_assert(is_trivially_copyable_v<T> && is_trivially_destructible_v<T>, "Matrix elements must be trivially copyable");
+
+public:
+    Matrix() = default;
+
+    Matrix(size_t rows, size_t cols) : elements(nullptr), rowCount(rows), colCount(cols), ownsStorage(true) {
+        if (size() > 0) {
+            elements = static_cast<T*>(::operator new(size() * sizeof(T), align_val_t(Arena::defaultAlignment)));
+            memset(static_cast<void*>(elements), 0, size() * sizeof(T));
+        }
+    }
+
+    // Storage lives until arena is reset; the matrix must not be used after that
+    Matrix(size_t rows, size_t cols, Arena& arena) : elements(arena.allocateArray<T>(rows * cols)), rowCount(rows), colCount(cols) {
+        memset(static_cast<void*>(elements), 0, size() * sizeof(T));
+    }
+
+    ~Matrix() { release(); }
+
+    Matrix(const Matrix&) = delete;
+    Matrix& operator=(const Matrix&) = delete;
+
+    Matrix(Matrix&& other) noexcept { *this = std::move(other); }
+    Matrix& operator=(Matrix&& other) noexcept {
+        if (this != &other) {
+            release();
+            elements = other.elements;
+            rowCount = other.rowCount;
+            colCount = other.colCount;
+            ownsStorage = other.ownsStorage;
+            other.elements = nullptr;
+            other.rowCount = other.colCount = 0;
+            other.ownsStorage = false;
+        }
+        return *this;
+    }
+
+    size_t rows() const { return rowCount; }
+    size_t cols() const { return colCount; }
+    size_t size() const { return rowCount * colCount; }
+    T* data() { return elements; }
+    const T* data() const { return elements; }
+
+    T* row(size_t r) { return elements + r * colCount; }
+    const T* row(size_t r) const { return elements + r * colCount; }
+    T& operator()(size_t r, size_t c) { return elements[r * colCount + c]; }
+    const T& operator()(size_t r, size_t c) const { return elements[r * colCount + c]; }
+
+    MatrixView<T> view() { return {elements, rowCount, colCount}; }
+    MatrixView<const T> view() const { return {elements, rowCount, colCount}; }
+    operator MatrixView<T>() { return view(); }
+    operator MatrixView<const T>() const { return view(); }
+
+private:
+    void release() {
+        if (ownsStorage && elements) {
+            ::operator delete(elements, align_val_t(Arena::defaultAlignment));
+        }
+        elements = nullptr;
+    }
+
+    T* elements = nullptr;
+    size_t rowCount = 0;
+    size_t colCount = 0;
+    bool ownsStorage = false;
+};
@@ -3,41 +3,29 @@
 #include <iostream>
 #include <vector>
 #include "fourier.h"
+#include "fftw_plan_cache.h"
+#include "batch.h"
+#include "spectrum_file.h"
+#include "contour.h"
+#include "stroke_log.h"
+#include "live_analysis.h"
+#include "trace.h"
 #include <cmath>
+#include <string>
+#include <sstream>
+#include <iomanip>
 
 using namespace std;
 
-void displayDominantFrequencies(const vector<vector<complex<double>>>& ifft_result, double threshold = 0.1) {
-    int rows = ifft_result.size();
-    int cols = ifft_result[0].size();
-    int M = rows;
-    int N = cols;
-
+// fullCols == 0: spectrum is a full complex grid.
+// Otherwise spectrum is a half-spectrum of a fullCols-wide transform and each stored bin
+// also stands for its conjugate mirror, which is printed alongside it.
+void displayDominantFrequencies(const vector<vector<complex<double>>>& spectrum, double threshold = 0.1, size_t fullCols = 0) {
     cout << "Dominant frequency components:\n";
 
-    for (int k = 0; k < rows; ++k) {
-        for (int l = 0; l < cols; ++l) {
-            // Extract real and imaginary parts
-            double realPart = ifft_result[k][l].real();
-            double imagPart = ifft_result[k][l].imag();
-
-            // Calculate amplitude
-            double amplitude = sqrt(realPart * realPart + imagPart * imagPart);
-
-            // Check if amplitude is above the threshold
-            if (amplitude > threshold) {
-                // Calculate frequency in each dimension
-                double frequencyX = 2.0 * M_PI * k / M;
-                double frequencyY = 2.0 * M_PI * l / N;
-
-                // Calculate phase
-                double phase = atan2(imagPart, realPart);
-
-                // Output the component as a sine and cosine term
-                cout << "Amplitude: " << amplitude
-                     << " | cos(" << frequencyX << " * x + " << frequencyY << " * y + " << phase << ")\n";
-            }
-        }
+    // Output each component as a sine and cosine term
+    for (const FrequencyComponent& component : extractDominantFrequencies(spectrum, threshold, fullCols)) {
+        printFrequencyComponent(cout, component);
     }
 }
 
@@ -52,19 +40,8 @@ void printMatrix(const vector<vector<int>>& matrix) {
     cout << "\n";
 }
 
-int main(int argc, char* argv[]) {
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
-        return 1;
-    }
-
-    SDL_Window* window = SDL_CreateWindow("SDL Drawing", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 480, SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN);
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
-    if (!window || !renderer) {
-        std::cerr << "Window/Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
-        return 1;
-    }
-
+// Draw straight onto the window until it is closed, recording every line in strokeLog
+void runDrawingSession(SDL_Renderer* renderer, StrokeLog& strokeLog) {
     // Set the initial white background
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderClear(renderer);
@@ -84,6 +61,7 @@ int main(int argc, char* argv[]) {
                 SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
                 SDL_RenderClear(renderer);
                 SDL_RenderPresent(renderer);
+                strokeLog.clear();
             } else if (event.type == SDL_MOUSEBUTTONDOWN) {
                 if (event.button.button == SDL_BUTTON_LEFT) {
                     drawing = true;
@@ -100,6 +78,7 @@ int main(int argc, char* argv[]) {
                 // Draw the line directly on the renderer
                 SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black color for line
                 SDL_RenderDrawLine(renderer, prevX, prevY, x, y);
+                strokeLog.addSegment(prevX, prevY, x, y);
 
                 // Update the screen
                 SDL_RenderPresent(renderer);
@@ -110,53 +89,288 @@ int main(int argc, char* argv[]) {
             }
         }
     }
+}
 
-    // Capture renderer output for printing
-    int windowWidth, windowHeight;
-    SDL_GetWindowSize(window, &windowWidth, &windowHeight);
-    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, windowWidth, windowHeight, 32, SDL_PIXELFORMAT_RGBA32);
-    SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGBA32, surface->pixels, surface->pitch);
-
-    // Print matrix with 1 for black and 0 for white
-    vector<vector<int>> windowPixelColors(windowHeight, vector<int>(windowWidth, 0));;
-    uint32_t* pixels = (uint32_t*)surface->pixels;
-    for (int y = 0; y < windowHeight; ++y) {
-        for (int x = 0; x < windowWidth; ++x) {
-            uint32_t pixel = pixels[(y * windowWidth) + x];
-            uint8_t r = (pixel & 0xFF000000) >> 24;
-            uint8_t g = (pixel & 0x00FF0000) >> 16;
-            uint8_t b = (pixel & 0x0000FF00) >> 8;
-            if (r == 255 && g == 255 && b == 255) {
-                windowPixelColors[y][x] = 0;
-            } else {
-                windowPixelColors[y][x] = 1;
+// Live mode: strokes go to a background LiveAnalyzer as they are drawn and the latest skeleton
+// and component amplitudes are overlaid on the canvas. The canvas lives in a target texture so
+// the overlay can be redrawn every frame; frame time and analysis latency go in the title bar.
+void runLiveSession(SDL_Window* window, SDL_Renderer* renderer, StrokeLog& strokeLog, size_t topCount) {
+    int width, height;
+    SDL_GetWindowSize(window, &width, &height);
+    auto createCanvas = [&]() {
+        SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, width, height);
+        SDL_SetRenderTarget(renderer, texture);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderClear(renderer);
+        SDL_SetRenderTarget(renderer, NULL);
+        return texture;
+    };
+    SDL_Texture* canvas = createCanvas();
+
+    LiveAnalysisOptions options;
+    options.topCount = topCount;
+    LiveAnalyzer analyzer(width, height, options);
+    LiveAnalysisResult latest;
+    vector<SDL_Point> skeletonPoints;
+
+    const double targetFrameMs = 1000.0 / 60.0;
+    double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+    double frameMs = 0;
+    uint32_t lastTitleUpdate = 0;
+
+    bool quit = false;
+    bool drawing = false;
+    SDL_Event event;
+    int prevX = 0, prevY = 0;
+
+    while (!quit) {
+        uint64_t frameStart = SDL_GetPerformanceCounter();
+        while (SDL_PollEvent(&event) != 0) {
+            if (event.type == SDL_QUIT) {
+                quit = true;
+            } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                // Start over on a blank canvas of the new size
+                SDL_GetWindowSize(window, &width, &height);
+                SDL_DestroyTexture(canvas);
+                canvas = createCanvas();
+                strokeLog.clear();
+                analyzer.submitReset(width, height);
+            } else if (event.type == SDL_MOUSEBUTTONDOWN) {
+                if (event.button.button == SDL_BUTTON_LEFT) {
+                    drawing = true;
+                    SDL_GetMouseState(&prevX, &prevY);
+                }
+            } else if (event.type == SDL_MOUSEBUTTONUP) {
+                if (event.button.button == SDL_BUTTON_LEFT) {
+                    drawing = false;
+                }
+            } else if (event.type == SDL_MOUSEMOTION && drawing) {
+                int x, y;
+                SDL_GetMouseState(&x, &y);
+
+                SDL_SetRenderTarget(renderer, canvas);
+                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+                SDL_RenderDrawLine(renderer, prevX, prevY, x, y);
+                SDL_SetRenderTarget(renderer, NULL);
+
+                strokeLog.addSegment(prevX, prevY, x, y);
+                analyzer.submitSegment(strokeLog.segments.back());
+                prevX = x;
+                prevY = y;
+            }
+        }
+        analyzer.flush();
+
+        if (analyzer.pollResult(latest)) {
+            skeletonPoints.clear();
+            for (const PixelPoint& p : latest.skeleton) {
+                skeletonPoints.push_back({p.col, p.row});
+            }
+        }
+
+        // Canvas, then the skeleton in red and one bar per component scaled to the strongest
+        SDL_RenderCopy(renderer, canvas, NULL, NULL);
+        SDL_SetRenderDrawColor(renderer, 220, 0, 0, 255);
+        SDL_RenderDrawPoints(renderer, skeletonPoints.data(), static_cast<int>(skeletonPoints.size()));
+        if (!latest.components.empty()) {
+            double strongest = latest.components[0].amplitude;
+            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+            SDL_SetRenderDrawColor(renderer, 0, 90, 200, 160);
+            for (size_t i = 0; i < latest.components.size(); ++i) {
+                int length = strongest > 0 ? static_cast<int>(120.0 * latest.components[i].amplitude / strongest) : 0;
+                SDL_Rect bar = {8, 8 + static_cast<int>(i) * 8, max(length, 1), 6};
+                SDL_RenderFillRect(renderer, &bar);
             }
         }
+        SDL_RenderPresent(renderer);
+
+        // Title updates are comparatively slow, so only a few per second
+        uint32_t now = SDL_GetTicks();
+        if (now - lastTitleUpdate >= 250) {
+            lastTitleUpdate = now;
+            ostringstream title;
+            title << fixed << setprecision(1) << "SDL Drawing | frame " << frameMs << " ms | analysis " << latest.analysisMs
+                  << " ms | latency " << latest.latencyMs << " ms";
+            SDL_SetWindowTitle(window, title.str().c_str());
+        }
+
+        frameMs = (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / frequency;
+        if (frameMs < targetFrameMs) {
+            SDL_Delay(static_cast<uint32_t>(targetFrameMs - frameMs));
+        }
     }
 
-    vector<vector<int>> thinnedPixels = createSkeleton(windowPixelColors);
-    vector<vector<complex<double>>> dftImage = DFT2DFFT(thinnedPixels);
-    printComplexMatrix(dftImage);
-    cout << endl;
+    SDL_DestroyTexture(canvas);
+}
 
-    vector<vector<complex<double>>> ifft_result;
-    performIFFT(dftImage, ifft_result);
+int main(int argc, char* argv[]) {
+    // sdl_test batch <inputDir> <outputDir> runs headless without opening a window
+    if (argc > 1 && string(argv[1]) == "batch") {
+        return runBatchCommand(argc - 2, argv + 2);
+    }
 
-    // Print IFFT result
-    for (const auto& row : ifft_result) {
-        for (const auto& val : row) {
-            cout << "(" << val.real() << ", " << val.imag() << "i) ";
+    // FFTW planning: --fftw-measure / --fftw-patient opt in to slower, better plans;
+    // wisdom is loaded at start and saved at exit so later runs skip the planning
+    // --top-k sets how many components are reported; --dump also prints the full spectrum,
+    // the reconstructed image and every component above the threshold (slow for big windows);
+    // --save-spectrum writes the half-spectrum and top-K table as a binary .spec file;
+    // --epicycles sets how many arms are listed per traced stroke;
+    // --live analyses on a background thread while drawing and overlays the results;
+    // --trace writes a Chrome trace of the run and prints a one-line summary (make TRACE=1)
+    string wisdomPath = "fftw_wisdom.dat";
+    size_t topCount = 16;
+    bool dumpSpectrum = false;
+    string spectrumPath;
+    bool liveMode = false;
+    size_t epicycleCount = 8;
+    string tracePath;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--top-k" && i + 1 < argc) {
+            topCount = stoul(argv[++i]);
+        } else if (arg == "--live") {
+            liveMode = true;
+        } else if (arg == "--dump") {
+            dumpSpectrum = true;
+        } else if (arg == "--epicycles" && i + 1 < argc) {
+            epicycleCount = stoul(argv[++i]);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--save-spectrum" && i + 1 < argc) {
+            spectrumPath = argv[++i];
+        } else if (arg == "--fftw-measure") {
+            setFFTWPlanningRigor(FFTWRigor::Measure);
+        } else if (arg == "--fftw-patient") {
+            setFFTWPlanningRigor(FFTWRigor::Patient);
+        } else if (arg == "--fftw-wisdom" && i + 1 < argc) {
+            wisdomPath = argv[++i];
         }
-        cout << endl;
     }
+    loadFFTWWisdom(wisdomPath);
 
-    cout << "\nExtracted Function Representation:\n";
-    displayDominantFrequencies(ifft_result, 0.1);
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    SDL_Window* window = SDL_CreateWindow("SDL Drawing", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 480, SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    if (!window || !renderer) {
+        std::cerr << "Window/Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    StrokeLog strokeLog;
+    TRACE_SCOPE_NAMED(drawStep, "main.draw");
+    if (liveMode) {
+        runLiveSession(window, renderer, strokeLog, topCount);
+    } else {
+        runDrawingSession(renderer, strokeLog);
+    }
+    TRACE_END(drawStep);
+
+    // Rasterise the recorded strokes around their bounding box; the window isn't needed after this
+    TRACE_SCOPE_NAMED(rasterizeStep, "main.rasterize");
+    int windowWidth, windowHeight;
+    SDL_GetWindowSize(window, &windowWidth, &windowHeight);
+    StrokeRaster raster = rasterizeStrokes(strokeLog, windowWidth, windowHeight);
+    TRACE_END(rasterizeStep);
 
-    SDL_FreeSurface(surface);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
+    if (raster.image.pixels.empty()) {
+        cout << "Nothing was drawn" << endl;
+        return 0;
+    }
+    cout << "Drawn region: " << raster.image.cols << " x " << raster.image.rows << " at (" << raster.originX << ", " << raster.originY << ")" << endl;
+
+    ThinningStats thinningStats;
+    BinaryImage& skeleton = raster.image;
+    TRACE_SCOPE_NAMED(thinningStep, "main.thinning");
+    thinImageFrontier(skeleton, &thinningStats);
+    TRACE_END(thinningStep);
+    size_t visitedPixels = 0;
+    for (size_t visited : thinningStats.visitedPerPass) {
+        visitedPixels += visited;
+    }
+    cout << "Thinning: " << thinningStats.iterations << " iterations, " << visitedPixels << " pixels visited" << endl;
+
+    // Strokes as ordered paths: each one gets 1D Fourier descriptors, listed as epicycles
+    TRACE_SCOPE_NAMED(strokeStep, "main.strokes");
+    vector<Polyline> strokes = traceSkeleton(skeleton);
+    cout << "Traced " << strokes.size() << " strokes" << endl;
+    for (size_t i = 0; i < strokes.size(); ++i) {
+        FourierDescriptors descriptors = computeFourierDescriptors(strokes[i]);
+        cout << "Stroke " << i << ": " << strokes[i].points.size() << " points" << (strokes[i].closed ? ", closed" : "") << "\n";
+        for (const Epicycle& epicycle : getEpicycles(descriptors, epicycleCount)) {
+            cout << "  radius " << epicycle.radius << " | frequency " << epicycle.frequency << " | phase " << epicycle.phase << "\n";
+        }
+    }
+    TRACE_END(strokeStep);
+
+    // The skeleton is real, so only the non-redundant half of the spectrum is computed.
+    // Native sizes keep the frequency bins on the drawn region's own grid.
+    TRACE_SCOPE_NAMED(spectrumStep, "main.spectrum");
+    vector<vector<int>> thinnedPixels;
+    copyToPixelMatrix(skeleton, thinnedPixels);
+    size_t spectrumCols = thinnedPixels[0].size();
+    vector<vector<complex<double>>> dftImage = DFT2DRealFFT(thinnedPixels, &getDefaultThreadPool(), FFTPadding::Native);
+    TRACE_END(spectrumStep);
+
+    if (dumpSpectrum) {
+        TRACE_SCOPE("main.dump");
+        printHalfSpectrum(dftImage, spectrumCols);
+        cout << endl;
+
+        vector<vector<double>> ifft_result;
+        performIFFTReal(dftImage, spectrumCols, ifft_result);
+
+        // Print IFFT result
+        for (const auto& row : ifft_result) {
+            for (double val : row) {
+                cout << "(" << val << ", 0i) ";
+            }
+            cout << endl;
+        }
+
+        cout << "\nExtracted Function Representation:\n";
+        displayDominantFrequencies(dftImage, 0.1, spectrumCols);
+    }
+
+    TRACE_SCOPE_NAMED(topStep, "main.topK");
+    vector<FrequencyComponent> topComponents = extractTopFrequencies(dftImage, topCount, spectrumCols);
+    TRACE_END(topStep);
+    cout << "\nStrongest " << topCount << " frequency components:\n";
+    for (const FrequencyComponent& component : topComponents) {
+        printFrequencyComponent(cout, component);
+    }
+
+    if (!spectrumPath.empty()) {
+        TRACE_SCOPE("main.saveSpectrum");
+        SpectrumDescription description;
+        description.sourceRows = skeleton.rows;
+        description.sourceCols = skeleton.cols;
+        description.transformCols = spectrumCols;
+        description.padding = FFTPadding::Native;
+        description.layout = SpectrumLayout::Half;
+        string error;
+        if (!writeSpectrumFile(spectrumPath, dftImage, description, topComponents, error)) {
+            cerr << "Could not write " << spectrumPath << ": " << error << endl;
+        }
+    }
+
+    if (!saveFFTWWisdom(wisdomPath)) {
+        cerr << "Could not save FFTW wisdom to " << wisdomPath << endl;
+    }
+
+    if (!tracePath.empty()) {
+        printTraceSummary(cout);
+        if (isTracingEnabled() && !writeChromeTrace(tracePath)) {
+            cerr << "Could not write trace to " << tracePath << endl;
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,357 @@
+#include "spectrum_file.h"
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <bit>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static_assert(endian::native == endian::little, "spectrum files are written in native little-endian order");
+
+static const char spectrumMagic[8] = {'D', 'R', 'A', 'W', 'S', 'P', 'E', 'C'};
+static const size_t spectrumAlignment = 64;
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static size_t getDTypeSize(SpectrumDType dtype) {
+    return dtype == SpectrumDType::Float32 ? sizeof(complex<float>) : sizeof(complex<double>);
+}
+
+static FrequencyComponent fromFileComponent(const SpectrumFileComponent& record) {
+    FrequencyComponent component;
+    component.k = record.k;
+    component.l = record.l;
+    component.amplitude = record.amplitude;
+    component.frequencyX = record.frequencyX;
+    component.frequencyY = record.frequencyY;
+    component.phase = record.phase;
+    component.hasConjugate = (record.flags & 1) != 0;
+    return component;
+}
+
+// Checks shared by both readers; fileSize bounds the offsets
+static bool validateHeader(const SpectrumFileHeader& header, size_t fileSize, string& error) {
+    if (memcmp(header.magic, spectrumMagic, sizeof(spectrumMagic)) != 0) {
+        error = "not a spectrum file";
+        return false;
+    }
+    if (header.version == 0 || header.version > spectrumFileVersion) {
+        error = "unsupported spectrum file version " + to_string(header.version);
+        return false;
+    }
+    if (header.headerSize < sizeof(SpectrumFileHeader) || header.dtype > static_cast<uint8_t>(SpectrumDType::Float64)) {
+        error = "corrupt spectrum header";
+        return false;
+    }
+    // The component table is read in place through a mapping, so it must sit past the header and
+    // be aligned for its records
+    if (header.componentOffset < header.headerSize || header.componentOffset % alignof(SpectrumFileComponent) != 0 ||
+        header.componentOffset > fileSize) {
+        error = "corrupt spectrum header";
+        return false;
+    }
+    uint64_t tableEnd = header.componentOffset + uint64_t(header.componentCount) * sizeof(SpectrumFileComponent);
+    uint64_t expectedBytes = uint64_t(header.rows) * header.cols * getDTypeSize(static_cast<SpectrumDType>(header.dtype));
+    if (tableEnd > fileSize || header.spectrumBytes != expectedBytes || header.spectrumOffset % spectrumAlignment != 0 ||
+        header.spectrumOffset + header.spectrumBytes > fileSize) {
+        error = "truncated spectrum file";
+        return false;
+    }
+    return true;
+}
+
+static SpectrumFileComponent toFileComponent(const FrequencyComponent& component) {
+    SpectrumFileComponent record = {};
+    record.k = component.k;
+    record.l = component.l;
+    record.flags = component.hasConjugate ? 1 : 0;
+    record.amplitude = component.amplitude;
+    record.frequencyX = component.frequencyX;
+    record.frequencyY = component.frequencyY;
+    record.phase = component.phase;
+    return record;
+}
+
+// Header for a rows x cols grid with room for componentCount table entries in front of it
+static SpectrumFileHeader makeHeader(size_t rows, size_t cols, const SpectrumDescription& description, size_t componentCount) {
+    SpectrumFileHeader header = {};
+    memcpy(header.magic, spectrumMagic, sizeof(spectrumMagic));
+    header.version = spectrumFileVersion;
+    header.headerSize = sizeof(SpectrumFileHeader);
+    header.rows = rows;
+    header.cols = cols;
+    header.transformRows = rows;
+    header.transformCols = description.layout == SpectrumLayout::Half ? description.transformCols : cols;
+    header.sourceRows = description.sourceRows;
+    header.sourceCols = description.sourceCols;
+    header.padding = static_cast<uint8_t>(description.padding);
+    header.transform = static_cast<uint8_t>(SpectrumTransform::ForwardDFT2D);
+    header.layout = static_cast<uint8_t>(description.layout);
+    header.dtype = static_cast<uint8_t>(description.dtype);
+    header.componentCount = componentCount;
+    header.componentOffset = sizeof(SpectrumFileHeader);
+    header.spectrumOffset = alignUp(header.componentOffset + componentCount * sizeof(SpectrumFileComponent), spectrumAlignment);
+    header.spectrumBytes = rows * cols * getDTypeSize(description.dtype);
+    return header;
+}
+
+template <typename T, typename Source>
+static void packSpectrum(MatrixView<const complex<Source>> spectrum, uint8_t* out) {
+    complex<T>* dst = reinterpret_cast<complex<T>*>(out);
+    for (size_t r = 0; r < spectrum.rows; ++r) {
+        const complex<Source>* row = spectrum.row(r);
+        for (size_t c = 0; c < spectrum.cols; ++c) {
+            *dst++ = complex<T>(static_cast<T>(row[c].real()), static_cast<T>(row[c].imag()));
+        }
+    }
+}
+
+bool writeSpectrumFile(const string& path, const vector<vector<complex<double>>>& spectrum, const SpectrumDescription& description,
+                       const vector<FrequencyComponent>& components, string& error) {
+    // Gather the rows into one grid; the view overload does the rest
+    size_t rows = spectrum.size();
+    size_t cols = rows > 0 ? spectrum[0].size() : 0;
+    Matrix<complex<double>> grid(rows, cols);
+    for (size_t r = 0; r < rows; ++r) {
+        copy(spectrum[r].begin(), spectrum[r].end(), grid.row(r));
+    }
+    return writeSpectrumFile(path, grid.view(), description, components, error);
+}
+
+template <typename Source>
+static bool writeSpectrum(const string& path, MatrixView<const complex<Source>> spectrum, const SpectrumDescription& description,
+                          const vector<FrequencyComponent>& components, string& error) {
+    SpectrumFileHeader header = makeHeader(spectrum.rows, spectrum.cols, description, components.size());
+
+    // Assemble the whole file so it goes out in one write
+    vector<uint8_t> buffer(header.spectrumOffset + header.spectrumBytes, 0);
+    memcpy(buffer.data(), &header, sizeof(header));
+    SpectrumFileComponent* records = reinterpret_cast<SpectrumFileComponent*>(buffer.data() + header.componentOffset);
+    for (const FrequencyComponent& component : components) {
+        *records++ = toFileComponent(component);
+    }
+    if (description.dtype == SpectrumDType::Float32) {
+        packSpectrum<float>(spectrum, buffer.data() + header.spectrumOffset);
+    } else {
+        packSpectrum<double>(spectrum, buffer.data() + header.spectrumOffset);
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    // write() may return early for large buffers, so keep going until everything is out
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t result = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        written += result;
+    }
+    if (::close(fd) != 0) {
+        error = strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool writeSpectrumFile(const string& path, MatrixView<const complex<double>> spectrum, const SpectrumDescription& description,
+                       const vector<FrequencyComponent>& components, string& error) {
+    return writeSpectrum(path, spectrum, description, components, error);
+}
+
+bool writeSpectrumFile(const string& path, MatrixView<const complex<float>> spectrum, const SpectrumDescription& description,
+                       const vector<FrequencyComponent>& components, string& error) {
+    return writeSpectrum(path, spectrum, description, components, error);
+}
+
+static bool readFully(int fd, void* out, size_t bytes, off_t offset) {
+    uint8_t* dst = static_cast<uint8_t*>(out);
+    while (bytes > 0) {
+        ssize_t result = ::pread(fd, dst, bytes, offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        dst += result;
+        bytes -= result;
+        offset += result;
+    }
+    return true;
+}
+
+bool loadSpectrumComponents(const string& path, vector<FrequencyComponent>& components, string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    struct stat info;
+    SpectrumFileHeader header;
+    bool ok = fstat(fd, &info) == 0 && readFully(fd, &header, sizeof(header), 0);
+    if (!ok) {
+        error = "cannot read spectrum header";
+    } else {
+        ok = validateHeader(header, info.st_size, error);
+    }
+
+    vector<SpectrumFileComponent> records;
+    if (ok) {
+        records.resize(header.componentCount);
+        ok = readFully(fd, records.data(), records.size() * sizeof(SpectrumFileComponent), header.componentOffset);
+        if (!ok) {
+            error = "cannot read component table";
+        }
+    }
+    ::close(fd);
+    if (!ok) {
+        return false;
+    }
+
+    components.clear();
+    components.reserve(records.size());
+    for (const SpectrumFileComponent& record : records) {
+        components.push_back(fromFileComponent(record));
+    }
+    return true;
+}
+
+MappedSpectrumFile::~MappedSpectrumFile() {
+    close();
+}
+
+bool MappedSpectrumFile::open(const string& path, string& error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SpectrumFileHeader)) {
+        error = "not a spectrum file";
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error = strerror(errno);
+        return false;
+    }
+    data = static_cast<const uint8_t*>(mapping);
+    length = info.st_size;
+
+    if (!validateHeader(header(), length, error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedSpectrumFile::close() {
+    if (data != nullptr) {
+        munmap(const_cast<uint8_t*>(data), length);
+        data = nullptr;
+        length = 0;
+    }
+}
+
+span<const SpectrumFileComponent> MappedSpectrumFile::components() const {
+    const SpectrumFileHeader& h = header();
+    return {reinterpret_cast<const SpectrumFileComponent*>(data + h.componentOffset), h.componentCount};
+}
+
+span<const complex<double>> MappedSpectrumFile::spectrum64() const {
+    const SpectrumFileHeader& h = header();
+    if (h.dtype != static_cast<uint8_t>(SpectrumDType::Float64)) {
+        return {};
+    }
+    return {reinterpret_cast<const complex<double>*>(data + h.spectrumOffset), size_t(h.rows) * h.cols};
+}
+
+span<const complex<float>> MappedSpectrumFile::spectrum32() const {
+    const SpectrumFileHeader& h = header();
+    if (h.dtype != static_cast<uint8_t>(SpectrumDType::Float32)) {
+        return {};
+    }
+    return {reinterpret_cast<const complex<float>*>(data + h.spectrumOffset), size_t(h.rows) * h.cols};
+}
+
+span<const complex<double>> MappedSpectrumFile::row64(size_t r) const {
+    span<const complex<double>> grid = spectrum64();
+    return grid.empty() ? grid : grid.subspan(r * header().cols, header().cols);
+}
+
+span<const complex<float>> MappedSpectrumFile::row32(size_t r) const {
+    span<const complex<float>> grid = spectrum32();
+    return grid.empty() ? grid : grid.subspan(r * header().cols, header().cols);
+}
+
+bool SpectrumFileWriter::create(const string& path, size_t rows, size_t cols, const SpectrumDescription& description,
+                                size_t componentCapacity, string& error) {
+    SpectrumFileHeader header = makeHeader(rows, cols, description, componentCapacity);
+    if (!file.create(path, header.spectrumOffset + header.spectrumBytes, error)) {
+        return false;
+    }
+    // Valid from the start: an empty table in front of an all-zero grid
+    header.componentCount = 0;
+    memcpy(file.writableBytes(), &header, sizeof(header));
+    capacity = componentCapacity;
+    return true;
+}
+
+SpectrumFileHeader& SpectrumFileWriter::header() const {
+    return *reinterpret_cast<SpectrumFileHeader*>(file.writableBytes());
+}
+
+MatrixView<complex<double>> SpectrumFileWriter::grid64() const {
+    const SpectrumFileHeader& h = header();
+    if (h.dtype != static_cast<uint8_t>(SpectrumDType::Float64)) {
+        return {};
+    }
+    return {reinterpret_cast<complex<double>*>(file.writableBytes() + h.spectrumOffset), h.rows, h.cols};
+}
+
+MatrixView<complex<float>> SpectrumFileWriter::grid32() const {
+    const SpectrumFileHeader& h = header();
+    if (h.dtype != static_cast<uint8_t>(SpectrumDType::Float32)) {
+        return {};
+    }
+    return {reinterpret_cast<complex<float>*>(file.writableBytes() + h.spectrumOffset), h.rows, h.cols};
+}
+
+void SpectrumFileWriter::releaseRows(size_t firstRow, size_t count) const {
+    const SpectrumFileHeader& h = header();
+    size_t rowBytes = h.cols * getDTypeSize(static_cast<SpectrumDType>(h.dtype));
+    file.release(h.spectrumOffset + firstRow * rowBytes, count * rowBytes);
+}
+
+void SpectrumFileWriter::setComponents(const vector<FrequencyComponent>& components) {
+    SpectrumFileHeader& h = header();
+    size_t count = min(components.size(), capacity);
+    SpectrumFileComponent* records = reinterpret_cast<SpectrumFileComponent*>(file.writableBytes() + h.componentOffset);
+    for (size_t i = 0; i < count; ++i) {
+        records[i] = toFileComponent(components[i]);
+    }
+    h.componentCount = count;
+}
+
+bool SpectrumFileWriter::close(string& error) {
+    return file.close(error);
+}
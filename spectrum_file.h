@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <complex>
+#include <span>
+#include "fourier.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+// Binary spectrum file (.spec), little-endian:
+//   SpectrumFileHeader
+//   componentCount x SpectrumFileComponent   (top-K table, at componentOffset)
+//   rows x cols interleaved complex values    (at spectrumOffset, 64-byte aligned)
+// The component table sits right after the header so it can be read without touching the
+// spectrum. Readers reject other magic values and versions newer than spectrumFileVersion.
+
+const uint32_t spectrumFileVersion = 1;
+
+enum class SpectrumLayout : uint8_t {
+    Full,   // rows x cols complex grid
+    Half    // rows x (transformCols / 2 + 1) half-spectrum of a real input
+};
+
+enum class SpectrumDType : uint8_t {
+    Float32,
+    Float64
+};
+
+enum class SpectrumTransform : uint8_t {
+    ForwardDFT2D
+};
+
+struct SpectrumFileHeader {
+    char magic[8];              // "DRAWSPEC"
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(SpectrumFileHeader) when written
+    uint32_t rows;              // stored rows
+    uint32_t cols;              // stored columns (transformCols / 2 + 1 for a half-spectrum)
+    uint32_t transformRows;     // transform size after padding
+    uint32_t transformCols;
+    uint32_t sourceRows;        // image size before padding
+    uint32_t sourceCols;
+    uint8_t padding;            // FFTPadding
+    uint8_t transform;          // SpectrumTransform
+    uint8_t layout;             // SpectrumLayout
+    uint8_t dtype;              // SpectrumDType
+    uint32_t componentCount;
+    uint64_t componentOffset;
+    uint64_t spectrumOffset;
+    uint64_t spectrumBytes;
+};
+
+struct SpectrumFileComponent {
+    int32_t k;
+    int32_t l;
+    uint32_t flags;             // bit 0: hasConjugate
+    uint32_t reserved;
+    double amplitude;
+    double frequencyX;
+    double frequencyY;
+    double phase;
+};
+
+static_assert(sizeof(SpectrumFileHeader) == 72, "spectrum header layout changed");
+static_assert(sizeof(SpectrumFileComponent) == 48, "spectrum component layout changed");
+
+// What to record about the spectrum besides the values themselves
+struct SpectrumDescription {
+    size_t sourceRows = 0;
+    size_t sourceCols = 0;
+    size_t transformCols = 0;   // full transform width; required for a half-spectrum
+    FFTPadding padding = FFTPadding::PowerOf2;
+    SpectrumLayout layout = SpectrumLayout::Full;
+    SpectrumDType dtype = SpectrumDType::Float64;
+};
+
+// Serialise header, components and spectrum into one buffer and write it with a single write.
+// Returns false and fills error on failure.
+bool writeSpectrumFile(const string& path, const vector<vector<complex<double>>>& spectrum, const SpectrumDescription& description,
+                       const vector<FrequencyComponent>& components, string& error);
+bool writeSpectrumFile(const string& path, MatrixView<const complex<double>> spectrum, const SpectrumDescription& description,
+                       const vector<FrequencyComponent>& components, string& error);
+// A single-precision spectrum; stored as float64 it is widened, not recomputed
+bool writeSpectrumFile(const string& path, MatrixView<const complex<float>> spectrum, const SpectrumDescription& description,
+                       const vector<FrequencyComponent>& components, string& error);
+
+// Read only the header and the component table
+bool loadSpectrumComponents(const string& path, vector<FrequencyComponent>& components, string& error);
+
+// Read-only memory map of a spectrum file. Views point straight into the mapping and stay valid
+// while the object is alive.
+class MappedSpectrumFile {
+public:
+    MappedSpectrumFile() = default;
+    ~MappedSpectrumFile();
+
+    MappedSpectrumFile(const MappedSpectrumFile&) = delete;
+    MappedSpectrumFile& operator=(const MappedSpectrumFile&) = delete;
+
+    bool open(const string& path, string& error);
+    void close();
+
+    const SpectrumFileHeader& header() const { return *reinterpret_cast<const SpectrumFileHeader*>(data); }
+    span<const SpectrumFileComponent> components() const;
+
+    // Whole grid, row-major; use the view matching header().dtype (the other one is empty)
+    span<const complex<double>> spectrum64() const;
+    span<const complex<float>> spectrum32() const;
+
+    // One stored row of the grid
+    span<const complex<double>> row64(size_t r) const;
+    span<const complex<float>> row32(size_t r) const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+};
+
+// New spectrum file written in place through a writable memory map, for spectra assembled a strip
+// at a time (see streaming.h). The grid starts out all zero. Room for componentCapacity table
+// entries is reserved in front of it, and setComponents fills them in once they are known.
+class SpectrumFileWriter {
+public:
+    bool create(const string& path, size_t rows, size_t cols, const SpectrumDescription& description, size_t componentCapacity,
+                string& error);
+    // Flushes everything to disk
+    bool close(string& error);
+
+    // The grid in the description's dtype; the other one is empty
+    MatrixView<complex<double>> grid64() const;
+    MatrixView<complex<float>> grid32() const;
+
+    // Drop grid rows written so far from memory; they stay in the file
+    void releaseRows(size_t firstRow, size_t count) const;
+
+    // Keeps the first componentCapacity components
+    void setComponents(const vector<FrequencyComponent>& components);
+
+private:
+    SpectrumFileHeader& header() const;
+
+    MappedFile file;
+    size_t capacity = 0;
+};
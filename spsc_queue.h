@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+using namespace std;
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread.
+// Neither side ever blocks: tryPush fails when the ring is full, tryPop when it is empty.
+// The two indices live on separate cache lines so the threads don't false-share.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    bool tryPush(const T& item) {
+        size_t tail = tailIndex.load(memory_order_relaxed);
+        if (tail - headIndex.load(memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[tail & (Capacity - 1)] = item;
+        tailIndex.store(tail + 1, memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        size_t head = headIndex.load(memory_order_relaxed);
+        if (head == tailIndex.load(memory_order_acquire)) {
+            return false;
+        }
+        item = slots[head & (Capacity - 1)];
+        headIndex.store(head + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) atomic<size_t> headIndex{0};
+    alignas(64) atomic<size_t> tailIndex{0};
+    array<T, Capacity> slots;
+};
@@ -0,0 +1,345 @@
+#include "streaming.h"
+#include "image_io.h"
+#include "matrix.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+using namespace std;
+
+// Split [0, count) over the pool in a few chunks per thread, or run it here without one
+template <typename Body>
+static void forEachChunk(ThreadPool* pool, size_t count, const Body& body) {
+    if (!pool) {
+        body(0, count);
+        return;
+    }
+    size_t grainSize = max<size_t>(1, count / (4 * pool->concurrency()));
+    pool->parallelFor(count, grainSize, body);
+}
+
+// Thinning ------------------------------------------------------------------------------------
+
+// Pixel buffers for one strip: the strip with its halo rows, the matching delete plane and the
+// pre-pass rows carried down from the strip above
+struct ThinningStrip {
+    Matrix<uint8_t> window;
+    Matrix<uint8_t> deletePlane;
+    vector<int> rowDeleted;
+    Matrix<uint8_t> carry;
+};
+
+// One subiteration over window rows [1, rows - 1). The window edges are either image edges, which
+// are never thinned, or halo rows far enough from the strip that their errors can't reach it.
+// Returns the number of deletions in window rows [centerBegin, centerEnd); all of them go into
+// windowDeleted.
+static size_t thinWindowPhase(ThinningStrip& strip, size_t rows, int phase, size_t centerBegin, size_t centerEnd, size_t& windowDeleted,
+                              ThreadPool* pool) {
+    MatrixView<uint8_t> window = strip.window.view().block(0, 0, rows, strip.window.cols());
+    int cols = static_cast<int>(window.cols);
+    fill_n(strip.rowDeleted.begin(), rows, 0);
+    if (rows < 3) {
+        windowDeleted = 0;
+        return 0;
+    }
+    forEachChunk(pool, rows - 2, [&](size_t begin, size_t end) {
+        for (size_t r = begin + 1; r < end + 1; ++r) {
+            strip.rowDeleted[r] = markRowDeletions(window.row(r - 1), window.row(r), window.row(r + 1), cols, phase, strip.deletePlane.row(r));
+        }
+    });
+    size_t centerDeleted = 0;
+    windowDeleted = 0;
+    for (size_t r = 1; r + 1 < rows; ++r) {
+        if (strip.rowDeleted[r] > 0) {
+            applyRowDeletions(window.row(r), strip.deletePlane.row(r), cols);
+            windowDeleted += strip.rowDeleted[r];
+            if (r >= centerBegin && r < centerEnd) {
+                centerDeleted += strip.rowDeleted[r];
+            }
+        }
+    }
+    return centerDeleted;
+}
+
+bool thinImageStreaming(const string& inputPath, const string& outputPath, const StreamingOptions& options, ThinningStats* stats,
+                        string& error) {
+    TRACE_SCOPE("thinImageStreaming");
+    MappedBinaryImage input;
+    if (!input.open(inputPath, error)) {
+        return false;
+    }
+    size_t rows = input.rows();
+    size_t cols = input.cols();
+    size_t halo = max(options.haloRows, 2);
+    // Passes must hold whole iterations so every pass starts on phase one
+    size_t subiterations = halo / 2 * 2;
+
+    // Window and delete plane take a byte per pixel each; the carried rows one more
+    size_t budgetRows = options.memoryBudget / (2 * cols);
+    size_t stripRows = budgetRows > 3 * halo ? min(budgetRows - 3 * halo, rows) : 0;
+    // The halo must come from the neighbouring strips alone
+    if (stripRows < min(halo, rows)) {
+        error = "memory budget of " + to_string(options.memoryBudget) + " bytes is too small for " + to_string(cols) + "-pixel rows with " +
+                to_string(halo) + " halo rows";
+        return false;
+    }
+    MappedBinaryImage output;
+    if (!output.create(outputPath, rows, cols, error)) {
+        return false;
+    }
+
+    ThinningStrip strip;
+    strip.window = Matrix<uint8_t>(stripRows + 2 * halo, cols);
+    strip.deletePlane = Matrix<uint8_t>(stripRows + 2 * halo, cols);
+    strip.rowDeleted.assign(stripRows + 2 * halo, 0);
+    strip.carry = Matrix<uint8_t>(halo, cols);
+
+    size_t stripCount = (rows + stripRows - 1) / stripRows;
+    vector<uint8_t> changedBefore(stripCount, 1);
+    vector<uint8_t> changedNow(stripCount, 0);
+    vector<size_t> visitedPerPass, deletedPerPass;
+    long long lastChange = -1;  // last global subiteration that deleted a pixel
+
+    for (size_t pass = 0;; ++pass) {
+        TRACE_SCOPE("thinImageStreaming.pass");
+        // The first pass reads the input; later ones update the output in place
+        const MappedBinaryImage& source = pass == 0 ? input : output;
+        visitedPerPass.resize(visitedPerPass.size() + subiterations, 0);
+        deletedPerPass.resize(deletedPerPass.size() + subiterations, 0);
+        size_t passBase = pass * subiterations;
+        bool anyChanged = false;
+
+        for (size_t s = 0; s < stripCount; ++s) {
+            size_t top = s * stripRows;
+            size_t bottom = min(rows, top + stripRows);
+            size_t windowTop = top >= halo ? top - halo : 0;
+            size_t windowBottom = min(rows, bottom + halo);
+            size_t carriedRows = top - windowTop;
+            source.willNeedRows(bottom, stripRows + halo);
+
+            bool dirty = changedBefore[s] || (s > 0 && changedBefore[s - 1]) || (s + 1 < stripCount && changedBefore[s + 1]);
+            changedNow[s] = 0;
+            if (!dirty) {
+                // Unchanged since the last pass, so its rows as they stand are what the next strip needs
+                if (s + 1 < stripCount) {
+                    source.readRows(bottom - halo, strip.carry.view());
+                }
+                continue;
+            }
+
+            // Rows above the strip as they were before this pass, then the strip and the rows below,
+            // which this pass hasn't written yet
+            size_t windowRows = windowBottom - windowTop;
+            MatrixView<uint8_t> window = strip.window.view().block(0, 0, windowRows, cols);
+            for (size_t r = 0; r < carriedRows; ++r) {
+                copy_n(strip.carry.row(halo - carriedRows + r), cols, window.row(r));
+            }
+            source.readRows(top, window.block(carriedRows, 0, windowRows - carriedRows, cols));
+            if (s + 1 < stripCount) {
+                copy_n(window.row(bottom - halo - windowTop), halo * cols, strip.carry.data());
+            }
+
+            size_t centerBegin = carriedRows;
+            size_t centerEnd = bottom - windowTop;
+            // Interior pixels of the strip's own rows
+            size_t interiorBegin = max<size_t>(top, 1);
+            size_t interiorEnd = min(bottom, rows - 1);
+            size_t interiorPixels = cols > 2 && interiorEnd > interiorBegin ? (interiorEnd - interiorBegin) * (cols - 2) : 0;
+            bool quietIteration = false;
+            for (size_t j = 0; j < subiterations; ++j) {
+                size_t windowDeleted = 0;
+                size_t deleted = thinWindowPhase(strip, windowRows, j % 2, centerBegin, centerEnd, windowDeleted, options.pool);
+                visitedPerPass[passBase + j] += interiorPixels;
+                deletedPerPass[passBase + j] += deleted;
+                if (deleted > 0) {
+                    changedNow[s] = 1;
+                    lastChange = max(lastChange, static_cast<long long>(passBase + j));
+                }
+                // A whole iteration without deletions leaves the window as it is for good
+                if (j % 2 == 0) {
+                    quietIteration = windowDeleted == 0;
+                } else if (quietIteration && windowDeleted == 0) {
+                    break;
+                }
+            }
+            anyChanged = anyChanged || changedNow[s];
+
+            if (pass == 0 || changedNow[s]) {
+                output.writeRows(top, window.block(centerBegin, 0, centerEnd - centerBegin, cols));
+            }
+            source.releaseRows(windowTop, bottom - windowTop);
+            output.releaseRows(top, bottom - top);
+        }
+
+        swap(changedBefore, changedNow);
+        if (!anyChanged) {
+            break;
+        }
+    }
+
+    // thinImage stops after the first iteration without deletions
+    int iterations = lastChange < 0 ? 1 : static_cast<int>(lastChange / 2 + 2);
+    TRACE_COUNTER("thinning.iterations", iterations);
+    if (stats) {
+        stats->iterations = iterations;
+        visitedPerPass.resize(2 * iterations, 0);
+        deletedPerPass.resize(2 * iterations, 0);
+        stats->visitedPerPass.insert(stats->visitedPerPass.end(), visitedPerPass.begin(), visitedPerPass.end());
+        stats->deletedPerPass.insert(stats->deletedPerPass.end(), deletedPerPass.begin(), deletedPerPass.end());
+    }
+    return output.close(error);
+}
+
+// Transform -----------------------------------------------------------------------------------
+
+template <typename T>
+static MatrixView<complex<T>> getGrid(const SpectrumFileWriter& writer);
+
+template <>
+MatrixView<complex<double>> getGrid<double>(const SpectrumFileWriter& writer) {
+    return writer.grid64();
+}
+
+template <>
+MatrixView<complex<float>> getGrid<float>(const SpectrumFileWriter& writer) {
+    return writer.grid32();
+}
+
+// Copy source (rows x cols) into target transposed, converting element type on the way. Goes in
+// square tiles so both sides are read and written a cache line at a time.
+template <typename Target, typename Source>
+static void transposeInto(MatrixView<const Source> source, MatrixView<Target> target) {
+    const size_t tile = 32;
+    for (size_t rowBlock = 0; rowBlock < source.rows; rowBlock += tile) {
+        size_t rowEnd = min(source.rows, rowBlock + tile);
+        for (size_t colBlock = 0; colBlock < source.cols; colBlock += tile) {
+            size_t colEnd = min(source.cols, colBlock + tile);
+            for (size_t c = colBlock; c < colEnd; ++c) {
+                Target* dst = target.row(c);
+                for (size_t r = rowBlock; r < rowEnd; ++r) {
+                    dst[r] = Target(source(r, c));
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+static bool streamRealFFT(MappedBinaryImage& input, const string& outputPath, FFTPadding padding, SpectrumDType dtype, size_t topCount,
+                          const StreamingOptions& options, vector<FrequencyComponent>* components, string& error) {
+    size_t rows = input.rows();
+    size_t cols = input.cols();
+    size_t transformRows = getTransformSize(rows, padding);
+    size_t transformCols = getTransformSize(cols, padding);
+    size_t halfCols = transformCols / 2 + 1;
+
+    // Row pass: image bytes in, double half-spectrum rows out. Column pass: whole double columns.
+    size_t rowStripRows = min(rows, options.memoryBudget / (cols + halfCols * sizeof(complex<double>)));
+    size_t columnStripRows = min(halfCols, options.memoryBudget / (transformRows * sizeof(complex<double>)));
+    // Top-K sweep: strips of finished grid rows
+    size_t componentStripRows = min(transformRows, options.memoryBudget / (halfCols * sizeof(complex<T>)));
+    if (rowStripRows == 0 || columnStripRows == 0 || (topCount > 0 && componentStripRows == 0)) {
+        error = "memory budget of " + to_string(options.memoryBudget) + " bytes is too small for a " + to_string(transformRows) + " x " +
+                to_string(transformCols) + " transform";
+        return false;
+    }
+
+    // The row spectra go to disk transposed, halfCols rows of transformRows values; padding rows
+    // stay zero
+    string columnsPath = outputPath + ".columns";
+    MappedFile columnsFile;
+    if (!columnsFile.create(columnsPath, halfCols * transformRows * sizeof(complex<T>), error)) {
+        return false;
+    }
+    MatrixView<complex<T>> columns(reinterpret_cast<complex<T>*>(columnsFile.writableBytes()), halfCols, transformRows);
+
+    {
+        TRACE_SCOPE("DFT2DRealFFTStreaming.rows");
+        Matrix<uint8_t> pixels(rowStripRows, cols);
+        Matrix<complex<double>> halfRows(rowStripRows, halfCols);
+        for (size_t top = 0; top < rows; top += rowStripRows) {
+            size_t count = min(rowStripRows, rows - top);
+            input.willNeedRows(top + count, rowStripRows);
+            MatrixView<uint8_t> strip = pixels.view().block(0, 0, count, cols);
+            input.readRows(top, strip);
+            DFT2DRealFFTRows(strip, halfRows.view(), transformCols, options.pool);
+            transposeInto<complex<T>>(MatrixView<const complex<double>>(halfRows.view().block(0, 0, count, halfCols)),
+                                      columns.block(0, top, halfCols, count));
+            input.releaseRows(top, count);
+            columnsFile.release(0, columnsFile.size());
+        }
+    }
+
+    SpectrumDescription description;
+    description.sourceRows = rows;
+    description.sourceCols = cols;
+    description.transformCols = transformCols;
+    description.padding = padding;
+    description.layout = SpectrumLayout::Half;
+    description.dtype = dtype;
+    SpectrumFileWriter writer;
+    if (!writer.create(outputPath, transformRows, halfCols, description, topCount, error)) {
+        columnsFile.close();
+        filesystem::remove(columnsPath);
+        return false;
+    }
+    MatrixView<complex<T>> grid = getGrid<T>(writer);
+
+    {
+        TRACE_SCOPE("DFT2DRealFFTStreaming.columns");
+        const FFTPlan& plan = getFFTPlan(transformRows);
+        Matrix<complex<double>> strip(columnStripRows, transformRows);
+        for (size_t first = 0; first < halfCols; first += columnStripRows) {
+            size_t count = min(columnStripRows, halfCols - first);
+            size_t rowBytes = transformRows * sizeof(complex<T>);
+            columnsFile.willNeed((first + count) * rowBytes, columnStripRows * rowBytes);
+            for (size_t i = 0; i < count; ++i) {
+                const complex<T>* column = columns.row(first + i);
+                copy(column, column + transformRows, strip.row(i));
+            }
+            forEachChunk(options.pool, count, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    executeFFT(plan, strip.row(i));
+                }
+            });
+            transposeInto<complex<T>>(MatrixView<const complex<double>>(strip.view().block(0, 0, count, transformRows)),
+                                      grid.block(0, first, transformRows, count));
+            columnsFile.release(first * rowBytes, count * rowBytes);
+            writer.releaseRows(0, transformRows);
+        }
+    }
+    columnsFile.close();
+    filesystem::remove(columnsPath);
+
+    // One read-only sweep over the finished grid, a strip at a time into a running top-K
+    vector<FrequencyComponent> strongest;
+    if (topCount > 0) {
+        TRACE_SCOPE("DFT2DRealFFTStreaming.components");
+        TopFrequencyCollector collector(topCount, transformRows, transformCols);
+        for (size_t top = 0; top < transformRows; top += componentStripRows) {
+            size_t count = min(componentStripRows, transformRows - top);
+            collector.addRows(MatrixView<const complex<T>>(grid.block(top, 0, count, halfCols)), top);
+            writer.releaseRows(top, count);
+        }
+        strongest = collector.finish();
+        writer.setComponents(strongest);
+    }
+    if (components) {
+        *components = std::move(strongest);
+    }
+    return writer.close(error);
+}
+
+bool DFT2DRealFFTStreaming(const string& inputPath, const string& outputPath, FFTPadding padding, SpectrumDType dtype, size_t topCount,
+                           const StreamingOptions& options, vector<FrequencyComponent>* components, string& error) {
+    TRACE_SCOPE("DFT2DRealFFTStreaming");
+    MappedBinaryImage input;
+    if (!input.open(inputPath, error)) {
+        return false;
+    }
+    if (dtype == SpectrumDType::Float32) {
+        return streamRealFFT<float>(input, outputPath, padding, dtype, topCount, options, components, error);
+    }
+    return streamRealFFT<double>(input, outputPath, padding, dtype, topCount, options, components, error);
+}
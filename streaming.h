@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <vector>
+#include "thinning.h"
+#include "spectrum_file.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+// Out-of-core thinning and transform for scans too large to hold in memory (a 50k x 50k page is
+// 2.5 GB even at one byte per pixel). Images stay in memory-mapped files (see MappedBinaryImage)
+// and are processed a strip of rows at a time. Strip heights follow from the memory budget, so
+// the buffers stay the same size however large the image is; pages of the mapped files are
+// dropped as soon as a strip is done with them.
+
+struct StreamingOptions {
+    size_t memoryBudget = size_t(256) << 20;    // bytes for strip buffers
+    int haloRows = 16;                          // thinning rows carried above and below each strip
+    ThreadPool* pool = nullptr;                 // rows of a strip are thinned and transformed on it
+};
+
+// Zhang-Suen thinning of inputPath (raw PBM, PGM or PPM) into outputPath, a new P4 bitmap, with
+// the same result as thinImage. Each pass sweeps the image strip by strip, reading every strip
+// with haloRows extra rows on both sides and running haloRows subiterations on it (rounded down to
+// whole iterations); a deletion travels one row per subiteration, so the strip's own rows come out
+// exactly as a whole-image run would leave them. Passes update the output in place, carrying the
+// untouched bottom rows of each strip to the next one. A strip is skipped once neither it nor a
+// neighbour changed in the previous pass, and a strip stops early after an iteration with no
+// deletions in its window; the run ends with a pass that changes nothing. In stats, iterations
+// and deletedPerPass match thinImage. visitedPerPass is lower: skipped strips count as not visited,
+// and so do the remaining subiterations of a strip that stops early. Returns false and fills
+// error on failure.
+bool thinImageStreaming(const string& inputPath, const string& outputPath, const StreamingOptions& options, ThinningStats* stats,
+                        string& error);
+
+// DFT2DRealFFT of inputPath (raw PBM, PGM or PPM) written to outputPath as a half-spectrum .spec
+// file in dtype, with the topCount strongest components in its table (and in components when
+// given). Runs as a row pass, a blocked transpose through outputPath.columns on disk, a column
+// pass and a blocked transpose into the output grid; the components are then ranked a strip of
+// grid rows at a time. Transforms are computed in double precision, but with Float32 the
+// intermediate file is single precision too. The intermediate file is removed afterwards. Returns false and fills error on failure.
+bool DFT2DRealFFTStreaming(const string& inputPath, const string& outputPath, FFTPadding padding, SpectrumDType dtype, size_t topCount,
+                           const StreamingOptions& options, vector<FrequencyComponent>* components, string& error);
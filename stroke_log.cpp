@@ -0,0 +1,47 @@
+#include "stroke_log.h"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+static int16_t clampCoordinate(int value) {
+    return static_cast<int16_t>(clamp(value, static_cast<int>(INT16_MIN), static_cast<int>(INT16_MAX)));
+}
+
+void StrokeLog::addSegment(int x0, int y0, int x1, int y1) {
+    segments.push_back({clampCoordinate(x0), clampCoordinate(y0), clampCoordinate(x1), clampCoordinate(y1)});
+}
+
+StrokeRaster rasterizeStrokes(const StrokeLog& log, int clipWidth, int clipHeight, int margin) {
+    StrokeRaster raster;
+
+    // Bresenham never leaves the box spanned by a segment's end points
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    for (const StrokeSegment& s : log.segments) {
+        minX = min({minX, static_cast<int>(s.x0), static_cast<int>(s.x1)});
+        maxX = max({maxX, static_cast<int>(s.x0), static_cast<int>(s.x1)});
+        minY = min({minY, static_cast<int>(s.y0), static_cast<int>(s.y1)});
+        maxY = max({maxY, static_cast<int>(s.y0), static_cast<int>(s.y1)});
+    }
+    minX = max(minX, 0);
+    minY = max(minY, 0);
+    maxX = min(maxX, clipWidth - 1);
+    maxY = min(maxY, clipHeight - 1);
+    if (log.empty() || minX > maxX || minY > maxY) {
+        return raster;
+    }
+
+    raster.originX = minX - margin;
+    raster.originY = minY - margin;
+    raster.image = BinaryImage(maxY - minY + 1 + 2 * margin, maxX - minX + 1 + 2 * margin);
+    BinaryImage& image = raster.image;
+
+    for (const StrokeSegment& s : log.segments) {
+        forEachSegmentPixel(s, [&](int x, int y) {
+            if (x >= minX && x <= maxX && y >= minY && y <= maxY) {
+                image.at(y - raster.originY, x - raster.originX) = 1;
+            }
+        });
+    }
+    return raster;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "binary_image.h"
+
+using namespace std;
+
+// One mouse-motion line in window coordinates, both ends inclusive
+struct StrokeSegment {
+    int16_t x0, y0, x1, y1;
+};
+
+// Everything drawn during a session, in drawing order (8 bytes per segment)
+struct StrokeLog {
+    vector<StrokeSegment> segments;
+
+    void addSegment(int x0, int y0, int x1, int y1);
+    void clear() { segments.clear(); }
+    bool empty() const { return segments.empty(); }
+};
+
+// Call plot(x, y) for every pixel of the Bresenham line from (x0, y0) to (x1, y1), both ends
+// included. This is the pixel set the software renderer draws for the segment.
+template <typename Plot>
+void forEachSegmentPixel(const StrokeSegment& s, Plot plot) {
+    int x = s.x0, y = s.y0;
+    int dx = s.x1 > s.x0 ? s.x1 - s.x0 : s.x0 - s.x1;
+    int dy = s.y1 > s.y0 ? s.y0 - s.y1 : s.y1 - s.y0;
+    int stepX = s.x0 < s.x1 ? 1 : -1;
+    int stepY = s.y0 < s.y1 ? 1 : -1;
+    int error = dx + dy;
+    while (true) {
+        plot(x, y);
+        if (x == s.x1 && y == s.y1) {
+            break;
+        }
+        int doubled = 2 * error;
+        if (doubled >= dy) {
+            error += dy;
+            x += stepX;
+        }
+        if (doubled <= dx) {
+            error += dx;
+            y += stepY;
+        }
+    }
+}
+
+// Strokes rasterised into a plane covering only their bounding box plus margin.
+// Pixel (r, c) of image is window pixel (originY + r, originX + c).
+struct StrokeRaster {
+    BinaryImage image;
+    int originX = 0;
+    int originY = 0;
+};
+
+// Draw every segment with forEachSegmentPixel, clipped to the clipWidth x clipHeight window.
+// The margin keeps strokes off the image border, which the thinning pass never touches. An empty log, or one entirely outside the window, gives a 0 x 0 image.
+StrokeRaster rasterizeStrokes(const StrokeLog& log, int clipWidth, int clipHeight, int margin = 1);
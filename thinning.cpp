@@ -1,179 +1,556 @@
-#include "thinning.h"
-#include <vector>
-#include <tuple>
-
-using namespace std;
-
-//Implement Zhang-Suen Algorithm
-vector<vector<int>> createSkeleton(vector<vector<int>>& pixelMatrix)    {
-    bool changesMade = true;
-    vector<tuple<int,int>> markedPixels;
-    while(changesMade)  {
-        markedPixels = getMarkedPixelsPhaseOne(pixelMatrix);
-        updatePixels(pixelMatrix, markedPixels);
-        changesMade = markedPixels.size() > 0;
-        markedPixels = getMarkedPixelsPhaseTwo(pixelMatrix);
-        updatePixels(pixelMatrix, markedPixels);
-        changesMade = changesMade || markedPixels.size() > 0;
-    }
-    return pixelMatrix;    
-}
-
-vector<tuple<int,int>> getMarkedPixelsPhaseOne(vector<vector<int>>& pixelMatrix)    {
-    vector<tuple<int,int>> markedPixels;
-    for(size_t r = 0; r < pixelMatrix.size(); ++r) {
-        for(size_t c = 0; c < pixelMatrix[0].size(); ++c)  {
-            if(satisfiesPhaseOneConditions(pixelMatrix, r, c)) {
-                markedPixels.push_back(make_tuple(r, c));
-            }
-        }
-    }
-
-    return markedPixels; 
-}
-
-vector<tuple<int,int>> getMarkedPixelsPhaseTwo(vector<vector<int>>& pixelMatrix)    {
-    vector<tuple<int,int>> markedPixels;
-    for(size_t r = 0; r < pixelMatrix.size(); ++r) {
-        for(size_t c = 0; c < pixelMatrix[0].size(); ++c)  {
-            if(satisfiesPhaseTwoConditions(pixelMatrix, r, c)) {
-                markedPixels.push_back(make_tuple(r, c));
-            }
-        }
-    }
-
-    return markedPixels; 
-}
-
-vector<int> getNeighbors(vector<vector<int>>& pixelMatrix, int row, int col) {
-    vector<int> neighbors;
-
-    // Define offsets for neighbors in clockwise order (P2 to P9)
-    int rowOffsets[] = {-1, -1, 0, 1, 1, 1, 0, -1};  // Top, top-right, right, bottom-right, bottom, bottom-left, left, top-left
-    int colOffsets[] = {0, 1, 1, 1, 0, -1, -1, -1};
-
-    // Loop through each offset
-    for (size_t i = 0; i < 8; ++i) {
-        int neighborRow = row + rowOffsets[i];
-        int neighborCol = col + colOffsets[i];
-        
-        if (isValidNeighbor(pixelMatrix, neighborRow, neighborCol, row, col)) {
-            neighbors.push_back(pixelMatrix[neighborRow][neighborCol]);
-        }
-    }
-
-    return neighbors;
-}
-
-bool isValidNeighbor(vector<vector<int>>& pixelMatrix, int r, int c, int row, int col) {
-    if ((r == row && c == col) || (r < 0 || r >= static_cast<int>(pixelMatrix.size())) || (c < 0 || c >= static_cast<int>(pixelMatrix[0].size()))) {
-        return false;
-    }
-    return true;
-}
-
-
-bool satisfiesPhaseOneConditions(vector<vector<int>>& pixelMatrix, int row, int col)  {
-    //Pixel must be black to be deleted
-    if(pixelMatrix[row][col] == 0)  {
-        return false;
-    }
-
-    //Pixel must have 8 neighbors (not on a boundary)
-    vector<int> neighbors = getNeighbors(pixelMatrix, row, col);
-    if(neighbors.size() < 8) {
-        return false;
-    }
-
-    //Must have between 2 and 6 black neighbors
-    int blackCount = 0;
-    for(int neighbor : neighbors)   {
-        if(neighbor == 1)   {
-            ++blackCount;
-        }
-    }
-    if(blackCount < 2 || blackCount > 6)    {
-        return false;
-    }
-
-    //Count transitions in a clockwise loop starting from top neighbor. Must be 1.
-    int transitionCount = 0;
-    for (size_t i = 0; i < neighbors.size(); ++i) {
-        int curr = neighbors[i];
-        int next = neighbors[(i + 1) % neighbors.size()]; // Wrap around
-        if (curr == 0 && next == 1) {
-            ++transitionCount;
-        }
-    }
-    if (transitionCount != 1) {
-        return false;
-    }
-
-    //At least one of P2 and P4 and P6 is white
-    if(neighbors[0] != 0 && neighbors[2] != 0 && neighbors[4] != 0) {
-        return false;
-    }
-
-    //At least one of P4 and P6 and P8 is white
-    if(neighbors[2] != 0 && neighbors[4] != 0 && neighbors[6] != 0) {
-        return false;
-    }
-    return true;
-}
-
-bool satisfiesPhaseTwoConditions(vector<vector<int>>& pixelMatrix, int row, int col)  {
-    //Pixel must be black to be deleted
-    if(pixelMatrix[row][col] == 0)  {
-        return false;
-    }
-
-    //Pixel must have 8 neighbors (not on a boundary)
-    vector<int> neighbors = getNeighbors(pixelMatrix, row, col);
-    if(neighbors.size() < 8) {
-        return false;
-    }
-
-    //Must have between 2 and 6 black neighbors
-    int blackCount = 0;
-    for(int neighbor : neighbors)   {
-        if(neighbor == 1)   {
-            ++blackCount;
-        }
-    }
-    if(blackCount < 2 || blackCount > 6)    {
-        return false;
-    }
-
-    //Count transitions in a clockwise loop starting from top neighbor. Must be 1.
-    int transitionCount = 0;
-    for (size_t i = 0; i < neighbors.size(); ++i) {
-        int curr = neighbors[i];
-        int next = neighbors[(i + 1) % neighbors.size()];
-        if (curr == 0 && next == 1) {
-            ++transitionCount;
-        }
-    }
-
-    if (transitionCount != 1) {
-        return false;
-    }
-
-    //At least one of P2 and P4 and P8 is white
-    if(neighbors[0] != 0 && neighbors[2] != 0 && neighbors[6] != 0) {
-        return false;
-    }
-
-    //At least one of P2 and P6 and P8 is white
-    if(neighbors[0] != 0 && neighbors[4] != 0 && neighbors[6] != 0) {
-        return false;
-    }
-    
-    return true;
-}
-
-//Update pixels based on markedPixels
-void updatePixels(vector<vector<int>>& pixelMatrix, vector<tuple<int,int>>& markedPixels) {
-    for(tuple<int,int> coord : markedPixels)    {
-        pixelMatrix[get<0>(coord)][get<1>(coord)] = 0;
-    }
+#include "thinning.h"
+#include "trace.h"
+#include <vector>
+#include <tuple>
+#include <array>
+#include <barrier>
+#include <thread>
+
+using namespace std;
+
+//Zhang-Suen on the nested int matrix. Kept as the reference the table-driven engine is diffed against.
+vector<vector<int>> createSkeletonReference(vector<vector<int>>& pixelMatrix)    {
+    bool changesMade = true;
+    vector<tuple<int,int>> markedPixels;
+    while(changesMade)  {
+        markedPixels = getMarkedPixelsPhaseOne(pixelMatrix);
+        updatePixels(pixelMatrix, markedPixels);
+        changesMade = markedPixels.size() > 0;
+        markedPixels = getMarkedPixelsPhaseTwo(pixelMatrix);
+        updatePixels(pixelMatrix, markedPixels);
+        changesMade = changesMade || markedPixels.size() > 0;
+    }
+    return pixelMatrix;    
+}
+
+vector<tuple<int,int>> getMarkedPixelsPhaseOne(vector<vector<int>>& pixelMatrix)    {
+    vector<tuple<int,int>> markedPixels;
+    for(size_t r = 0; r < pixelMatrix.size(); ++r) {
+        for(size_t c = 0; c < pixelMatrix[0].size(); ++c)  {
+            if(satisfiesPhaseOneConditions(pixelMatrix, r, c)) {
+                markedPixels.push_back(make_tuple(r, c));
+            }
+        }
+    }
+
+    return markedPixels; 
+}
+
+vector<tuple<int,int>> getMarkedPixelsPhaseTwo(vector<vector<int>>& pixelMatrix)    {
+    vector<tuple<int,int>> markedPixels;
+    for(size_t r = 0; r < pixelMatrix.size(); ++r) {
+        for(size_t c = 0; c < pixelMatrix[0].size(); ++c)  {
+            if(satisfiesPhaseTwoConditions(pixelMatrix, r, c)) {
+                markedPixels.push_back(make_tuple(r, c));
+            }
+        }
+    }
+
+    return markedPixels; 
+}
+
+vector<int> getNeighbors(vector<vector<int>>& pixelMatrix, int row, int col) {
+    vector<int> neighbors;
+
+    // Define offsets for neighbors in clockwise order (P2 to P9)
+    int rowOffsets[] = {-1, -1, 0, 1, 1, 1, 0, -1};  // Top, top-right, right, bottom-right, bottom, bottom-left, left, top-left
+    int colOffsets[] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+    // Loop through each offset
+    for (size_t i = 0; i < 8; ++i) {
+        int neighborRow = row + rowOffsets[i];
+        int neighborCol = col + colOffsets[i];
+        
+        if (isValidNeighbor(pixelMatrix, neighborRow, neighborCol, row, col)) {
+            neighbors.push_back(pixelMatrix[neighborRow][neighborCol]);
+        }
+    }
+
+    return neighbors;
+}
+
+bool isValidNeighbor(vector<vector<int>>& pixelMatrix, int r, int c, int row, int col) {
+    if ((r == row && c == col) || (r < 0 || r >= static_cast<int>(pixelMatrix.size())) || (c < 0 || c >= static_cast<int>(pixelMatrix[0].size()))) {
+        return false;
+    }
+    return true;
+}
+
+
+bool satisfiesPhaseOneConditions(vector<vector<int>>& pixelMatrix, int row, int col)  {
+    //Pixel must be black to be deleted
+    if(pixelMatrix[row][col] == 0)  {
+        return false;
+    }
+
+    //Pixel must have 8 neighbors (not on a boundary)
+    vector<int> neighbors = getNeighbors(pixelMatrix, row, col);
+    if(neighbors.size() < 8) {
+        return false;
+    }
+
+    //Must have between 2 and 6 black neighbors
+    int blackCount = 0;
+    for(int neighbor : neighbors)   {
+        if(neighbor == 1)   {
+            ++blackCount;
+        }
+    }
+    if(blackCount < 2 || blackCount > 6)    {
+        return false;
+    }
+
+    //Count transitions in a clockwise loop starting from top neighbor. Must be 1.
+    int transitionCount = 0;
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+        int curr = neighbors[i];
+        int next = neighbors[(i + 1) % neighbors.size()]; // Wrap around
+        if (curr == 0 && next == 1) {
+            ++transitionCount;
+        }
+    }
+    if (transitionCount != 1) {
+        return false;
+    }
+
+    //At least one of P2 and P4 and P6 is white
+    if(neighbors[0] != 0 && neighbors[2] != 0 && neighbors[4] != 0) {
+        return false;
+    }
+
+    //At least one of P4 and P6 and P8 is white
+    if(neighbors[2] != 0 && neighbors[4] != 0 && neighbors[6] != 0) {
+        return false;
+    }
+    return true;
+}
+
+bool satisfiesPhaseTwoConditions(vector<vector<int>>& pixelMatrix, int row, int col)  {
+    //Pixel must be black to be deleted
+    if(pixelMatrix[row][col] == 0)  {
+        return false;
+    }
+
+    //Pixel must have 8 neighbors (not on a boundary)
+    vector<int> neighbors = getNeighbors(pixelMatrix, row, col);
+    if(neighbors.size() < 8) {
+        return false;
+    }
+
+    //Must have between 2 and 6 black neighbors
+    int blackCount = 0;
+    for(int neighbor : neighbors)   {
+        if(neighbor == 1)   {
+            ++blackCount;
+        }
+    }
+    if(blackCount < 2 || blackCount > 6)    {
+        return false;
+    }
+
+    //Count transitions in a clockwise loop starting from top neighbor. Must be 1.
+    int transitionCount = 0;
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+        int curr = neighbors[i];
+        int next = neighbors[(i + 1) % neighbors.size()];
+        if (curr == 0 && next == 1) {
+            ++transitionCount;
+        }
+    }
+
+    if (transitionCount != 1) {
+        return false;
+    }
+
+    //At least one of P2 and P4 and P8 is white
+    if(neighbors[0] != 0 && neighbors[2] != 0 && neighbors[6] != 0) {
+        return false;
+    }
+
+    //At least one of P2 and P6 and P8 is white
+    if(neighbors[0] != 0 && neighbors[4] != 0 && neighbors[6] != 0) {
+        return false;
+    }
+    
+    return true;
+}
+
+//Update pixels based on markedPixels
+void updatePixels(vector<vector<int>>& pixelMatrix, vector<tuple<int,int>>& markedPixels) {
+    for(tuple<int,int> coord : markedPixels)    {
+        pixelMatrix[get<0>(coord)][get<1>(coord)] = 0;
+    }
+}
+
+//Implement Zhang-Suen Algorithm on a binary plane, thinning pixelMatrix in place
+vector<vector<int>> createSkeleton(vector<vector<int>>& pixelMatrix, ThinningMode mode, ThinningStats* stats)    {
+    BinaryImage image = toBinaryImage(pixelMatrix);
+    if(mode == ThinningMode::Frontier)  {
+        thinImageFrontier(image, stats);
+    } else {
+        thinImage(image, stats);
+    }
+    copyToPixelMatrix(image, pixelMatrix);
+    return pixelMatrix;
+}
+
+//Evaluate the Zhang-Suen conditions for one neighbour mask (bit i = P(i+2))
+static constexpr bool maskSatisfiesPhase(unsigned mask, int phase)   {
+    //Must have between 2 and 6 black neighbors
+    int blackCount = 0;
+    for(int i = 0; i < 8; ++i)  {
+        blackCount += (mask >> i) & 1;
+    }
+    if(blackCount < 2 || blackCount > 6)    {
+        return false;
+    }
+
+    //Count transitions in a clockwise loop starting from top neighbor. Must be 1.
+    int transitionCount = 0;
+    for(int i = 0; i < 8; ++i)  {
+        bool curr = (mask >> i) & 1;
+        bool next = (mask >> ((i + 1) % 8)) & 1;
+        if(!curr && next)   {
+            ++transitionCount;
+        }
+    }
+    if(transitionCount != 1)    {
+        return false;
+    }
+
+    bool p2 = mask & 0x01, p4 = mask & 0x04, p6 = mask & 0x10, p8 = mask & 0x40;
+    if(phase == 1)  {
+        //At least one of P2, P4, P6 and one of P4, P6, P8 is white
+        return !(p2 && p4 && p6) && !(p4 && p6 && p8);
+    }
+    //At least one of P2, P4, P8 and one of P2, P6, P8 is white
+    return !(p2 && p4 && p8) && !(p2 && p6 && p8);
+}
+
+static constexpr array<bool, 256> buildPhaseTable(int phase)    {
+    array<bool, 256> table{};
+    for(unsigned mask = 0; mask < 256; ++mask)  {
+        table[mask] = maskSatisfiesPhase(mask, phase);
+    }
+    return table;
+}
+
+static constexpr array<bool, 256> phaseOneTable = buildPhaseTable(1);
+static constexpr array<bool, 256> phaseTwoTable = buildPhaseTable(2);
+
+bool isDeletablePhaseOne(uint8_t neighborMask)  {
+    return phaseOneTable[neighborMask];
+}
+
+bool isDeletablePhaseTwo(uint8_t neighborMask)  {
+    return phaseTwoTable[neighborMask];
+}
+
+uint8_t getNeighborMask(const BinaryImage& image, int row, int col)    {
+    return getNeighborMask(image.view(), row, col);
+}
+
+uint8_t getNeighborMask(MatrixView<const uint8_t> image, int row, int col)    {
+    const uint8_t* above = image.row(row - 1);
+    const uint8_t* curr = image.row(row);
+    const uint8_t* below = image.row(row + 1);
+    return above[col]
+        | above[col + 1] << 1
+        | curr[col + 1] << 2
+        | below[col + 1] << 3
+        | below[col] << 4
+        | below[col - 1] << 5
+        | curr[col - 1] << 6
+        | above[col - 1] << 7;
+}
+
+//Write the delete mask of rows [rowBegin, rowEnd) with the row kernel. Only reads the image, so bands can be marked concurrently.
+//deletePlane is rows x cols with no padding, whatever the stride of the image.
+static size_t markRowRange(MatrixView<const uint8_t> image, int phase, int rowBegin, int rowEnd, uint8_t* deletePlane, int* rowDeleted)  {
+    size_t deleted = 0;
+    int cols = static_cast<int>(image.cols);
+    for(int r = rowBegin; r < rowEnd; ++r) {
+        uint8_t* deleteRow = deletePlane + static_cast<size_t>(r) * cols;
+        rowDeleted[r] = markRowDeletions(image.row(r - 1), image.row(r), image.row(r + 1), cols, phase, deleteRow);
+        deleted += rowDeleted[r];
+    }
+    return deleted;
+}
+
+//Clear the marked pixels of rows [rowBegin, rowEnd), skipping rows with nothing to delete
+static void applyRowRange(MatrixView<uint8_t> image, int rowBegin, int rowEnd, const uint8_t* deletePlane, const int* rowDeleted)  {
+    int cols = static_cast<int>(image.cols);
+    for(int r = rowBegin; r < rowEnd; ++r) {
+        if(rowDeleted[r] > 0)   {
+            applyRowDeletions(image.row(r), deletePlane + static_cast<size_t>(r) * cols, cols);
+        }
+    }
+}
+
+//Mark deletable pixels of one subiteration, then clear them. Edge pixels never have 8 neighbors and are skipped.
+static size_t thinPhase(MatrixView<uint8_t> image, int phase, uint8_t* deletePlane, int* rowDeleted)  {
+    int rows = static_cast<int>(image.rows);
+    size_t deleted = markRowRange(image, phase, 1, rows - 1, deletePlane, rowDeleted);
+    if(deleted > 0) {
+        applyRowRange(image, 1, rows - 1, deletePlane, rowDeleted);
+    }
+    return deleted;
+}
+
+static void recordPass(ThinningStats* stats, size_t visited, size_t deleted)  {
+    TRACE_COUNTER("thinning.visited", visited);
+    TRACE_COUNTER("thinning.deleted", deleted);
+    if(stats)   {
+        stats->visitedPerPass.push_back(visited);
+        stats->deletedPerPass.push_back(deleted);
+    }
+}
+
+int thinImage(BinaryImage& image, ThinningStats* stats)   {
+    return thinImage(image.view(), stats);
+}
+
+int thinImage(MatrixView<uint8_t> image, ThinningStats* stats, Arena* scratch)   {
+    TRACE_SCOPE("thinImage");
+    //Scratch planes come from the arena when there is one, so repeated calls don't touch the heap
+    vector<uint8_t> ownedDeletePlane;
+    vector<int> ownedRowDeleted;
+    uint8_t* deletePlane;
+    int* rowDeleted;
+    if(scratch) {
+        deletePlane = scratch->allocateArray<uint8_t>(image.rows * image.cols);
+        rowDeleted = scratch->allocateArray<int>(image.rows);
+        fill_n(deletePlane, image.rows * image.cols, 0);
+        fill_n(rowDeleted, image.rows, 0);
+    } else {
+        ownedDeletePlane.assign(image.rows * image.cols, 0);
+        ownedRowDeleted.assign(image.rows, 0);
+        deletePlane = ownedDeletePlane.data();
+        rowDeleted = ownedRowDeleted.data();
+    }
+    size_t interiorPixels = image.rows > 2 && image.cols > 2 ? (image.rows - 2) * (image.cols - 2) : 0;
+    int iterations = 0;
+    bool changesMade = true;
+    while(changesMade)  {
+        size_t deleted = thinPhase(image, 0, deletePlane, rowDeleted);
+        recordPass(stats, interiorPixels, deleted);
+        changesMade = deleted > 0;
+        deleted = thinPhase(image, 1, deletePlane, rowDeleted);
+        recordPass(stats, interiorPixels, deleted);
+        changesMade = changesMade || deleted > 0;
+        ++iterations;
+    }
+    TRACE_COUNTER("thinning.iterations", iterations);
+    if(stats)   {
+        stats->iterations = iterations;
+    }
+    return iterations;
+}
+
+//Worklist of pixels whose neighbourhood changed since they were last examined in a given phase.
+//A pixel that was found undeletable keeps that answer until one of its neighbours is removed,
+//so only those neighbours need to be examined again.
+struct ThinningFrontier {
+    static constexpr uint8_t phaseOneBit = 1;
+    static constexpr uint8_t phaseTwoBit = 2;
+
+    uint8_t* queued = nullptr;         // phase bits of pixels currently on a worklist, indexed r * stride + c
+    vector<uint32_t> worklists[2];
+
+    void push(size_t index) {
+        if(!(queued[index] & phaseOneBit))  {
+            queued[index] |= phaseOneBit;
+            worklists[0].push_back(static_cast<uint32_t>(index));
+        }
+        if(!(queued[index] & phaseTwoBit))  {
+            queued[index] |= phaseTwoBit;
+            worklists[1].push_back(static_cast<uint32_t>(index));
+        }
+    }
+};
+
+//Run one subiteration over the phase worklist, then re-queue the black interior neighbours of every removed pixel
+static size_t thinPhaseFrontier(MatrixView<uint8_t> image, const array<bool, 256>& table, int phase, ThinningFrontier& frontier,
+                                vector<uint32_t>& candidates, vector<size_t>& markedPixels, size_t& visited)  {
+    uint8_t phaseBit = phase == 0 ? ThinningFrontier::phaseOneBit : ThinningFrontier::phaseTwoBit;
+    candidates.clear();
+    swap(candidates, frontier.worklists[phase]);
+    visited = candidates.size();
+
+    markedPixels.clear();
+    for(uint32_t index : candidates)    {
+        frontier.queued[index] &= ~phaseBit;
+        int r = index / image.stride;
+        int c = index % image.stride;
+        if(image.data[index] && table[getNeighborMask(image, r, c)])  {
+            markedPixels.push_back(index);
+        }
+    }
+
+    for(size_t index : markedPixels)    {
+        image.data[index] = 0;
+    }
+
+    int rows = static_cast<int>(image.rows);
+    int cols = static_cast<int>(image.cols);
+    int rowOffsets[] = {-1, -1, 0, 1, 1, 1, 0, -1};
+    int colOffsets[] = {0, 1, 1, 1, 0, -1, -1, -1};
+    for(size_t index : markedPixels)    {
+        int r = index / image.stride;
+        int c = index % image.stride;
+        for(int i = 0; i < 8; ++i)  {
+            int nr = r + rowOffsets[i];
+            int nc = c + colOffsets[i];
+            if(nr < 1 || nr >= rows - 1 || nc < 1 || nc >= cols - 1)    {
+                continue;
+            }
+            size_t neighbor = static_cast<size_t>(nr) * image.stride + nc;
+            if(image.data[neighbor])  {
+                frontier.push(neighbor);
+            }
+        }
+    }
+    return markedPixels.size();
+}
+
+int thinImageFrontier(BinaryImage& image, ThinningStats* stats)   {
+    return thinImageFrontier(image.view(), stats);
+}
+
+int thinImageFrontier(MatrixView<uint8_t> image, ThinningStats* stats, Arena* scratch)   {
+    TRACE_SCOPE("thinImageFrontier");
+    ThinningFrontier frontier;
+    size_t planeSize = image.rows > 0 ? (image.rows - 1) * image.stride + image.cols : 0;
+    vector<uint8_t> ownedQueued;
+    if(scratch) {
+        frontier.queued = scratch->allocateArray<uint8_t>(planeSize);
+        fill_n(frontier.queued, planeSize, 0);
+    } else {
+        ownedQueued.assign(planeSize, 0);
+        frontier.queued = ownedQueued.data();
+    }
+
+    //Seed with the foreground boundary. Pixels whose 8 neighbours are all black can't be deleted in either phase.
+    int rows = static_cast<int>(image.rows);
+    int cols = static_cast<int>(image.cols);
+    for(int r = 1; r < rows - 1; ++r) {
+        const uint8_t* curr = image.row(r);
+        for(int c = 1; c < cols - 1; ++c) {
+            if(curr[c] && getNeighborMask(image, r, c) != 0xFF)  {
+                frontier.push(static_cast<size_t>(r) * image.stride + c);
+            }
+        }
+    }
+
+    vector<uint32_t> candidates;
+    vector<size_t> markedPixels;
+    size_t visited = 0;
+    int iterations = 0;
+    bool changesMade = true;
+    while(changesMade)  {
+        size_t deleted = thinPhaseFrontier(image, phaseOneTable, 0, frontier, candidates, markedPixels, visited);
+        recordPass(stats, visited, deleted);
+        changesMade = deleted > 0;
+        deleted = thinPhaseFrontier(image, phaseTwoTable, 1, frontier, candidates, markedPixels, visited);
+        recordPass(stats, visited, deleted);
+        changesMade = changesMade || deleted > 0;
+        ++iterations;
+    }
+    TRACE_COUNTER("thinning.iterations", iterations);
+    if(stats)   {
+        stats->iterations = iterations;
+    }
+    return iterations;
+}
+
+vector<vector<int>> createSkeletonParallel(vector<vector<int>>& pixelMatrix, int threadCount, ThinningStats* stats)    {
+    BinaryImage image = toBinaryImage(pixelMatrix);
+    thinImageParallel(image, threadCount, stats);
+    copyToPixelMatrix(image, pixelMatrix);
+    return pixelMatrix;
+}
+
+int thinImageParallel(BinaryImage& image, int threadCount, ThinningStats* stats)   {
+    return thinImageParallel(image.view(), threadCount, stats);
+}
+
+int thinImageParallel(MatrixView<uint8_t> image, int threadCount, ThinningStats* stats)   {
+    TRACE_SCOPE("thinImageParallel");
+    if(threadCount <= 0)    {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+    //Interior rows 1..rows-2 are split into one band per worker. Bands smaller than a few rows aren't worth a thread.
+    int interiorRows = max(0, static_cast<int>(image.rows) - 2);
+    threadCount = max(1, min(threadCount, interiorRows / 4));
+    if(threadCount == 1)    {
+        return thinImage(image, stats);
+    }
+
+    vector<int> bandStart(threadCount + 1);
+    for(int t = 0; t <= threadCount; ++t)   {
+        bandStart[t] = 1 + static_cast<int>(static_cast<long long>(interiorRows) * t / threadCount);
+    }
+
+    size_t interiorPixels = static_cast<size_t>(interiorRows) * max(0, static_cast<int>(image.cols) - 2);
+    vector<uint8_t> deletePlane(image.rows * image.cols, 0);
+    vector<int> rowDeleted(image.rows, 0);
+    vector<size_t> deletedPerBand(threadCount, 0);
+    int phase = 0;
+    int iterations = 0;
+    bool changesMade = false;
+    bool applyNeeded = false;
+    bool done = false;
+
+    //Runs on one thread once every band is marked: merge the counts and pick the next phase
+    auto mergeMarks = [&]() noexcept {
+        size_t deleted = 0;
+        for(size_t bandDeleted : deletedPerBand)    {
+            deleted += bandDeleted;
+        }
+        recordPass(stats, interiorPixels, deleted);
+        applyNeeded = deleted > 0;
+        if(phase == 0)  {
+            changesMade = deleted > 0;
+        } else {
+            changesMade = changesMade || deleted > 0;
+            ++iterations;
+            done = !changesMade;
+        }
+    };
+    auto nextPhase = [&]() noexcept {
+        phase = 1 - phase;
+    };
+    barrier marked(threadCount, mergeMarks);
+    barrier applied(threadCount, nextPhase);
+
+    //Each worker marks its band, reading one halo row above and below it from the shared plane,
+    //then clears its own rows once every band has been marked
+    auto worker = [&](int t) {
+        while(true) {
+            deletedPerBand[t] = markRowRange(image, phase, bandStart[t], bandStart[t + 1], deletePlane.data(), rowDeleted.data());
+            marked.arrive_and_wait();
+            if(applyNeeded) {
+                applyRowRange(image, bandStart[t], bandStart[t + 1], deletePlane.data(), rowDeleted.data());
+            }
+            if(done)    {
+                return;
+            }
+            applied.arrive_and_wait();
+        }
+    };
+
+    vector<thread> workers;
+    for(int t = 1; t < threadCount; ++t)    {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for(thread& w : workers)    {
+        w.join();
+    }
+
+    TRACE_COUNTER("thinning.iterations", iterations);
+    if(stats)   {
+        stats->iterations = iterations;
+    }
+    return iterations;
 }
\ No newline at end of file
@@ -1,13 +1,77 @@
-#include <vector>
-#include <tuple>
-
-using namespace std;
-
-vector<vector<int>> createSkeleton(vector<vector<int>>& pixelMatrix);
-vector<tuple<int, int>> getMarkedPixelsPhaseOne(vector<vector<int>>& pixelMatrix);
-vector<tuple<int, int>> getMarkedPixelsPhaseTwo(vector<vector<int>>& pixelMatrix);
-void updatePixels(vector<vector<int>>& pixelMatrix, vector<tuple<int, int>>& markedPixels);
-vector<int> getNeighbors(vector<vector<int>>& pixelMatrix, int row, int col);
-bool isValidNeighbor(vector<vector<int>>& pixelMatrix, int r, int c, int row, int col);
-bool satisfiesPhaseOneConditions(vector<vector<int>>& pixelMatrix, int row, int col);
-bool satisfiesPhaseTwoConditions(vector<vector<int>>& pixelMatrix, int row, int col);
+#pragma once
+#include <vector>
+#include <tuple>
+#include "binary_image.h"
+
+using namespace std;
+
+// How the table-driven engine finds candidate pixels for each subiteration
+enum class ThinningMode {
+    FullScan,   // examine every interior pixel on every pass
+    Frontier    // examine only boundary pixels and neighbours of the last deletions
+};
+
+// Per-pass counters filled in by the thinning engines
+struct ThinningStats {
+    int iterations = 0;
+    vector<size_t> visitedPerPass;  // pixels examined in each subiteration
+    vector<size_t> deletedPerPass;  // pixels removed in each subiteration
+};
+
+vector<vector<int>> createSkeleton(vector<vector<int>>& pixelMatrix, ThinningMode mode = ThinningMode::FullScan, ThinningStats* stats = nullptr);
+vector<vector<int>> createSkeletonParallel(vector<vector<int>>& pixelMatrix, int threadCount = 0, ThinningStats* stats = nullptr);
+vector<vector<int>> createSkeletonReference(vector<vector<int>>& pixelMatrix);
+vector<tuple<int, int>> getMarkedPixelsPhaseOne(vector<vector<int>>& pixelMatrix);
+vector<tuple<int, int>> getMarkedPixelsPhaseTwo(vector<vector<int>>& pixelMatrix);
+void updatePixels(vector<vector<int>>& pixelMatrix, vector<tuple<int, int>>& markedPixels);
+vector<int> getNeighbors(vector<vector<int>>& pixelMatrix, int row, int col);
+bool isValidNeighbor(vector<vector<int>>& pixelMatrix, int r, int c, int row, int col);
+bool satisfiesPhaseOneConditions(vector<vector<int>>& pixelMatrix, int row, int col);
+bool satisfiesPhaseTwoConditions(vector<vector<int>>& pixelMatrix, int row, int col);
+
+// Row kernel used by the full-scan engines, picked at runtime from the best one the CPU supports
+enum class ThinningKernel {
+    Auto,
+    Scalar,
+    SSSE3,  // 16 pixels per step
+    AVX2    // 32 pixels per step
+};
+
+// Force a row kernel (Auto re-detects). Returns false if the CPU doesn't support it. Safe to call
+// while other threads are thinning: each row runs on whichever kernel is current when it starts,
+// and every kernel gives the same result.
+bool setThinningKernel(ThinningKernel kernel);
+ThinningKernel getThinningKernel();
+
+// Write a 0/1 delete mask for one row from the row above, the row itself and the row below.
+// phase is 0 or 1. Edge columns are never marked. Returns the number of pixels marked.
+int markRowDeletions(const uint8_t* above, const uint8_t* curr, const uint8_t* below, int cols, int phase, uint8_t* deleteRow);
+
+// Clear marked pixels of a row (row &= ~deleteRow)
+void applyRowDeletions(uint8_t* row, const uint8_t* deleteRow, int cols);
+
+// Table-driven Zhang-Suen on a contiguous binary plane. Returns the number of iterations run.
+int thinImage(BinaryImage& image, ThinningStats* stats = nullptr);
+
+// Same engine on any 0/1 view (e.g. a block of a larger Matrix). With a scratch arena the
+// delete plane is taken from it instead of the heap.
+int thinImage(MatrixView<uint8_t> image, ThinningStats* stats = nullptr, Arena* scratch = nullptr);
+
+// Same result as thinImage, but keeps a worklist seeded with the foreground boundary and
+// only re-queues the 8-neighbours of removed pixels after each subiteration
+int thinImageFrontier(BinaryImage& image, ThinningStats* stats = nullptr);
+int thinImageFrontier(MatrixView<uint8_t> image, ThinningStats* stats = nullptr, Arena* scratch = nullptr);
+
+// 8-neighbour mask of an interior pixel, bit i holds P(i+2) in clockwise order starting at the top
+uint8_t getNeighborMask(const BinaryImage& image, int row, int col);
+uint8_t getNeighborMask(MatrixView<const uint8_t> image, int row, int col);
+
+// Deletion decision for a neighbour mask, precomputed for all 256 masks per phase
+bool isDeletablePhaseOne(uint8_t neighborMask);
+bool isDeletablePhaseTwo(uint8_t neighborMask);
+
+// Full-scan engine with the image split into row bands, one worker per band. Each phase is marked
+// concurrently and merged before the shared update, so the result matches thinImage.
+// threadCount <= 0 uses every hardware thread.
+int thinImageParallel(BinaryImage& image, int threadCount, ThinningStats* stats = nullptr);
+int thinImageParallel(MatrixView<uint8_t> image, int threadCount, ThinningStats* stats = nullptr);
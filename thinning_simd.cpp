@@ -0,0 +1,256 @@
+#include "thinning.h"
+#include <array>
+#include <bit>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define THINNING_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//Deletion tables packed to one bit per neighbour mask: bit (mask & 7) of byte (mask >> 3)
+struct PackedPhaseTables {
+    alignas(32) uint8_t bits[2][32];
+};
+
+static PackedPhaseTables buildPackedTables()  {
+    PackedPhaseTables tables{};
+    for(int mask = 0; mask < 256; ++mask)   {
+        if(isDeletablePhaseOne(mask))   {
+            tables.bits[0][mask >> 3] |= 1 << (mask & 7);
+        }
+        if(isDeletablePhaseTwo(mask))   {
+            tables.bits[1][mask >> 3] |= 1 << (mask & 7);
+        }
+    }
+    return tables;
+}
+
+static const PackedPhaseTables& packedTables()  {
+    static const PackedPhaseTables tables = buildPackedTables();
+    return tables;
+}
+
+//Scalar kernel, also used for the columns left over after the vector loop
+static int markRowScalar(const uint8_t* above, const uint8_t* curr, const uint8_t* below, int colBegin, int colEnd,
+                         const uint8_t* table, uint8_t* deleteRow)  {
+    int deleted = 0;
+    for(int c = colBegin; c < colEnd; ++c)  {
+        uint8_t mask = (above[c] != 0)
+            | (above[c + 1] != 0) << 1
+            | (curr[c + 1] != 0) << 2
+            | (below[c + 1] != 0) << 3
+            | (below[c] != 0) << 4
+            | (below[c - 1] != 0) << 5
+            | (curr[c - 1] != 0) << 6
+            | (above[c - 1] != 0) << 7;
+        uint8_t remove = curr[c] && ((table[mask >> 3] >> (mask & 7)) & 1);
+        deleteRow[c] = remove;
+        deleted += remove;
+    }
+    return deleted;
+}
+
+static void applyRowScalar(uint8_t* row, const uint8_t* deleteRow, int colBegin, int colEnd)   {
+    for(int c = colBegin; c < colEnd; ++c)  {
+        row[c] &= ~deleteRow[c];
+    }
+}
+
+#ifdef THINNING_X86
+
+//1 << bit in every byte whose pixel is black
+__attribute__((target("avx2")))
+static inline __m256i neighborBitAVX2(const uint8_t* p, int bit)  {
+    __m256i isWhite = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), _mm256_setzero_si256());
+    return _mm256_andnot_si256(isWhite, _mm256_set1_epi8(static_cast<char>(1 << bit)));
+}
+
+//Neighbour masks for 32 pixels at once: each neighbour row contributes one bit where it is non-zero,
+//then the packed table is indexed with two byte shuffles (table byte) and one more (bit within the byte)
+__attribute__((target("avx2")))
+static int markRowAVX2(const uint8_t* above, const uint8_t* curr, const uint8_t* below, int colBegin, int colEnd,
+                       const uint8_t* table, uint8_t* deleteRow)  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i tableLow = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+    const __m256i tableHigh = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table + 16)));
+    const __m256i bitValues = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                               1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i lowBits = _mm256_set1_epi8(0x07);
+    const __m256i indexBits = _mm256_set1_epi8(0x1F);
+    const __m256i highHalf = _mm256_set1_epi8(0x10);
+    const __m256i one = _mm256_set1_epi8(1);
+
+    int deleted = 0;
+    int c = colBegin;
+    for(; c + 32 <= colEnd; c += 32)    {
+        __m256i mask = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(neighborBitAVX2(above + c, 0), neighborBitAVX2(above + c + 1, 1)),
+                            _mm256_or_si256(neighborBitAVX2(curr + c + 1, 2), neighborBitAVX2(below + c + 1, 3))),
+            _mm256_or_si256(_mm256_or_si256(neighborBitAVX2(below + c, 4), neighborBitAVX2(below + c - 1, 5)),
+                            _mm256_or_si256(neighborBitAVX2(curr + c - 1, 6), neighborBitAVX2(above + c - 1, 7))));
+
+        __m256i index = _mm256_and_si256(_mm256_srli_epi16(mask, 3), indexBits);
+        __m256i useHigh = _mm256_cmpeq_epi8(_mm256_and_si256(index, highHalf), highHalf);
+        __m256i tableByte = _mm256_blendv_epi8(_mm256_shuffle_epi8(tableLow, index), _mm256_shuffle_epi8(tableHigh, index), useHigh);
+        __m256i bit = _mm256_shuffle_epi8(bitValues, _mm256_and_si256(mask, lowBits));
+        __m256i remove = _mm256_cmpeq_epi8(_mm256_and_si256(tableByte, bit), bit);
+
+        __m256i centerWhite = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(curr + c)), zero);
+        remove = _mm256_andnot_si256(centerWhite, remove);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(deleteRow + c), _mm256_and_si256(remove, one));
+        deleted += popcount(static_cast<uint32_t>(_mm256_movemask_epi8(remove)));
+    }
+    return deleted + markRowScalar(above, curr, below, c, colEnd, table, deleteRow);
+}
+
+__attribute__((target("avx2")))
+static void applyRowAVX2(uint8_t* row, const uint8_t* deleteRow, int colBegin, int colEnd)   {
+    int c = colBegin;
+    for(; c + 32 <= colEnd; c += 32)    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + c));
+        __m256i remove = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(deleteRow + c));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + c), _mm256_andnot_si256(remove, pixels));
+    }
+    applyRowScalar(row, deleteRow, c, colEnd);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i neighborBitSSSE3(const uint8_t* p, int bit)  {
+    __m128i isWhite = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+    return _mm_andnot_si128(isWhite, _mm_set1_epi8(static_cast<char>(1 << bit)));
+}
+
+//Same kernel 16 pixels wide for CPUs without AVX2
+__attribute__((target("ssse3")))
+static int markRowSSSE3(const uint8_t* above, const uint8_t* curr, const uint8_t* below, int colBegin, int colEnd,
+                        const uint8_t* table, uint8_t* deleteRow)  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i tableLow = _mm_load_si128(reinterpret_cast<const __m128i*>(table));
+    const __m128i tableHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(table + 16));
+    const __m128i bitValues = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i lowBits = _mm_set1_epi8(0x07);
+    const __m128i indexBits = _mm_set1_epi8(0x1F);
+    const __m128i highHalf = _mm_set1_epi8(0x10);
+    const __m128i one = _mm_set1_epi8(1);
+
+    int deleted = 0;
+    int c = colBegin;
+    for(; c + 16 <= colEnd; c += 16)    {
+        __m128i mask = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(neighborBitSSSE3(above + c, 0), neighborBitSSSE3(above + c + 1, 1)),
+                         _mm_or_si128(neighborBitSSSE3(curr + c + 1, 2), neighborBitSSSE3(below + c + 1, 3))),
+            _mm_or_si128(_mm_or_si128(neighborBitSSSE3(below + c, 4), neighborBitSSSE3(below + c - 1, 5)),
+                         _mm_or_si128(neighborBitSSSE3(curr + c - 1, 6), neighborBitSSSE3(above + c - 1, 7))));
+
+        __m128i index = _mm_and_si128(_mm_srli_epi16(mask, 3), indexBits);
+        __m128i useHigh = _mm_cmpeq_epi8(_mm_and_si128(index, highHalf), highHalf);
+        __m128i tableByte = _mm_or_si128(_mm_and_si128(useHigh, _mm_shuffle_epi8(tableHigh, index)),
+                                         _mm_andnot_si128(useHigh, _mm_shuffle_epi8(tableLow, index)));
+        __m128i bit = _mm_shuffle_epi8(bitValues, _mm_and_si128(mask, lowBits));
+        __m128i remove = _mm_cmpeq_epi8(_mm_and_si128(tableByte, bit), bit);
+
+        __m128i centerWhite = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + c)), zero);
+        remove = _mm_andnot_si128(centerWhite, remove);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(deleteRow + c), _mm_and_si128(remove, one));
+        deleted += popcount(static_cast<uint32_t>(_mm_movemask_epi8(remove)));
+    }
+    return deleted + markRowScalar(above, curr, below, c, colEnd, table, deleteRow);
+}
+
+__attribute__((target("ssse3")))
+static void applyRowSSSE3(uint8_t* row, const uint8_t* deleteRow, int colBegin, int colEnd)   {
+    int c = colBegin;
+    for(; c + 16 <= colEnd; c += 16)    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + c));
+        __m128i remove = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deleteRow + c));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + c), _mm_andnot_si128(remove, pixels));
+    }
+    applyRowScalar(row, deleteRow, c, colEnd);
+}
+
+#endif
+
+using MarkRowFunction = int (*)(const uint8_t*, const uint8_t*, const uint8_t*, int, int, const uint8_t*, uint8_t*);
+using ApplyRowFunction = void (*)(uint8_t*, const uint8_t*, int, int);
+
+struct RowKernel {
+    ThinningKernel kind;
+    MarkRowFunction mark;
+    ApplyRowFunction apply;
+};
+
+static bool kernelSupported(ThinningKernel kernel)  {
+#ifdef THINNING_X86
+    __builtin_cpu_init();
+    if(kernel == ThinningKernel::AVX2)  {
+        return __builtin_cpu_supports("avx2");
+    }
+    if(kernel == ThinningKernel::SSSE3) {
+        return __builtin_cpu_supports("ssse3");
+    }
+#endif
+    return kernel == ThinningKernel::Scalar;
+}
+
+// Kernels live in static storage and the active one is swapped as a pointer, so a pool thread
+// always sees a complete kernel even while another thread changes it
+static const RowKernel* makeRowKernel(ThinningKernel kernel)   {
+    static const RowKernel scalar{ThinningKernel::Scalar, markRowScalar, applyRowScalar};
+#ifdef THINNING_X86
+    static const RowKernel avx2{ThinningKernel::AVX2, markRowAVX2, applyRowAVX2};
+    static const RowKernel ssse3{ThinningKernel::SSSE3, markRowSSSE3, applyRowSSSE3};
+    if(kernel == ThinningKernel::AVX2)  {
+        return &avx2;
+    }
+    if(kernel == ThinningKernel::SSSE3) {
+        return &ssse3;
+    }
+#endif
+    return &scalar;
+}
+
+static const RowKernel* detectRowKernel()    {
+    for(ThinningKernel kernel : {ThinningKernel::AVX2, ThinningKernel::SSSE3}) {
+        if(kernelSupported(kernel)) {
+            return makeRowKernel(kernel);
+        }
+    }
+    return makeRowKernel(ThinningKernel::Scalar);
+}
+
+static atomic<const RowKernel*> activeKernel{detectRowKernel()};
+
+bool setThinningKernel(ThinningKernel kernel) {
+    if(kernel == ThinningKernel::Auto)  {
+        activeKernel.store(detectRowKernel(), memory_order_relaxed);
+        return true;
+    }
+    if(!kernelSupported(kernel))    {
+        return false;
+    }
+    activeKernel.store(makeRowKernel(kernel), memory_order_relaxed);
+    return true;
+}
+
+ThinningKernel getThinningKernel()  {
+    return activeKernel.load(memory_order_relaxed)->kind;
+}
+
+int markRowDeletions(const uint8_t* above, const uint8_t* curr, const uint8_t* below, int cols, int phase, uint8_t* deleteRow)  {
+    if(cols < 3)    {
+        return 0;
+    }
+    //Edge columns never have 8 neighbors and are never deleted
+    deleteRow[0] = 0;
+    deleteRow[cols - 1] = 0;
+    return activeKernel.load(memory_order_relaxed)->mark(above, curr, below, 1, cols - 1, packedTables().bits[phase], deleteRow);
+}
+
+void applyRowDeletions(uint8_t* row, const uint8_t* deleteRow, int cols)  {
+    activeKernel.load(memory_order_relaxed)->apply(row, deleteRow, 0, cols);
+}
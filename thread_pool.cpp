@@ -0,0 +1,124 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool::ThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = max(1, static_cast<int>(thread::hardware_concurrency())) - 1;
+    }
+    for (int i = 0; i <= threadCount; ++i) {
+        queues.push_back(make_unique<TaskQueue>());
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Own queue: newest task first, it is the most likely to still be in cache
+bool ThreadPool::popTask(size_t queueIndex, Task& task) {
+    TaskQueue& queue = *queues[queueIndex];
+    lock_guard<mutex> lock(queue.lock);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    queuedTasks.fetch_sub(1);
+    return true;
+}
+
+// Other queues: oldest task first, starting with the next queue over
+bool ThreadPool::stealTask(size_t thiefIndex, Task& task) {
+    for (size_t offset = 1; offset <= queues.size(); ++offset) {
+        TaskQueue& queue = *queues[(thiefIndex + offset) % queues.size()];
+        lock_guard<mutex> lock(queue.lock);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            queuedTasks.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTask(const Task& task) {
+    (*task.job->body)(task.begin, task.end);
+
+    lock_guard<mutex> lock(task.job->doneMutex);
+    if (--task.job->remaining == 0) {
+        task.job->done.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    while (true) {
+        Task task;
+        if (popTask(index, task) || stealTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+
+        unique_lock<mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queuedTasks.load() > 0; });
+        if (stopping && queuedTasks.load() == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grainSize = max<size_t>(1, grainSize);
+    size_t chunkCount = (count + grainSize - 1) / grainSize;
+    if (chunkCount == 1 || workers.empty()) {
+        body(0, count);
+        return;
+    }
+
+    Job job;
+    job.body = &body;
+    job.remaining = chunkCount;
+
+    // Deal the chunks out round-robin; stealing takes care of any imbalance.
+    // The count goes up first so it never drops below the number of queued tasks.
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        queuedTasks.fetch_add(chunkCount);
+    }
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        size_t begin = chunk * grainSize;
+        TaskQueue& queue = *queues[chunk % queues.size()];
+        lock_guard<mutex> lock(queue.lock);
+        queue.tasks.push_back({&job, begin, min(begin + grainSize, count)});
+    }
+    wake.notify_all();
+
+    // The caller works through its own queue, then steals, then waits for stragglers
+    size_t callerQueue = queues.size() - 1;
+    Task task;
+    while (popTask(callerQueue, task) || stealTask(callerQueue, task)) {
+        runTask(task);
+    }
+    unique_lock<mutex> lock(job.doneMutex);
+    job.done.wait(lock, [&job] { return job.remaining == 0; });
+}
+
+ThreadPool& getDefaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+// Persistent pool of worker threads with one task deque per worker. Workers take their own
+// newest task first and steal the oldest task of another worker when they run dry, so uneven
+// chunks even out. The pool is meant to be created once and reused across many calls.
+class ThreadPool {
+public:
+    // threadCount <= 0 uses one worker per hardware thread, minus the calling thread
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that run a parallelFor, including the caller
+    int concurrency() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Run body(begin, end) over [0, count) in chunks of at most grainSize items and wait for all
+    // of them. The calling thread executes chunks too.
+    void parallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)>& body);
+
+private:
+    struct Job {
+        const function<void(size_t, size_t)>* body;
+        size_t remaining;
+        mutex doneMutex;
+        condition_variable done;
+    };
+
+    struct Task {
+        Job* job;
+        size_t begin;
+        size_t end;
+    };
+
+    struct TaskQueue {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    bool popTask(size_t queueIndex, Task& task);
+    bool stealTask(size_t thiefIndex, Task& task);
+    void runTask(const Task& task);
+    void workerLoop(size_t index);
+
+    vector<unique_ptr<TaskQueue>> queues;   // one per worker plus one for callers
+    vector<thread> workers;
+    mutex sleepMutex;
+    condition_variable wake;
+    atomic<size_t> queuedTasks{0};
+    bool stopping = false;
+};
+
+// Process-wide pool shared by the transforms when no pool is passed explicitly
+ThreadPool& getDefaultThreadPool();
@@ -0,0 +1,159 @@
+#include "trace.h"
+
+#ifdef DRAW_TRACE
+
+#include "alloc_counter.h"
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+using namespace std;
+
+struct TraceEvent {
+    const char* name;
+    bool counter;
+    int64_t wallNs;     // start (scopes) or sample time (counters), from process start
+    int64_t durationNs;
+    int64_t cpuNs;
+    uint64_t bytes;
+    double value;
+};
+
+// Events are appended to a per-thread buffer so recording never takes a lock; the buffers are
+// registered once and outlive their threads so the writer can still read them.
+struct TraceBuffer {
+    int threadId;
+    vector<TraceEvent> events;
+};
+
+static mutex bufferLock;
+static vector<unique_ptr<TraceBuffer>> buffers;
+static const chrono::steady_clock::time_point traceStart = chrono::steady_clock::now();
+
+static TraceBuffer& getThreadBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    if (!buffer) {
+        lock_guard<mutex> guard(bufferLock);
+        buffers.push_back(make_unique<TraceBuffer>());
+        buffer = buffers.back().get();
+        buffer->threadId = static_cast<int>(buffers.size());
+    }
+    return *buffer;
+}
+
+static int64_t getWallNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - traceStart).count();
+}
+
+static int64_t getThreadCpuNs() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+TraceScope::TraceScope(const char* name) : name(name), startWallNs(getWallNs()), startCpuNs(getThreadCpuNs()), startBytes(getAllocatedBytes()) {}
+
+void TraceScope::end() {
+    if (!open) {
+        return;
+    }
+    open = false;
+    int64_t wall = getWallNs();
+    getThreadBuffer().events.push_back({name, false, startWallNs, wall - startWallNs, getThreadCpuNs() - startCpuNs,
+                                        getAllocatedBytes() - startBytes, 0});
+}
+
+void traceCounter(const char* name, double value) {
+    getThreadBuffer().events.push_back({name, true, getWallNs(), 0, 0, 0, value});
+}
+
+bool isTracingEnabled() {
+    return true;
+}
+
+bool writeChromeTrace(const string& path) {
+    ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    lock_guard<mutex> guard(bufferLock);
+    out << "{\"traceEvents\": [\n";
+    bool first = true;
+    for (const auto& buffer : buffers) {
+        for (const TraceEvent& e : buffer->events) {
+            out << (first ? "" : ",\n");
+            first = false;
+            if (e.counter) {
+                out << "{\"name\": \"" << e.name << "\", \"ph\": \"C\", \"pid\": 1, \"tid\": " << buffer->threadId
+                    << ", \"ts\": " << e.wallNs / 1000.0 << ", \"args\": {\"value\": " << e.value << "}}";
+            } else {
+                out << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadId
+                    << ", \"ts\": " << e.wallNs / 1000.0 << ", \"dur\": " << e.durationNs / 1000.0
+                    << ", \"args\": {\"cpu_us\": " << e.cpuNs / 1000.0 << ", \"bytes\": " << e.bytes << "}}";
+            }
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+void printTraceSummary(ostream& out) {
+    struct ScopeTotal {
+        int64_t wallNs = 0, cpuNs = 0;
+        uint64_t bytes = 0;
+        int calls = 0;
+    };
+    map<string, ScopeTotal> scopes;
+    map<string, double> counters;
+    {
+        lock_guard<mutex> guard(bufferLock);
+        for (const auto& buffer : buffers) {
+            for (const TraceEvent& e : buffer->events) {
+                if (e.counter) {
+                    counters[e.name] += e.value;
+                } else {
+                    ScopeTotal& total = scopes[e.name];
+                    total.wallNs += e.durationNs;
+                    total.cpuNs += e.cpuNs;
+                    total.bytes += e.bytes;
+                    ++total.calls;
+                }
+            }
+        }
+    }
+
+    vector<pair<string, ScopeTotal>> sorted(scopes.begin(), scopes.end());
+    sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.wallNs > b.second.wallNs; });
+    out << "trace:";
+    for (const auto& [name, total] : sorted) {
+        out << " " << name << "=" << total.wallNs / 1e6 << "ms/" << total.cpuNs / 1e6 << "cpu/" << total.bytes / 1024 << "KiB";
+        if (total.calls > 1) {
+            out << "x" << total.calls;
+        }
+    }
+    for (const auto& [name, value] : counters) {
+        out << " " << name << "=" << value;
+    }
+    out << "\n";
+}
+
+#else
+
+bool isTracingEnabled() {
+    return false;
+}
+
+bool writeChromeTrace(const string&) {
+    return false;
+}
+
+void printTraceSummary(ostream& out) {
+    out << "trace: not compiled in (build with make TRACE=1)\n";
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+using namespace std;
+
+// Hot-path tracing, compiled in only with -DDRAW_TRACE (make TRACE=1). Without it every macro
+// below expands to nothing and the output functions report that tracing is unavailable.
+//
+//   TRACE_SCOPE("fft.rows");              // times the enclosing block
+//   TRACE_SCOPE_NAMED(step, "main.fft");  // same, but can be closed early with TRACE_END(step)
+//   TRACE_COUNTER("thinning.deleted", n); // sampled value
+//
+// Each scope records wall time, the thread's CPU time and the bytes allocated process-wide while
+// it was open. Names must be string literals (they are stored by pointer).
+
+#ifdef DRAW_TRACE
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope() { end(); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    void end();
+
+private:
+    const char* name;
+    int64_t startWallNs;
+    int64_t startCpuNs;
+    uint64_t startBytes;
+    bool open = true;
+};
+
+void traceCounter(const char* name, double value);
+
+#define DRAW_TRACE_JOIN2(a, b) a##b
+#define DRAW_TRACE_JOIN(a, b) DRAW_TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) TraceScope DRAW_TRACE_JOIN(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_NAMED(var, name) TraceScope var(name)
+#define TRACE_END(var) var.end()
+#define TRACE_COUNTER(name, value) traceCounter(name, static_cast<double>(value))
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_NAMED(var, name) ((void)0)
+#define TRACE_END(var) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+
+#endif
+
+// True when built with DRAW_TRACE
+bool isTracingEnabled();
+
+// Everything recorded so far as a Chrome trace-event file (chrome://tracing, Perfetto).
+// Returns false if tracing is compiled out or the file can't be written.
+bool writeChromeTrace(const string& path);
+
+// One line: total wall/CPU ms and bytes per scope name, largest first, then counter totals
+void printTraceSummary(ostream& out);